@@ -0,0 +1,32 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "allocation_counter.hpp"
+
+namespace allocation_counter {
+
+static std::atomic<size_t> allocation_count(0);
+
+size_t allocations() {
+  return allocation_count.load();
+}
+
+} // namespace allocation_counter
+
+void* operator new(std::size_t size) {
+  allocation_counter::allocation_count++;
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
@@ -0,0 +1,16 @@
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+#include <cstddef>
+
+// Tests that link in allocation_counter.cpp get a global operator new
+// that counts the allocations.  This lets a test check that large
+// geometry is moved instead of copied.
+namespace allocation_counter {
+
+// The number of allocations since the start of the program.
+size_t allocations();
+
+} // namespace allocation_counter
+
+#endif //ALLOCATION_COUNTER_HPP
@@ -26,7 +26,9 @@
 #include <boost/geometry/algorithms/distance.hpp>
 
 #include <boost/format.hpp>
+#include <fstream>
 #include <memory>
+#include <stdexcept>
 #include <vector>
 using boost::format;
 using std::shared_ptr;
@@ -58,6 +60,18 @@ boost::format silent_format(const string &f_string)
     return fmter;
 }
 
+static shared_ptr<const HeightMap> read_heightmap(const string& filename)
+{
+    if (filename.empty()) {
+        return nullptr;
+    }
+    std::ifstream in(filename);
+    if (!in.is_open()) {
+        throw std::invalid_argument("Can't open the height map: " + filename);
+    }
+    return std::make_shared<const HeightMap>(HeightMap::read(in));
+}
+
 autoleveller::autoleveller( const boost::program_options::variables_map &options, uniqueCodes *ocodes,
                             uniqueCodes *globalVars, double xoffset, double yoffset,
                             const struct Tiling::TileInfo tileInfo ) :
@@ -67,17 +81,21 @@ autoleveller::autoleveller( const boost::program_options::variables_map &options
     probeCodeCustom( options["al-probecode"].as<string>() ),
     zProbeResultVarCustom( "#" + to_string(options["al-probevar"].as<unsigned int>()) ),
     setZZeroCustom( options["al-setzzero"].as<string>() ),
-    XProbeDistRequired( options["al-x"].as<Length>().asInch(input_unitconv) * output_unitconv ),
-    YProbeDistRequired( options["al-y"].as<Length>().asInch(input_unitconv) * output_unitconv ),
+    XProbeDistRequired( options.count("al-x") ? options["al-x"].as<Length>().asInch(input_unitconv) * output_unitconv : 0 ),
+    YProbeDistRequired( options.count("al-y") ? options["al-y"].as<Length>().asInch(input_unitconv) * output_unitconv : 0 ),
     zprobe( str( format("%.3f") % ( options["zsafe"].as<Length>().asInch(input_unitconv) * output_unitconv ) ) ),
     zsafe( str( format("%.3f") % ( options["zsafe"].as<Length>().asInch(input_unitconv) * output_unitconv) ) ),
     zfail( str( format("%.3f") % ( options["metricoutput"].as<bool>() ? FIXED_FAIL_DEPTH_MM : FIXED_FAIL_DEPTH_IN ) ) ),
-    feedrate( std::to_string( options["al-probefeed"].as<Velocity>().asInchPerMinute(input_unitconv) * output_unitconv ) ),
+    feedrate( options.count("al-probefeed") ?
+              std::to_string( options["al-probefeed"].as<Velocity>().asInchPerMinute(input_unitconv) * output_unitconv ) :
+              "" ),
     probeOn( boost::replace_all_copy(options["al-probe-on"].as<string>(), "@", "\n") ),
     probeOff( boost::replace_all_copy(options["al-probe-off"].as<string>(), "@", "\n") ),
-    software( options["software"].as<Software::Software>() ),
+    software( options.count("software") ? options["software"].as<Software::Software>() : Software::CUSTOM ),
     xoffset( xoffset ),
     yoffset( yoffset ),
+    heightmap( read_heightmap(options["al-heightmap"].as<string>()) ),
+    heightmapTolerance( options["al-heightmap-tolerance"].as<Length>().asInch(input_unitconv) * output_unitconv ),
     g01InterpolatedNum( ocodes->getUniqueCode() ),
     yProbeNum( ocodes->getUniqueCode() ),
     xProbeNum( ocodes->getUniqueCode() ),
@@ -93,9 +111,13 @@ autoleveller::autoleveller( const boost::program_options::variables_map &options
     initialYOffsetVar( globalVars->getUniqueCode() ),
     ocodes( ocodes )
 {
-    callSub2[Software::LINUXCNC] = "o%1$s call [%2$.5f] [%3$.5f] [%4$.5f]\n";
-    callSub2[Software::MACH4] = "G65 P%1$s A%2$.5f B%3$.5f C%4$.5f\n";
-    callSub2[Software::MACH3] = "#" + globalVar0 + "=%2$.5f\n%5$s#" + globalVar1 + "=%3$.5f\n%6$s#" + globalVar2 + "=%4$.5f\n%7$sM98 P%1$s\n";
+    if (software == Software::LINUXCNC) {
+        g01InterpolatedCall = "o" + to_string(g01InterpolatedNum) + " call [";
+    } else if (software == Software::MACH4) {
+        g01InterpolatedCall = "G65 P" + to_string(g01InterpolatedNum) + " A";
+    } else if (software == Software::MACH3) {
+        g01InterpolatedCall = "M98 P" + to_string(g01InterpolatedNum) + "\n";
+    }
 }
 
 string autoleveller::getVarName(unsigned int i, unsigned int j) {
@@ -116,6 +138,10 @@ box_type_fp computeWorkarea(const vector<pair<coordinate_type_fp, multi_linestri
 }
 
 void autoleveller::prepareWorkarea(const vector<pair<coordinate_type_fp, multi_linestring_type_fp>>& toolpaths) {
+    if (heightmap) {
+      return; // Already probed.
+    }
+
     box_type_fp workarea;
     double workareaLenX;
     double workareaLenY;
@@ -144,6 +170,28 @@ void autoleveller::prepareWorkarea(const vector<pair<coordinate_type_fp, multi_l
     YProbeDist = workareaLenY / ( numYPoints - 1 );
     averageProbeDist = ( XProbeDist + YProbeDist ) / 2;
 
+    varNames.clear();
+    for (unsigned int i = 0; i < numXPoints; i++) {
+      for (unsigned int j = 0; j < numYPoints; j++) {
+        varNames.push_back(getVarName(i, j));
+      }
+    }
+    cellInterpolations.clear();
+    if (software == Software::CUSTOM) {
+      for (unsigned int i = 0; i + 1 < numXPoints; i++) {
+        for (unsigned int j = 0; j + 1 < numYPoints; j++) {
+          const string& lowerLeft = varNames[i * numYPoints + j];
+          const string& upperLeft = varNames[i * numYPoints + j + 1];
+          const string& lowerRight = varNames[(i + 1) * numYPoints + j];
+          const string& upperRight = varNames[(i + 1) * numYPoints + j + 1];
+          cellInterpolations.push_back({
+              "#" + globalVar4 + "=[" + lowerLeft + "+[" + upperLeft + "-" + lowerLeft + "]*",
+              "]\n#" + globalVar5 + "=[" + lowerRight + "+[" + upperRight + "-" + lowerRight + "]*",
+              "]\n#" + returnVar + "=[#" + globalVar4 + "+[#" + globalVar5 + "-#" + globalVar4 + "]*"});
+        }
+      }
+    }
+
     if (requiredProbePoints() > maxProbePoints()) {
       options::maybe_throw(std::string("Required number of probe points (") + std::to_string(requiredProbePoints()) +
                            ") exceeds the maximum number (" + std::to_string(maxProbePoints()) + "). "
@@ -159,6 +207,12 @@ void autoleveller::header(std::ofstream &of) {
     };
     const char *logFileClose[] = { "(PROBECLOSE)" , "M41", "M41" };
 
+    if (heightmap) {
+        of << "( Z is corrected with the height map of " << heightmap->get_xs().size() << " x "
+           << heightmap->get_ys().size() << " probes, so there is no probing )\n\n";
+        return;
+    }
+
     if( software == Software::LINUXCNC )
         footerNoIf( of );
 
@@ -299,7 +353,7 @@ static inline T clamp(const T& x, const T& min_x, const T& max_x) {
   return std::max(min_x, std::min(x, max_x));
 }
 
-string autoleveller::interpolatePoint(point_type_fp point) {
+void autoleveller::interpolatePoint(GcodeWriter& of, point_type_fp point) {
   unsigned int xminindex;
   unsigned int yminindex;
   double x_minus_x0_rel;
@@ -329,40 +383,32 @@ string autoleveller::interpolatePoint(point_type_fp point) {
     yminindex += 1;
   }
 
+  const string& lowerLeft = varNames[xminindex * numYPoints + yminindex];
   if (y_minus_y0_rel == 0) {
     if (x_minus_x0_rel == 0) {
       // If `point` is on top of a measurement point, just copy
       // the measured height over
-      return str(format("#%2$s=%1$s\n")
-                 % getVarName(xminindex, yminindex)
-                 % returnVar);
+      of << '#' << returnVar << '=' << lowerLeft << '\n';
     } else {
       // If `point` has the same y coordinate as a row of points,
       // interpolate between the points to the left and right of
       // it
-      return str(format("#%4$s=[%1$s+[%2$s-%1$s]*%3$.5f]\n")
-                 % getVarName(xminindex, yminindex)
-                 % getVarName(xminindex + 1, yminindex)
-                 % x_minus_x0_rel % returnVar);
+      const string& lowerRight = varNames[(xminindex + 1) * numYPoints + yminindex];
+      of << '#' << returnVar << "=[" << lowerLeft << "+[" << lowerRight << '-' << lowerLeft << "]*"
+         << x_minus_x0_rel << "]\n";
     }
   } else {
     if (x_minus_x0_rel == 0) {
       // If `point` has the same x coordinate as a column of
       // points, interpolate between the points above and below it
-      return str(format("#%4$s=[%2$s+[%1$s-%2$s]*%3$.5f]\n")
-                 % getVarName(xminindex, yminindex + 1)
-                 % getVarName(xminindex, yminindex)
-                 % y_minus_y0_rel % returnVar);
+      const string& upperLeft = varNames[xminindex * numYPoints + yminindex + 1];
+      of << '#' << returnVar << "=[" << lowerLeft << "+[" << upperLeft << '-' << lowerLeft << "]*"
+         << y_minus_y0_rel << "]\n";
     } else {
       // ...else use bilinear interpolation between all four
       // points around it
-      return str(format("#%7$s=[%3$s+[%1$s-%3$s]*%5$.5f]\n#%8$s=[%4$s+[%2$s-%4$s]*%5$.5f]\n#%9$s=[#%7$s+[#%8$s-#%7$s]*%6$.5f]\n")
-                 % getVarName(xminindex, yminindex + 1)
-                 % getVarName(xminindex + 1, yminindex + 1)
-                 % getVarName(xminindex, yminindex)
-                 % getVarName(xminindex + 1, yminindex)
-                 % y_minus_y0_rel % x_minus_x0_rel
-                 % globalVar4 % globalVar5 % returnVar);
+      const CellInterpolation& cell = cellInterpolations[xminindex * (numYPoints - 1) + yminindex];
+      of << cell.lower << y_minus_y0_rel << cell.upper << y_minus_y0_rel << cell.result << x_minus_x0_rel << "]\n";
     }
   }
 }
@@ -408,31 +454,52 @@ linestring_type_fp partition_segment(const point_type_fp& source, const point_ty
   return points;
 }
 
-string autoleveller::addChainPoint (point_type_fp point, double zwork) {
-    string outputStr;
+void autoleveller::callG01Interpolated(GcodeWriter& of, point_type_fp point, double zwork) {
+  if (software == Software::LINUXCNC) {
+    of << g01InterpolatedCall << point.x() << "] [" << point.y() << "] [" << zwork << "]\n";
+  } else if (software == Software::MACH4) {
+    of << g01InterpolatedCall << point.x() << " B" << point.y() << " C" << zwork << '\n';
+  } else {
+    of << '#' << globalVar0 << '=' << point.x() << "\n#" << globalVar1 << '=' << point.y()
+       << "\n#" << globalVar2 << '=' << zwork << '\n' << g01InterpolatedCall;
+  }
+}
+
+void autoleveller::addChainPoint (GcodeWriter& of, point_type_fp point, double zwork) {
     linestring_type_fp subsegments;
     linestring_type_fp::const_iterator i;
 
+    if (heightmap) {
+      const auto points = heightmap->follow(lastPoint, point, zwork, heightmapTolerance);
+      for (auto p = points.cbegin() + 1; p != points.cend(); p++) {
+        of << "G01 X" << p->first.x() << " Y" << p->first.y() << " Z" << p->second << '\n';
+      }
+      lastPoint = point;
+      return;
+    }
+
     subsegments = partition_segment(lastPoint, point, point_type_fp(startPointX, startPointY), point_type_fp(XProbeDist, YProbeDist));
 
     if (software == Software::LINUXCNC || software == Software::MACH4 || software == Software::MACH3) {
       for( i = subsegments.begin() + 1; i != subsegments.end(); i++ )
-        outputStr += str( silent_format( callSub2[software] ) % g01InterpolatedNum % i->x() % i->y() % zwork);
+        callG01Interpolated(of, *i, zwork);
     } else {
       for(i = subsegments.begin() + 1; i != subsegments.end(); i++) {
-        outputStr += interpolatePoint( *i );
-        outputStr += str( format( "X%1$.5f Y%2$.5f Z[#%4$s+%3$.5f]\n" ) % i->x() % i->y() % zwork % returnVar );
+        interpolatePoint(of, *i);
+        of << 'X' << i->x() << " Y" << i->y() << " Z[#" << returnVar << '+' << zwork << "]\n";
       }
     }
 
     lastPoint = point;
-    return outputStr;
 }
 
-string autoleveller::g01Corrected (point_type_fp point, double zwork) {
-  if( software == Software::LINUXCNC || software == Software::MACH4 || software == Software::MACH3 ) {
-    return str( silent_format( callSub2[software] ) % g01InterpolatedNum % point.x() % point.y() % zwork);
+void autoleveller::g01Corrected (GcodeWriter& of, point_type_fp point, double zwork) {
+  if (heightmap) {
+    of << "G01 Z" << zwork + heightmap->height(point) << '\n';
+  } else if( software == Software::LINUXCNC || software == Software::MACH4 || software == Software::MACH3 ) {
+    callG01Interpolated(of, point, zwork);
   } else {
-    return interpolatePoint( point ) + "G01 Z[" + str(format("%.5f")%zwork) + "+#" + returnVar + "]\n";
+    interpolatePoint(of, point);
+    of << "G01 Z[" << zwork << "+#" << returnVar << "]\n";
   }
 }
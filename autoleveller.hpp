@@ -37,6 +37,8 @@
 #include "common.hpp"
 #include "tile.hpp"
 #include "options.hpp"
+#include "heightmap.hpp"
+#include "gcode_writer.hpp"
 
 class autoleveller
 {
@@ -60,11 +62,11 @@ public:
     // required number of points between the previous and the current point and it interpolates them too.
     // This function adds a new chain point. Always call setLastChainPoint before starting a new chain
     // (call it also for the 1st chain)
-    std::string addChainPoint(point_type_fp point, double zwork);
+    void addChainPoint(GcodeWriter& of, point_type_fp point, double zwork);
 
     // g01Corrected interpolates only one point (without adding it to the chain), and it prints a G01 to that
     // position
-    std::string g01Corrected(point_type_fp point, double zwork);
+    void g01Corrected(GcodeWriter& of, point_type_fp point, double zwork);
 
     // Set lastPoint as the last chain point. You can use this function when you want to start a new chain
     inline void setLastChainPoint ( point_type_fp lastPoint )
@@ -81,14 +83,14 @@ public:
     // This function returns the required number of probe points
     inline unsigned int requiredProbePoints()
     {
-        return numXPoints * numYPoints;
+        return heightmap ? 0 : numXPoints * numYPoints;
     }
 
     // Since Mach3/4 require the subroutine body to be written at the end of the file, footer writes them
     // if software != LinuxCNC
     inline void footer( std::ofstream &of )
     {
-        if( software != Software::LINUXCNC )
+        if( software != Software::LINUXCNC && !heightmap )
             footerNoIf( of );
     }
 
@@ -113,6 +115,12 @@ public:
     const double xoffset;
     const double yoffset;
 
+    // If not null, the heights are already known and the Z of each move
+    // is corrected here instead of on the controller, so there is no
+    // probing and the moves are plain G01s.
+    const std::shared_ptr<const HeightMap> heightmap;
+    const double heightmapTolerance;
+
     //Number of the g01 interpolated macro
     const unsigned int g01InterpolatedNum;
     
@@ -148,7 +156,21 @@ protected:
     double averageProbeDist;
     uniqueCodes *ocodes;
 
-    std::string callSub2[3];
+    // The start of the line that calls the g01 interpolated macro, for all but custom
+    std::string g01InterpolatedCall;
+
+    // The names of the probe point variables, in the same order as getVarName numbers them
+    std::vector<std::string> varNames;
+
+    // For custom, the bilinear interpolation of a point in each grid cell is the same text
+    // apart from the 3 fractions, so that text is made once for each cell in prepareWorkarea
+    struct CellInterpolation
+    {
+        std::string lower;
+        std::string upper;
+        std::string result;
+    };
+    std::vector<CellInterpolation> cellInterpolations;
 
     point_type_fp lastPoint;
 
@@ -161,7 +183,10 @@ protected:
 
     // interpolatePoint finds the correct 4 probed points and computes a bilinear interpolation of point.
     // The result of the interpolation is saved in the parameter number RESULT_VAR
-    std::string interpolatePoint ( point_type_fp point );
+    void interpolatePoint ( GcodeWriter& of, point_type_fp point );
+
+    // callG01Interpolated prints the call of the g01 interpolated macro, for all but custom
+    void callG01Interpolated ( GcodeWriter& of, point_type_fp point, double zwork );
 };
 
 linestring_type_fp partition_segment(const point_type_fp& source, const point_type_fp& dest,
@@ -1,8 +1,18 @@
 #define BOOST_TEST_MODULE autoleveller tests
 #include <boost/test/unit_test.hpp>
 
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include "geometry.hpp"
 #include "bg_operators.hpp"
+#include "gcode_writer.hpp"
+#include "options.hpp"
+#include "unique_codes.hpp"
 
 #include "autoleveller.hpp"
 
@@ -10,6 +20,42 @@ using namespace std;
 
 BOOST_AUTO_TEST_SUITE(autoleveller_tests)
 
+void parse_options(const string& software, const string& probe_distance) {
+  const vector<string> words{"pcb2gcode", "--noconfigfile", "--al-front", "--al-x=" + probe_distance,
+                             "--al-y=" + probe_distance, "--al-probefeed=1in/min", "--zsafe=0.1in",
+                             "--software=" + software};
+  vector<const char*> argv;
+  for (const auto& word : words) {
+    argv.push_back(word.c_str());
+  }
+  options::get_vm().clear();
+  options::parse(argv.size(), &argv[0]);
+}
+
+const Tiling::TileInfo no_tiling{Software::CUSTOM, false, 1, 1, 0, 0, 1, 1, false};
+
+// The output for a path that goes through grid points, along grid lines
+// and across grid cells.
+string level(const string& software) {
+  parse_options(software, "0.25in");
+  uniqueCodes ocodes(1);
+  uniqueCodes globalVars(100);
+  autoleveller leveller(options::get_vm(), &ocodes, &globalVars, 0, 0, no_tiling);
+  const linestring_type_fp path{{0, 0}, {0.5, 0}, {0.5, 0.3}, {0.1, 0.7}, {1, 1}};
+  leveller.prepareWorkarea({{0.01, multi_linestring_type_fp{path}}});
+  ostringstream out;
+  {
+    GcodeWriter writer(out);
+    leveller.setLastChainPoint(path.front());
+    leveller.g01Corrected(writer, path.front(), -0.04);
+    for (const auto& point : path) {
+      leveller.addChainPoint(writer, point, -0.04);
+    }
+    leveller.g01Corrected(writer, point_type_fp(0.3, 0.6), -0.04);
+  }
+  return out.str();
+}
+
 BOOST_AUTO_TEST_CASE(ten_by_ten) {
   const auto actual = partition_segment(point_type_fp(0,0),
                                         point_type_fp(100,100),
@@ -131,4 +177,165 @@ BOOST_AUTO_TEST_CASE(skewed) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(linuxcnc) {
+  BOOST_CHECK_EQUAL(level("linuxcnc"),
+                    "o1 call [0.00000] [0.00000] [-0.04000]\n"
+                    "o1 call [0.25000] [0.00000] [-0.04000]\n"
+                    "o1 call [0.50000] [0.00000] [-0.04000]\n"
+                    "o1 call [0.50000] [0.25000] [-0.04000]\n"
+                    "o1 call [0.50000] [0.30000] [-0.04000]\n"
+                    "o1 call [0.30000] [0.50000] [-0.04000]\n"
+                    "o1 call [0.25000] [0.55000] [-0.04000]\n"
+                    "o1 call [0.10000] [0.70000] [-0.04000]\n"
+                    "o1 call [0.25000] [0.75000] [-0.04000]\n"
+                    "o1 call [0.25000] [0.75000] [-0.04000]\n"
+                    "o1 call [0.50000] [0.83333] [-0.04000]\n"
+                    "o1 call [0.75000] [0.91667] [-0.04000]\n"
+                    "o1 call [1.00000] [1.00000] [-0.04000]\n"
+                    "o1 call [0.30000] [0.60000] [-0.04000]\n");
+}
+
+BOOST_AUTO_TEST_CASE(mach4) {
+  BOOST_CHECK_EQUAL(level("mach4"),
+                    "G65 P1 A0.00000 B0.00000 C-0.04000\n"
+                    "G65 P1 A0.25000 B0.00000 C-0.04000\n"
+                    "G65 P1 A0.50000 B0.00000 C-0.04000\n"
+                    "G65 P1 A0.50000 B0.25000 C-0.04000\n"
+                    "G65 P1 A0.50000 B0.30000 C-0.04000\n"
+                    "G65 P1 A0.30000 B0.50000 C-0.04000\n"
+                    "G65 P1 A0.25000 B0.55000 C-0.04000\n"
+                    "G65 P1 A0.10000 B0.70000 C-0.04000\n"
+                    "G65 P1 A0.25000 B0.75000 C-0.04000\n"
+                    "G65 P1 A0.25000 B0.75000 C-0.04000\n"
+                    "G65 P1 A0.50000 B0.83333 C-0.04000\n"
+                    "G65 P1 A0.75000 B0.91667 C-0.04000\n"
+                    "G65 P1 A1.00000 B1.00000 C-0.04000\n"
+                    "G65 P1 A0.30000 B0.60000 C-0.04000\n");
+}
+
+BOOST_AUTO_TEST_CASE(mach3) {
+  BOOST_CHECK_EQUAL(level("mach3"),
+                    "#101=0.00000\n"
+                    "#102=0.00000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.25000\n"
+                    "#102=0.00000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.50000\n"
+                    "#102=0.00000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.50000\n"
+                    "#102=0.25000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.50000\n"
+                    "#102=0.30000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.30000\n"
+                    "#102=0.50000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.25000\n"
+                    "#102=0.55000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.10000\n"
+                    "#102=0.70000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.25000\n"
+                    "#102=0.75000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.25000\n"
+                    "#102=0.75000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.50000\n"
+                    "#102=0.83333\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.75000\n"
+                    "#102=0.91667\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=1.00000\n"
+                    "#102=1.00000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n"
+                    "#101=0.30000\n"
+                    "#102=0.60000\n"
+                    "#103=-0.04000\n"
+                    "M98 P1\n");
+}
+
+BOOST_AUTO_TEST_CASE(custom) {
+  BOOST_CHECK_EQUAL(level("custom"),
+                    "#100=#500\n"
+                    "G01 Z[-0.04000+#100]\n"
+                    "#100=#505\n"
+                    "X0.25000 Y0.00000 Z[#100+-0.04000]\n"
+                    "#100=#510\n"
+                    "X0.50000 Y0.00000 Z[#100+-0.04000]\n"
+                    "#100=#511\n"
+                    "X0.50000 Y0.25000 Z[#100+-0.04000]\n"
+                    "#100=[#511+[#512-#511]*0.20000]\n"
+                    "X0.50000 Y0.30000 Z[#100+-0.04000]\n"
+                    "#100=[#507+[#512-#507]*0.20000]\n"
+                    "X0.30000 Y0.50000 Z[#100+-0.04000]\n"
+                    "#100=[#507+[#508-#507]*0.20000]\n"
+                    "X0.25000 Y0.55000 Z[#100+-0.04000]\n"
+                    "#105=[#502+[#503-#502]*0.80000]\n"
+                    "#106=[#507+[#508-#507]*0.80000]\n"
+                    "#100=[#105+[#106-#105]*0.40000]\n"
+                    "X0.10000 Y0.70000 Z[#100+-0.04000]\n"
+                    "#100=#508\n"
+                    "X0.25000 Y0.75000 Z[#100+-0.04000]\n"
+                    "#100=[#508+[#513-#508]*0.00000]\n"
+                    "X0.25000 Y0.75000 Z[#100+-0.04000]\n"
+                    "#100=[#513+[#514-#513]*0.33333]\n"
+                    "X0.50000 Y0.83333 Z[#100+-0.04000]\n"
+                    "#100=[#518+[#519-#518]*0.66667]\n"
+                    "X0.75000 Y0.91667 Z[#100+-0.04000]\n"
+                    "#100=#524\n"
+                    "X1.00000 Y1.00000 Z[#100+-0.04000]\n"
+                    "#105=[#507+[#508-#507]*0.40000]\n"
+                    "#106=[#512+[#513-#512]*0.40000]\n"
+                    "#100=[#105+[#106-#105]*0.20000]\n"
+                    "G01 Z[-0.04000+#100]\n");
+}
+
+// Like the example_board_al_* tests: 10mm between probes on a 4in
+// board, with long random moves so that there are many grid crossings.
+BOOST_AUTO_TEST_CASE(benchmark, *boost::unit_test::disabled()) {
+  for (const string software : {"linuxcnc", "mach4", "mach3", "custom"}) {
+    parse_options(software, "10mm");
+    uniqueCodes ocodes(1);
+    uniqueCodes globalVars(100);
+    autoleveller leveller(options::get_vm(), &ocodes, &globalVars, 0, 0, no_tiling);
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> position(0, 4);
+    linestring_type_fp path;
+    for (size_t i = 0; i < 200000; i++) {
+      path.push_back(point_type_fp(position(gen), position(gen)));
+    }
+    leveller.prepareWorkarea({{0.01, multi_linestring_type_fp{path}}});
+    ostringstream out;
+    const auto start = chrono::steady_clock::now();
+    {
+      GcodeWriter writer(out);
+      leveller.setLastChainPoint(path.front());
+      for (const auto& point : path) {
+        leveller.addChainPoint(writer, point, -0.04);
+      }
+    }
+    cout << software << ": " << out.str().size() << " bytes in "
+         << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds" << endl;
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,9 +2,15 @@
 #include <utility>
 #include <algorithm>
 #include <unordered_map>
+#include <array>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <thread>
 
 #include "geometry.hpp"
 #include "bg_operators.hpp"
+#include "task_graph.hpp"
 
 #include "backtrack.hpp"
 
@@ -15,9 +21,8 @@ using std::pair;
 using std::tuple;
 using std::tie;
 using std::unordered_map;
-using std::set;
+using std::array;
 using std::make_pair;
-using std::priority_queue;
 using std::max;
 using std::sort;
 using std::get;
@@ -67,88 +72,428 @@ struct VertexDegree {
   }
 };
 
+// The input paths as a graph with dense vertex ids.  The ids are
+// assigned in point order so that breaking ties between vertex ids is
+// the same as breaking ties between points.
+class Graph {
+ public:
+  Graph(const vector<pair<linestring_type_fp, bool>>& paths) :
+    paths(paths) {
+    vertices.reserve(paths.size() * 2);
+    for (const auto& ls : paths) {
+      vertices.push_back(ls.first.front());
+      vertices.push_back(ls.first.back());
+    }
+    sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+    degrees.resize(vertices.size(), VertexDegree{0, 0, 0});
+    path_vertices.reserve(paths.size());
+    lengths.reserve(paths.size());
+    offsets.resize(vertices.size() + 1, 0);
+    for (const auto& ls : paths) {
+      const size_t front = vertex_id(ls.first.front());
+      const size_t back = vertex_id(ls.first.back());
+      path_vertices.push_back({front, back});
+      lengths.push_back(bg::length(ls.first));
+      offsets[front + 1]++;
+      if (ls.second) {
+        // bi-directional
+        offsets[back + 1]++;
+        degrees[front].bidi++;
+        degrees[back].bidi++;
+      } else {
+        // directional
+        degrees[front].out++;
+        degrees[back].in++;
+      }
+    }
+    for (size_t v = 0; v < vertices.size(); v++) {
+      offsets[v + 1] += offsets[v];
+    }
+    // The edges from each vertex are in the same order as the input.
+    edges.resize(offsets.back());
+    vector<size_t> fill(offsets.cbegin(), offsets.cend() - 1);
+    for (size_t path = 0; path < paths.size(); path++) {
+      edges[fill[path_vertices[path][0]]++] = path;
+      if (paths[path].second) {
+        edges[fill[path_vertices[path][1]]++] = path;
+      }
+    }
+  }
+
+  size_t vertex_id(const point_type_fp& p) const {
+    return std::lower_bound(vertices.cbegin(), vertices.cend(), p) - vertices.cbegin();
+  }
+
+  // The end of the path that isn't v.
+  size_t other_end(size_t path, size_t v) const {
+    if (paths[path].second && path_vertices[path][1] == v) {
+      // Reversible and this was the wrong end.
+      return path_vertices[path][0];
+    }
+    return path_vertices[path][1];
+  }
+
+  const vector<pair<linestring_type_fp, bool>>& paths;
+  vector<point_type_fp> vertices;
+  // The in, out, and bidi degree of all vertices.  We can't just use
+  // the edges because we will modify this as we go.
+  vector<VertexDegree> degrees;
+  // The front and back vertex of each path.
+  vector<array<size_t, 2>> path_vertices;
+  vector<long double> lengths;
+  // The paths that can be followed out of vertex v are
+  // edges[offsets[v]] to edges[offsets[v+1]-1].
+  vector<size_t> offsets;
+  vector<size_t> edges;
+};
+
+// The longest backtrack that could possibly be worth milling.  A
+// backtrack of length d to a vertex that is a distance m away saves
+// time only if d/g1_speed < up_time + m/g0_speed + down_time and it
+// must also save at least d/in_per_sec.  m is never more than d so
+// that bounds d.  Returns infinity if there is no bound.
+static inline long double max_backtrack_length(
+    const double g1_speed,
+    const double up_time,
+    const double g0_speed,
+    const double down_time,
+    const double in_per_sec) {
+  const long double k = 1.0L / g1_speed - 1.0L / g0_speed;
+  const long double up_down_time = (long double) up_time + down_time;
+  if (std::isinf(in_per_sec)) {
+    if (k <= 0) {
+      return std::numeric_limits<long double>::infinity();
+    }
+    return up_down_time / k;
+  }
+  const long double denominator = 1 + in_per_sec * k;
+  if (denominator <= 0) {
+    return std::numeric_limits<long double>::infinity();
+  }
+  return in_per_sec * up_down_time / denominator;
+}
+
+// The degrees of the vertices as seen by one search.  A speculative
+// search sees the degrees from the start of its batch, changed by its
+// own backtrack.
+class Degrees {
+ public:
+  Degrees(const vector<VertexDegree>& degrees) :
+    degrees(degrees),
+    override_count(0) {}
+
+  const VertexDegree& operator[](size_t v) const {
+    for (size_t i = 0; i < override_count; i++) {
+      if (overrides[i].first == v) {
+        return overrides[i].second;
+      }
+    }
+    return degrees[v];
+  }
+
+  VertexDegree& override_degree(size_t v) {
+    for (size_t i = 0; i < override_count; i++) {
+      if (overrides[i].first == v) {
+        return overrides[i].second;
+      }
+    }
+    overrides[override_count] = make_pair(v, degrees[v]);
+    return overrides[override_count++].second;
+  }
+
+  // The vertices whose degrees differ from the shared ones.
+  vector<size_t> overridden() const {
+    vector<size_t> ret;
+    for (size_t i = 0; i < override_count; i++) {
+      ret.push_back(overrides[i].first);
+    }
+    return ret;
+  }
+
+ private:
+  const vector<VertexDegree>& degrees;
+  array<pair<size_t, VertexDegree>, 2> overrides;
+  size_t override_count;
+};
+
+// Vertices that can end a backtrack, bucketed into square cells that
+// are as wide as the longest useful backtrack.  A search can only
+// succeed if one of them is within that distance of the start, so
+// searches from vertices that have none nearby are skipped.
+class EndVertexGrid {
+ public:
+  EndVertexGrid(const Graph& graph, long double radius) :
+    graph(graph),
+    radius(radius),
+    in_grid(graph.vertices.size(), false),
+    enabled(false) {
+    if (!std::isfinite(radius) || radius <= 0 || graph.vertices.size() == 0) {
+      return;
+    }
+    min_x = max_x = graph.vertices.front().x();
+    min_y = max_y = graph.vertices.front().y();
+    for (const auto& p : graph.vertices) {
+      min_x = std::min(min_x, (long double) p.x());
+      max_x = max(max_x, (long double) p.x());
+      min_y = std::min(min_y, (long double) p.y());
+      max_y = max(max_y, (long double) p.y());
+    }
+    // Too many cells to number means that the radius is so small
+    // that searches are cheap anyway.
+    const long double max_cells = 1 << 30;
+    if ((max_x - min_x) / radius >= max_cells || (max_y - min_y) / radius >= max_cells) {
+      return;
+    }
+    enabled = true;
+    for (size_t v = 0; v < graph.vertices.size(); v++) {
+      update(v);
+    }
+  }
+
+  // Call when the degree of v changes.
+  void update(size_t v) {
+    if (enabled && !in_grid[v] && graph.degrees[v].can_end()) {
+      cells[cell(graph.vertices[v])].push_back(v);
+      in_grid[v] = true;
+    }
+  }
+
+  // True if the grid is used.  If it isn't, searches don't depend
+  // on vertices that they didn't touch.
+  bool is_enabled() const {
+    return enabled;
+  }
+
+  // True if q is close enough to p to be at the other end of a
+  // backtrack.
+  bool is_near(const point_type_fp& p, const point_type_fp& q) const {
+    return abs(q.x() - p.x()) <= radius && abs(q.y() - p.y()) <= radius;
+  }
+
+  // Returns false if no vertex other than start is close enough to
+  // end a backtrack from start.
+  bool any_near(size_t start, const Degrees& degrees) const {
+    if (!enabled) {
+      return true;
+    }
+    const auto& p = graph.vertices[start];
+    // Vertices that can end a backtrack only because of the search's
+    // own backtrack aren't in the grid yet.
+    for (const auto& v : degrees.overridden()) {
+      if (v != start && degrees[v].can_end() && is_near(p, graph.vertices[v])) {
+        return true;
+      }
+    }
+    const uint64_t center = cell(p);
+    const uint64_t cx = center >> 32;
+    const uint64_t cy = center & 0xffffffff;
+    for (uint64_t x = cx - 1; x != cx + 2; x++) {
+      for (uint64_t y = cy - 1; y != cy + 2; y++) {
+        const auto found = cells.find((x << 32) | (y & 0xffffffff));
+        if (found == cells.cend()) {
+          continue;
+        }
+        for (const auto& v : found->second) {
+          if (v != start && degrees[v].can_end() && is_near(p, graph.vertices[v])) {
+            return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+ private:
+  // Cells are numbered from 1 so that the neighbors of the cells on
+  // the edge can also be numbered.
+  uint64_t cell(const point_type_fp& p) const {
+    const uint64_t x = static_cast<uint64_t>((p.x() - min_x) / radius) + 1;
+    const uint64_t y = static_cast<uint64_t>((p.y() - min_y) / radius) + 1;
+    return (x << 32) | y;
+  }
+
+  const Graph& graph;
+  const long double radius;
+  vector<bool> in_grid;
+  bool enabled;
+  long double min_x;
+  long double max_x;
+  long double min_y;
+  long double max_y;
+  unordered_map<uint64_t, vector<size_t>> cells;
+};
+
+// Scratch space for find_nearest_vertex.  It is reused between
+// searches and only the vertices that a search touched are reset
+// afterward, so each search costs only as much as the part of the
+// graph near the start.
+class Search {
+ public:
+  Search(size_t vertex_count) :
+    distances(vertex_count),
+    parents(vertex_count),
+    seen(vertex_count, false),
+    done(vertex_count, false) {}
+
+  void reset() {
+    for (const auto& v : touched) {
+      seen[v] = false;
+      done[v] = false;
+    }
+    touched.clear();
+    to_search.clear();
+  }
+
+  // The best-so-far distance to get to each vertex, along with the
+  // path that gets you there.
+  vector<long double> distances;
+  vector<size_t> parents;
+  vector<bool> seen;
+  vector<bool> done;
+  vector<size_t> touched;
+  // A min-heap of distance and vertex.
+  vector<pair<long double, size_t>> to_search;
+};
+
+// The total length of a backtrack and the paths to take to get there,
+// in the right order and with the right directionality.  Backtracks
+// are ordered by length and then by path.
+struct LengthAndPath {
+  long double length;
+  vector<pair<linestring_type_fp, bool>> path;
+  // The index in the input of each of the paths.
+  vector<size_t> sources;
+
+  bool operator<(const LengthAndPath& other) const {
+    return tie(length, path) < tie(other.length, other.path);
+  }
+  bool operator>(const LengthAndPath& other) const {
+    return other < *this;
+  }
+};
+
 // Use Dijkstra's algorithm to find the shortest path from the start
 // vertex to any of the vertices in the set of possible end vertices.
 // The result is the length of a path and the vector of linestrings
 // that make a path from the start to the end vertex, in the order
 // that they should be used, in the direction that they should be
 // used.
-static inline pair<long double, vector<pair<linestring_type_fp, bool>>> find_nearest_vertex(
-    const unordered_map<point_type_fp, vector<pair<linestring_type_fp, bool>>>& graph,
-    point_type_fp start,
-    const unordered_map<point_type_fp, VertexDegree>& vertex_degrees,
+static inline LengthAndPath find_nearest_vertex(
+    const Graph& graph,
+    const Degrees& degrees,
+    Search& search,
+    const EndVertexGrid& end_vertices,
+    size_t start,
     const double g1_speed,
     const double up_time,
     const double g0_speed,
     const double down_time,
     const double in_per_sec) {
-  if (!vertex_degrees.at(start).can_start()) {
+  search.reset();
+  if (!degrees[start].can_start() || !end_vertices.any_near(start, degrees)) {
     // Starting from here isn't useful.
-    return {0, {}};
-  }
-  // unordered_map from vertex to the best-so-far distance to get to the
-  // vertex, along with the edge that gets you there.  The edge
-  // might be reversed.
-  unordered_map<point_type_fp, pair<long double, pair<linestring_type_fp, bool>>> distances;
-  distances[start] = make_pair(0, make_pair(linestring_type_fp{}, true));
-  priority_queue<pair<long double, point_type_fp>,
-                 vector<pair<long double, point_type_fp>>,
-                 greater<pair<long double, point_type_fp>>> to_search;
-  set<point_type_fp> done;
-  to_search.push(make_pair(0, start));
-  while (to_search.size() > 0) {
-    auto current_vertex = to_search.top().second;
-    to_search.pop();
-    if (start != current_vertex &&
-        vertex_degrees.count(current_vertex) > 0 &&
-        vertex_degrees.at(current_vertex).can_end()) {
+    return {0, {}, {}};
+  }
+  const auto& start_point = graph.vertices[start];
+  search.distances[start] = 0;
+  search.seen[start] = true;
+  search.touched.push_back(start);
+  search.to_search.push_back(make_pair(0, start));
+  while (search.to_search.size() > 0) {
+    const auto current_vertex = search.to_search.front().second;
+    pop_heap(search.to_search.begin(), search.to_search.end(), greater<>());
+    search.to_search.pop_back();
+    if (start != current_vertex && degrees[current_vertex].can_end()) {
       // Found the nearest solution.  Return the edges in the right
       // order with the right directionality.
       vector<pair<linestring_type_fp, bool>> reverse_path;
+      vector<size_t> reverse_sources;
       for (auto v = current_vertex; v != start;) {
-        const auto& e = distances.at(v).second;
-        reverse_path.emplace_back(e);
-        if (e.second && v == e.first.front()) {
+        const auto path = search.parents[v];
+        reverse_path.emplace_back(graph.paths[path]);
+        reverse_sources.push_back(path);
+        if (reverse_path.back().second && v == graph.path_vertices[path][0]) {
           // Bidi edge and it was reversed.
           std::reverse(reverse_path.back().first.begin(), reverse_path.back().first.end());
+          v = graph.path_vertices[path][1];
+        } else {
+          v = graph.path_vertices[path][0];
         }
-        v = reverse_path.back().first.front();
       }
       std::reverse(reverse_path.begin(), reverse_path.end());
-      return {distances[current_vertex].first, reverse_path};
+      std::reverse(reverse_sources.begin(), reverse_sources.end());
+      return {search.distances[current_vertex], std::move(reverse_path), std::move(reverse_sources)};
     }
-    if (done.count(current_vertex)) {
+    if (search.done[current_vertex]) {
       continue; // We already completed this one.
     }
-    for (const auto& edge : graph.at(current_vertex)) {
+    for (size_t e = graph.offsets[current_vertex]; e < graph.offsets[current_vertex + 1]; e++) {
+      const auto path = graph.edges[e];
       // Get end that isn't the current_vertex.
-      point_type_fp new_vertex = edge.first.back();
-      if (edge.second && current_vertex == new_vertex) {
-        // Reversible and this was the wrong end.
-        new_vertex = edge.first.front();
-      }
-      if (done.count(new_vertex)) {
+      const auto new_vertex = graph.other_end(path, current_vertex);
+      if (search.done[new_vertex]) {
         continue;
       }
-      long double new_distance = distances[current_vertex].first + bg::length(edge.first);
-      const auto max_manhattan = max(abs(new_vertex.x() - start.x()), abs(new_vertex.y() - start.y()));
+      long double new_distance = search.distances[current_vertex] + graph.lengths[path];
+      const auto& new_point = graph.vertices[new_vertex];
+      const auto max_manhattan = max(abs(new_point.x() - start_point.x()), abs(new_point.y() - start_point.y()));
       double time_with_backtrack = new_distance / g1_speed;
       double time_without_backtrack = up_time + max_manhattan / g0_speed  + down_time;
       double time_saved = time_without_backtrack - time_with_backtrack;
       if (time_saved < 0 || new_distance / time_saved > in_per_sec) {
         continue; // This is already too far away to be useful.
       }
-      const auto old_distance_pair = distances.find(new_vertex);
-      if (old_distance_pair == distances.cend() || old_distance_pair->second.first > new_distance) {
-        distances[new_vertex] = make_pair(new_distance, edge);
+      if (!search.seen[new_vertex]) {
+        search.seen[new_vertex] = true;
+        search.touched.push_back(new_vertex);
+      } else if (search.distances[new_vertex] <= new_distance) {
+        continue; // Not an improvement.
       }
-      to_search.push(make_pair(distances[new_vertex].first, new_vertex));
+      search.distances[new_vertex] = new_distance;
+      search.parents[new_vertex] = path;
+      search.to_search.push_back(make_pair(new_distance, new_vertex));
+      push_heap(search.to_search.begin(), search.to_search.end(), greater<>());
     }
-    done.insert(current_vertex);
+    search.done[current_vertex] = true;
   }
-  return {0, {}};
+  return {0, {}, {}};
 }
 
+// Add the backtrack to the degrees of its start and end.
+template <typename degrees_t>
+static inline void use_backtrack(const vector<pair<linestring_type_fp, bool>>& backtrack,
+                                 size_t start, size_t end, degrees_t degree) {
+  if (backtrack.front().second) {
+    // Start is reversible.
+    degree(start).bidi++;
+  } else {
+    // Start is not reversible.
+    degree(start).out++;
+  }
+  if (backtrack.back().second) {
+    // End is reversible.
+    degree(end).bidi++;
+  } else {
+    // End is not reversible.
+    degree(end).in++;
+  }
+}
+
+// A backtrack taken from the heap along with the search from its
+// start that comes after it.  The search was done before the
+// backtracks ahead of it in the batch were used, so it is only
+// correct if they didn't change any vertex that it depends on.
+struct Speculation {
+  LengthAndPath backtrack;
+  size_t start;
+  size_t end;
+  bool used;
+  LengthAndPath next;
+  // The vertices that the search touched, if the grid isn't used.
+  vector<size_t> touched;
+};
+
 // Find paths in the input that, if doubled so that they could be
 // traversed twice, would decrease the milling time overall.  The
 // input is a list of paths and the reversibility of each one.  The
@@ -157,48 +502,55 @@ static inline pair<long double, vector<pair<linestring_type_fp, bool>>> find_nea
 vector<pair<linestring_type_fp, bool>> backtrack(
     const vector<pair<linestring_type_fp, bool>>& paths,
     const double g1_speed, const double up_time, const double g0_speed, const double down_time,
-    const double in_per_sec) {
+    const double in_per_sec, unsigned int jobs, vector<size_t>* sources) {
+  if (sources) {
+    sources->clear();
+  }
   if (in_per_sec == 0) {
     return {};
   }
-  // Convert the paths structure to a unordered_map from vector to edges that
-  // meet there.
-  unordered_map<point_type_fp, vector<pair<linestring_type_fp, bool>>> graph;
-  // Find the in, out, and bidi degree of all vertices.  We can't just
-  // use the graph because we will modify this as we go.
-  unordered_map<point_type_fp, VertexDegree> vertex_degrees;
-  for (const auto& ls : paths) {
-    graph[ls.first.front()].push_back(ls);
-    graph[ls.first.back()]; // Create this element even if there are no edges from it.
-    if (ls.second) {
-      // bi-directional
-      graph[ls.first.back()].push_back(ls);
-      vertex_degrees[ls.first.front()].bidi++;
-      vertex_degrees[ls.first.back()].bidi++;
-    } else {
-      // directional
-      vertex_degrees[ls.first.front()].out++;
-      vertex_degrees[ls.first.back()].in++;
-    }
+  if (jobs == 0) {
+    jobs = max(std::thread::hardware_concurrency(), 1U);
   }
+  Graph graph(paths);
+  // A little extra so that rounding in the search never makes it
+  // reach further than the grid expects.
+  const long double radius = max_backtrack_length(g1_speed, up_time, g0_speed, down_time, in_per_sec) *
+                             (1 + 1e-9L);
+  EndVertexGrid end_vertices(graph, radius);
+  // Up to this many searches are done at the same time, each with its
+  // own scratch space.
+  const size_t batch_size = jobs == 1 ? 1 : jobs * 2;
+  vector<Search> searches(batch_size, Search(graph.vertices.size()));
+  TaskGraph tasks;
 
   vector<pair<linestring_type_fp, bool>> backtracks;
-  // best_backtracks stores the total length, the start, the end,
-  // and a list of paths to take to get there, in the right order
-  // and with the right directionality.
-  vector<pair<long double,
-              vector<pair<linestring_type_fp, bool>>>> best_backtracks;
+  vector<LengthAndPath> best_backtracks;
 
   // For each odd-degree vertex, find the nearest odd-degree vertex
-  // using the distance function on the edge.
-  for (const auto& v : vertex_degrees) {
-    // Get the length and path to the nearest element.
-    // find_nearest_vertex returns 0 if there is none that is close
-    // enough or if the start vertex is not can_start(), that is, it
-    // has so many paths out already that it shouldn't get anymore.
-    auto length_and_path = find_nearest_vertex(graph, v.first, vertex_degrees, g1_speed, up_time, g0_speed, down_time, in_per_sec);
-    if (length_and_path.first > 0) {
-      best_backtracks.push_back(length_and_path);
+  // using the distance function on the edge.  The searches are
+  // independent so they are spread over the jobs and the results are
+  // collected in vertex order.
+  {
+    vector<LengthAndPath> nearest(graph.vertices.size());
+    for (size_t job = 0; job < batch_size; job++) {
+      tasks.add([&, job]() {
+        const Degrees degrees(graph.degrees);
+        for (size_t v = job; v < graph.vertices.size(); v += batch_size) {
+          // Get the length and path to the nearest element.
+          // find_nearest_vertex returns 0 if there is none that is close
+          // enough or if the start vertex is not can_start(), that is, it
+          // has so many paths out already that it shouldn't get anymore.
+          nearest[v] = find_nearest_vertex(graph, degrees, searches[job], end_vertices, v,
+                                           g1_speed, up_time, g0_speed, down_time, in_per_sec);
+        }
+      });
+    }
+    tasks.run(jobs);
+    for (auto& length_and_path : nearest) {
+      if (length_and_path.length > 0) {
+        best_backtracks.push_back(std::move(length_and_path));
+      }
     }
   }
   // Now sort so that the shortest backtracks are first.
@@ -209,38 +561,100 @@ vector<pair<linestring_type_fp, bool>> backtrack(
   // or can_end, there is no possibility that the new search will find
   // an even shorter backtrack so we don't need to start from the
   // beginning.
+  //
+  // The backtracks are taken from the heap in batches and the
+  // searches that follow them are done at the same time, each as if
+  // the backtracks ahead of it in the batch weren't used yet.  Then
+  // the batch is applied in order, like one-at-a-time, until a search
+  // turns out to depend on a vertex that changed or finds a backtrack
+  // that should come before the rest of the batch.  The rest goes back
+  // on the heap, so the result is the same for any number of jobs.
+  vector<Speculation> batch;
   while (best_backtracks.size() > 0) {
-    const auto& i = best_backtracks.cbegin();
-    if (vertex_degrees[i->second.front().first.front()].can_start() &&
-        vertex_degrees[i->second.back().first.back()].can_end()) {
-      for (const auto& p : i->second) {
-        backtracks.emplace_back(p);
+    batch.clear();
+    while (batch.size() < batch_size && best_backtracks.size() > 0) {
+      pop_heap(best_backtracks.begin(), best_backtracks.end(), greater<>());
+      batch.push_back(Speculation{std::move(best_backtracks.back()), 0, 0, false, {}, {}});
+      best_backtracks.pop_back();
+    }
+    for (size_t i = 0; i < batch.size(); i++) {
+      tasks.add([&, i]() {
+        auto& speculation = batch[i];
+        const auto& path = speculation.backtrack.path;
+        speculation.start = graph.vertex_id(path.front().first.front());
+        speculation.end = graph.vertex_id(path.back().first.back());
+        Degrees degrees(graph.degrees);
+        speculation.used = degrees[speculation.start].can_start() &&
+                           degrees[speculation.end].can_end();
+        if (speculation.used) {
+          use_backtrack(path, speculation.start, speculation.end,
+                        [&](size_t v) -> VertexDegree& { return degrees.override_degree(v); });
+        }
+        // Because this vertex used to have a backtrack, it might still
+        // have one so look for it.
+        speculation.next = find_nearest_vertex(
+            graph, degrees, searches[i], end_vertices, speculation.start, g1_speed,
+            up_time, g0_speed, down_time, in_per_sec);
+        if (!end_vertices.is_enabled()) {
+          speculation.touched = searches[i].touched;
+        }
+      });
+    }
+    tasks.run(jobs);
+    // The vertices changed by the backtracks used so far in this batch.
+    vector<size_t> changed;
+    size_t i = 0;
+    for (; i < batch.size(); i++) {
+      auto& speculation = batch[i];
+      if (i > 0) {
+        const auto& start_point = graph.vertices[speculation.start];
+        bool conflict = false;
+        for (const auto& v : changed) {
+          // With the grid, the search depends on the vertices near
+          // the start, which include all that it touched.
+          if (v == speculation.start || v == speculation.end ||
+              (end_vertices.is_enabled() ?
+               end_vertices.is_near(start_point, graph.vertices[v]) :
+               std::find(speculation.touched.cbegin(), speculation.touched.cend(), v) !=
+                   speculation.touched.cend())) {
+            conflict = true;
+            break;
+          }
+        }
+        if (conflict) {
+          break;
+        }
       }
-      if (i->second.front().second) {
-        // Start is reversible.
-        vertex_degrees[i->second.front().first.front()].bidi++;
-      } else {
-        // Start is not reversible.
-        vertex_degrees[i->second.front().first.front()].out++;
+      if (speculation.used) {
+        for (const auto& p : speculation.backtrack.path) {
+          backtracks.emplace_back(p);
+        }
+        if (sources) {
+          sources->insert(sources->end(),
+                          speculation.backtrack.sources.cbegin(), speculation.backtrack.sources.cend());
+        }
+        use_backtrack(speculation.backtrack.path, speculation.start, speculation.end,
+                      [&](size_t v) -> VertexDegree& { return graph.degrees[v]; });
+        end_vertices.update(speculation.start);
+        end_vertices.update(speculation.end);
+        changed.push_back(speculation.start);
+        changed.push_back(speculation.end);
       }
-      if (i->second.back().second) {
-        // End is reversible.
-        vertex_degrees[i->second.back().first.back()].bidi++;
-      } else {
-        // End is not reversible.
-        vertex_degrees[i->second.back().first.back()].in++;
+      // Now we can put a new one instead of the used one.
+      if (speculation.next.length > 0) {
+        best_backtracks.push_back(std::move(speculation.next));
+        push_heap(best_backtracks.begin(), best_backtracks.end(), greater<>());
+      }
+      if (i + 1 < batch.size() && best_backtracks.size() > 0 &&
+          best_backtracks.front() < batch[i + 1].backtrack) {
+        // The new one comes before the rest of the batch.
+        i++;
+        break;
       }
     }
-    // Because this vertex used to have a backtrack, it might still
-    // have one so look for it.
-    auto length_and_path = find_nearest_vertex(
-        graph, i->second.front().first.front(), vertex_degrees, g1_speed,
-        up_time, g0_speed, down_time, in_per_sec);
-    // Now we can remove the used one and perhaps put a new one instead.
-    pop_heap(best_backtracks.begin(), best_backtracks.end(), greater<>());
-    best_backtracks.pop_back();
-    if (length_and_path.first > 0) {
-      best_backtracks.push_back(length_and_path);
+    // Return what wasn't applied to the heap.
+    for (; i < batch.size(); i++) {
+      best_backtracks.push_back(std::move(batch[i].backtrack));
       push_heap(best_backtracks.begin(), best_backtracks.end(), greater<>());
     }
   }
@@ -8,11 +8,14 @@ namespace backtrack {
 // input is a list of paths and the reversibility of each one.  The is
 // just the paths that need to be reversed and added.  in_per_sec is
 // the number of inches of unnecessary milling that the user is
-// willing to do in order to save seconds.
+// willing to do in order to save seconds.  The searches are spread
+// over up to jobs threads, 0 for one per CPU core, and the result is
+// the same for any number of jobs.  If sources is not null, it gets
+// the index in paths of each returned path.
 std::vector<std::pair<linestring_type_fp, bool>> backtrack(
     const std::vector<std::pair<linestring_type_fp, bool>>& paths,
     const double g1_speed, const double up_time, const double g0_speed, const double down_time,
-    const double mm_per_second);
+    const double mm_per_second, unsigned int jobs = 1, std::vector<size_t>* sources = nullptr);
 
 } // namespace backtrack
 #endif //BACKTRACK_HPP
@@ -2,6 +2,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include <vector>
+#include <iostream>
+#include <chrono>
 
 #include "geometry.hpp"
 #include "bg_operators.hpp"
@@ -202,4 +204,37 @@ BOOST_AUTO_TEST_CASE(directed_square_and_diagonal) {
   BOOST_CHECK_EQUAL(actual.size(), 2);
 }
 
+BOOST_AUTO_TEST_CASE(same_for_any_jobs) {
+  vector<pair<linestring_type_fp, bool>> paths;
+  size_t i = 0;
+  for (const auto& path : make_grid({0,0}, {0.3,0.3}, 31)) {
+    if (i++ % 5 != 0) {
+      paths.push_back({path.first, i % 3 != 0});
+    }
+  }
+  const auto expected = backtrack::backtrack(paths, 0.2,0.1,1,0.1, 5, 1);
+  BOOST_CHECK_GT(expected.size(), 0);
+  for (unsigned int jobs = 2; jobs <= 8; jobs *= 2) {
+    const auto actual = backtrack::backtrack(paths, 0.2,0.1,1,0.1, 5, jobs);
+    BOOST_CHECK_EQUAL(actual, expected);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(benchmark, *boost::unit_test::disabled()) {
+  // About 100k segments, with some missing so that there are many
+  // odd vertices to search from.
+  vector<pair<linestring_type_fp, bool>> paths;
+  size_t i = 0;
+  for (const auto& path : make_grid({0,0}, {2.24,2.24}, 225)) {
+    if (i++ % 7 != 0) {
+      paths.push_back(path);
+    }
+  }
+  const auto start_time = std::chrono::steady_clock::now();
+  const auto actual = backtrack::backtrack(paths, 0.2,0.1,1,0.1, 5);
+  const std::chrono::duration<double> backtrack_time = std::chrono::steady_clock::now() - start_time;
+  std::cout << paths.size() << " segments, " << actual.size() << " backtracks in "
+            << backtrack_time.count() << " seconds" << std::endl;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
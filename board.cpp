@@ -36,7 +36,16 @@ using std::pair;
 #include <vector>
 using std::vector;
 
+#include <map>
+using std::map;
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
 #include "bg_operators.hpp"
+#include "task_graph.hpp"
+#include "options.hpp"
 
 typedef pair<string, shared_ptr<Layer> > layer_t;
 
@@ -46,39 +55,43 @@ typedef pair<string, shared_ptr<Layer> > layer_t;
 /******************************************************************************/
 Board::Board(bool fill_outline, string outputdir, bool tsp_2opt,
              MillFeedDirection::MillFeedDirection mill_feed_direction, bool invert_gerbers,
-             bool render_paths_to_shapes) :
+             bool render_paths_to_shapes, coordinate_type_fp svg_resolution) :
     margin(0.0),
+    debug_image_index(0),
     fill_outline(fill_outline),
     outputdir(outputdir),
     tsp_2opt(tsp_2opt),
     mill_feed_direction(mill_feed_direction),
     invert_gerbers(invert_gerbers),
-    render_paths_to_shapes(render_paths_to_shapes) {}
+    render_paths_to_shapes(render_paths_to_shapes),
+    svg_resolution(svg_resolution) {}
 
 double Board::get_width() {
   if (layers.size() < 1) {
     return 0;
   }
-  return layers.begin()->second->surface->get_width_in();
+  return bounding_box.max_corner().x() - bounding_box.min_corner().x();
 }
 
 double Board::get_height() {
   if (layers.size() < 1) {
     return 0;
   }
-  return layers.begin()->second->surface->get_height_in();
+  return bounding_box.max_corner().y() - bounding_box.min_corner().y();
 }
 
-void Board::prepareLayer(string layername, shared_ptr<GerberImporter> importer, shared_ptr<RoutingMill> manufacturer, bool backside, bool ymirror) {
+void Board::prepareLayer(string layername, shared_ptr<GerberImporter> importer, shared_ptr<RoutingMill> manufacturer, bool backside, bool ymirror,
+                         coordinate_type_fp simplify) {
   // see comment for prep_t in board.hpp
   prepared_layers.insert(std::make_pair(layername, make_tuple(importer, manufacturer, backside, ymirror)));
+  simplify_tolerances[layername] = simplify;
 }
 
 /******************************************************************************/
 /*
  */
 /******************************************************************************/
-void Board::createLayers()
+void Board::createLayers(unsigned int jobs)
 {
     if (!prepared_layers.size())
       return; // Nothing to do.
@@ -122,8 +135,6 @@ void Board::createLayers()
 
     // board size calculated. create layers
     for (const auto& prepared_layer : prepared_layers) {
-      // prepare the surface
-      shared_ptr<GerberImporter> importer = get<0>(prepared_layer.second);
       const bool fill = fill_outline && prepared_layer.first == "outline";
 
       auto surface = make_shared<Surface_vectorial>(
@@ -131,11 +142,11 @@ void Board::createLayers()
           bounding_box,
           prepared_layer.first, outputdir, tsp_2opt,
           mill_feed_direction, invert_gerbers,
-          render_paths_to_shapes || (prepared_layer.first == "outline"));
+          render_paths_to_shapes || (prepared_layer.first == "outline"),
+          svg_resolution);
       if (fill) {
         surface->enable_filling();
       }
-      surface->render(importer, get<1>(prepared_layer.second)->optimise);
       auto layer = make_shared<Layer>(prepared_layer.first,
                                       surface,
                                       get<1>(prepared_layer.second),
@@ -144,9 +155,21 @@ void Board::createLayers()
       layers.insert(std::make_pair(layer->get_name(), layer));
     }
 
-    // DEBUG output
-    for (layer_t layer : layers) {
-      layer.second->surface->save_debug_image(string("original_") + layer.second->get_name());
+    // Render each layer, along with its DEBUG output.  The layers are
+    // independent of one another so they can be done concurrently.
+    TaskGraph tasks;
+    map<string, TaskGraph::TaskId> rendered;
+    for (const auto& layer : layers) {
+      const auto& prepared_layer = prepared_layers.at(layer.first);
+      shared_ptr<GerberImporter> importer = get<0>(prepared_layer);
+      const double optimise = get<1>(prepared_layer)->optimise;
+      const double simplify = simplify_tolerances.at(layer.first);
+      shared_ptr<Surface_vectorial> surface = layer.second->surface;
+      const unsigned int index = debug_image_index++;
+      rendered[layer.first] = tasks.add([=]() {
+          surface->render(importer, optimise, simplify);
+          surface->save_debug_image(string("original_") + layer.first, index);
+        });
     }
 
     // mask layers with outline
@@ -157,11 +180,50 @@ void Board::createLayers()
 
       for (const auto& layer : layers) {
         if (layer.second != outline_layer) {
-          layer.second->add_mask(outline_layer);
-          layer.second->surface->save_debug_image(string("masked_") + layer.second->get_name());
+          shared_ptr<Layer> current_layer = layer.second;
+          const unsigned int index = debug_image_index++;
+          tasks.add([=]() {
+              current_layer->add_mask(outline_layer);
+              current_layer->surface->save_debug_image(string("masked_") + current_layer->get_name(), index);
+            }, {rendered.at(layer.first), rendered.at("outline")});
         }
       }
     }
+    tasks.run(jobs);
+}
+
+void Board::loadLayers(const toolpath_file::Toolpaths& toolpaths) {
+  bounding_box = toolpaths.bounding_box;
+  for (const auto& prepared_layer : prepared_layers) {
+    const auto saved = std::find_if(toolpaths.layers.cbegin(), toolpaths.layers.cend(),
+                                    [&](const toolpath_file::LayerToolpaths& layer) {
+                                      return layer.name == prepared_layer.first;
+                                    });
+    if (saved == toolpaths.layers.cend()) {
+      throw std::invalid_argument("There is no " + prepared_layer.first + " layer in the toolpaths file.");
+    }
+    // The cutter needs the bridges of each path.
+    if (dynamic_pointer_cast<Cutter>(get<1>(prepared_layer.second)) && !saved->toolpaths.empty() &&
+        saved->bridges.size() != saved->toolpaths[0].second.size()) {
+      throw std::invalid_argument("The " + prepared_layer.first + " layer in the toolpaths file doesn't have the bridges of each path.");
+    }
+    auto layer = make_shared<Layer>(*saved, get<1>(prepared_layer.second));
+    // The saved paths were found for one side and one list of tools so
+    // they are wrong for any other.
+    if (saved->backside != get<2>(prepared_layer.second)) {
+      options::maybe_throw("The " + prepared_layer.first + " layer in the toolpaths file was made for the " +
+                           (saved->backside ? "back" : "front") + " side but now it is on the " +
+                           (saved->backside ? "front" : "back") + " side.", ERR_INVALIDPARAMETER);
+    }
+    const auto tool_diameters = layer->get_tool_diameters();
+    if (!std::equal(tool_diameters.cbegin(), tool_diameters.cend(),
+                    saved->tool_diameters.cbegin(), saved->tool_diameters.cend(),
+                    [](coordinate_type_fp a, coordinate_type_fp b) { return std::abs(a - b) < 1e-9; })) {
+      options::maybe_throw("The " + prepared_layer.first + " layer in the toolpaths file was made for different tools.",
+                           ERR_INVALIDPARAMETER);
+    }
+    layers.insert(std::make_pair(prepared_layer.first, layer));
+  }
 }
 
 /******************************************************************************/
@@ -34,6 +34,7 @@
 #include "geometry.hpp"
 #include "surface_vectorial.hpp"
 #include "layer.hpp"
+#include "toolpath_file.hpp"
 
 #include "mill.hpp"
 
@@ -52,10 +53,14 @@ public:
     Board(bool fill_outline,
           std::string outputdir, bool tsp_2opt,
           MillFeedDirection::MillFeedDirection mill_feed_direction, bool invert_gerbers,
-          bool render_paths_to_shapes);
+          bool render_paths_to_shapes, coordinate_type_fp svg_resolution = 0);
 
+    // If simplify is more than 0, the shapes are simplified to that
+    // tolerance with simplify::simplify instead of with the optimise
+    // tolerance of the manufacturer.
     void prepareLayer(std::string layername, std::shared_ptr<GerberImporter> importer,
-                      std::shared_ptr<RoutingMill> manufacturer, bool backside, bool ymirror);
+                      std::shared_ptr<RoutingMill> manufacturer, bool backside, bool ymirror,
+                      coordinate_type_fp simplify = 0);
     void set_margins(double margins) { margin = margins; }
     coordinate_type_fp get_width();
     coordinate_type_fp get_height();
@@ -66,16 +71,22 @@ public:
     std::shared_ptr<Layer> get_layer(std::string layername);
     std::vector<std::pair<coordinate_type_fp, multi_linestring_type_fp>> get_toolpath(std::string layername);
 
-    void createLayers(); // should be private
+    // jobs is the number of threads to use, 0 for one per CPU core.
+    void createLayers(unsigned int jobs = 1); // should be private
+    // Instead of createLayers, make the prepared layers from toolpaths
+    // saved by an earlier run.  The importers aren't used.
+    void loadLayers(const toolpath_file::Toolpaths& toolpaths);
 
 private:
     coordinate_type_fp margin;
+    unsigned int debug_image_index;
     const bool fill_outline;
     const std::string outputdir;
     const bool tsp_2opt;
     const MillFeedDirection::MillFeedDirection mill_feed_direction;
     const bool invert_gerbers;
     const bool render_paths_to_shapes;
+    const coordinate_type_fp svg_resolution;
 
     box_type_fp bounding_box{{INFINITY, INFINITY}, {-INFINITY, -INFINITY}};
 
@@ -90,6 +101,7 @@ private:
      */
     typedef std::tuple<std::shared_ptr<GerberImporter>, std::shared_ptr<RoutingMill>, bool, bool> prep_t;
     std::map<std::string, prep_t> prepared_layers;
+    std::map<std::string, coordinate_type_fp> simplify_tolerances;
     std::map<std::string, std::shared_ptr<Layer> > layers;
 };
 
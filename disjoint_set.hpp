@@ -1,7 +1,9 @@
 #ifndef DISJOINT_SET_HPP
 #define DISJOINT_SET_HPP
 
+#include <numeric>
 #include <unordered_map>
+#include <vector>
 
 template <typename node_t>
 class DisjointSet {
@@ -54,4 +56,43 @@ class DisjointSet {
   std::unordered_map<node_t, size_t> rank;
 };
 
+// The same for nodes that are numbered from 0 to size-1, which is
+// faster because there is no hashing.  It uses path halving and joins
+// the smaller set to the larger one.
+class DenseDisjointSet {
+ public:
+  DenseDisjointSet(size_t size) :
+    parent(size),
+    size(size, 1) {
+    std::iota(parent.begin(), parent.end(), 0);
+  }
+
+  size_t find(size_t node) {
+    while (parent[node] != node) {
+      parent[node] = parent[parent[node]];
+      node = parent[node];
+    }
+    return node;
+  }
+
+  void join(size_t x, size_t y) {
+    x = find(x);
+    y = find(y);
+    if (x == y) {
+      return;
+    }
+    if (size[x] < size[y]) {
+      std::swap(x, y);
+    }
+    parent[y] = x;
+    size[x] += size[y];
+  }
+
+ private:
+  // Stores the parent for each node.  Roots are their own parents.
+  std::vector<size_t> parent;
+  // Stores the number of nodes in the set of each root.
+  std::vector<size_t> size;
+};
+
 #endif // DISJOINT_SET_HPP
@@ -1,6 +1,10 @@
 #define BOOST_TEST_MODULE disjoint set tests
 #include <boost/test/unit_test.hpp>
 
+#include <chrono>
+#include <iostream>
+#include <random>
+
 #include "disjoint_set.hpp"
 
 BOOST_AUTO_TEST_SUITE(disjoint_set_tests)
@@ -27,4 +31,69 @@ BOOST_AUTO_TEST_CASE(simple2) {
   BOOST_CHECK(d.find(1) == d.find(3));
 }
 
+BOOST_AUTO_TEST_CASE(dense) {
+  DenseDisjointSet d(10);
+  BOOST_CHECK(d.find(2) != d.find(3));
+  d.join(3,2);
+  BOOST_CHECK(d.find(2) == d.find(3));
+  BOOST_CHECK(d.find(9) != d.find(3));
+  d.join(4,5);
+  BOOST_CHECK(d.find(4) == d.find(5));
+  BOOST_CHECK(d.find(4) != d.find(3));
+  d.join(5,2);
+  BOOST_CHECK(d.find(4) == d.find(3));
+  BOOST_CHECK(d.find(0) != d.find(3));
+}
+
+// Both kinds of disjoint set agree on random joins.
+BOOST_AUTO_TEST_CASE(dense_same_as_sparse) {
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<size_t> node(0, 999);
+  DisjointSet<size_t> sparse;
+  DenseDisjointSet dense(1000);
+  for (int i = 0; i < 2000; i++) {
+    const size_t x = node(gen);
+    const size_t y = node(gen);
+    BOOST_CHECK_EQUAL(sparse.find(x) == sparse.find(y), dense.find(x) == dense.find(y));
+    if (i % 3 == 0) {
+      sparse.join(x, y);
+      dense.join(x, y);
+    }
+  }
+}
+
+// Many finds and joins like final_path_finder makes.
+BOOST_AUTO_TEST_CASE(benchmark, *boost::unit_test::disabled()) {
+  const size_t nodes = 100000;
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<size_t> node(0, nodes - 1);
+  std::vector<std::pair<size_t, size_t>> pairs;
+  for (size_t i = 0; i < nodes * 10; i++) {
+    pairs.emplace_back(node(gen), node(gen));
+  }
+  size_t sparse_joins = 0;
+  auto start_time = std::chrono::steady_clock::now();
+  DisjointSet<size_t> sparse;
+  for (const auto& p : pairs) {
+    if (sparse.find(p.first) != sparse.find(p.second)) {
+      sparse.join(p.first, p.second);
+      sparse_joins++;
+    }
+  }
+  const std::chrono::duration<double> sparse_time = std::chrono::steady_clock::now() - start_time;
+  size_t dense_joins = 0;
+  start_time = std::chrono::steady_clock::now();
+  DenseDisjointSet dense(nodes);
+  for (const auto& p : pairs) {
+    if (dense.find(p.first) != dense.find(p.second)) {
+      dense.join(p.first, p.second);
+      dense_joins++;
+    }
+  }
+  const std::chrono::duration<double> dense_time = std::chrono::steady_clock::now() - start_time;
+  BOOST_CHECK_EQUAL(sparse_joins, dense_joins);
+  std::cout << pairs.size() << " pairs: DisjointSet " << sparse_time.count()
+            << " seconds, DenseDisjointSet " << dense_time.count() << " seconds" << std::endl;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -26,7 +26,6 @@ using std::ofstream;
 #include <cstring>
 
 #include <iostream>
-using std::cout;
 using std::endl;
 using std::flush;
 
@@ -59,6 +58,9 @@ using std::map;
 #include "units.hpp"
 #include "available_drills.hpp"
 #include "bg_operators.hpp"
+#include "svg_writer.hpp"
+#include "gcode_writer.hpp"
+#include "task_graph.hpp"
 
 using std::pair;
 using std::make_pair;
@@ -68,6 +70,12 @@ using std::ios_base;
 using std::left;
 using std::to_string;
 
+// The fewest holes that are drilled with a loop, which takes a few lines
+// to set up.
+static const size_t min_array_holes = 8;
+// The coordinates are written with 5 decimals.
+static const double output_resolution = 1e-5;
+
 /******************************************************************************/
 /*
  Constructor
@@ -86,6 +94,10 @@ ExcellonProcessor::ExcellonProcessor(const boost::program_options::variables_map
     drillfront(workSide(options, "drill")),
     inputFactor(options["metric"].as<bool>() ? 1.0/25.4 : 1),
     tsp_2opt(options["tsp-2opt"].as<bool>()),
+    compact_gcode(options["compact-gcode"].as<bool>()),
+    drill_arrays(options["drill-arrays"].as<bool>()),
+    optimise_drill_order(options["optimise-drill-order"].as<bool>()),
+    jobs(options["jobs"].as<unsigned int>()),
     xoffset((options["zero-start"].as<bool>() ? min.x() : 0) -
             options["x-offset"].as<Length>().asInch(inputFactor)),
     yoffset((options["zero-start"].as<bool>() ? min.y() : 0) -
@@ -119,6 +131,18 @@ ExcellonProcessor::ExcellonProcessor(const boost::program_options::variables_map
     preamble += "G90       (Absolute coordinates.)\n";
 
     tiling = std::make_unique<Tiling>(tileInfo, cfactor, ocodes.getUniqueCode());
+
+    // The subroutine and the two repeats in it for linuxcnc, or the two
+    // subroutines for mach3/mach4.
+    arraySub = ocodes.getUniqueCode();
+    ocodes.getUniqueCode();
+    ocodes.getUniqueCode();
+    // x, y, the step in x and y, the step to the next row in x and y and
+    // for mach3/mach4 the number of holes in each row.
+    arrayVar = globalVars.getUniqueCode();
+    for (int i = 1; i < 7; i++) {
+        globalVars.getUniqueCode();
+    }
 }
 
 /******************************************************************************/
@@ -184,6 +208,9 @@ string ExcellonProcessor::drill_to_string(drillbit drillbit) {
 }
 
 linestring_type_fp ExcellonProcessor::line_to_holes(const linestring_type_fp& line, double drill_diameter) {
+    if (line.size() > 2) {
+        return line; // Already the holes of an array, from hole_arrays::group.
+    }
     auto start_x = line.front().x();
     auto start_y = line.front().y();
     auto stop_x = line.back().x();
@@ -248,8 +275,6 @@ void ExcellonProcessor::export_ngc(const string of_dir, const boost::optional<st
                                    bool nog81, bool nom6, bool zchange_absolute) {
     stringstream zchange;
 
-    cout << "Exporting drill... ";
-
     zchange << setprecision(3) << fixed << driller->zchange * cfactor;
 
     tiling->setGCodeEnd((zchange_absolute ? "G53 " : "") + string("G00 Z") + zchange.str() +
@@ -260,7 +285,7 @@ void ExcellonProcessor::export_ngc(const string of_dir, const boost::optional<st
                          "M2      (Program end.)\n\n");
 
     map<int, drillbit> bits = optimize_bits();
-    const auto holes = optimize_holes(bits, onedrill, boost::none, min_milldrill_diameter);
+    const auto holes = optimize_holes(bits, onedrill, boost::none, min_milldrill_diameter, drill_arrays);
 
     //open output file
     std::ofstream of;
@@ -273,13 +298,106 @@ void ExcellonProcessor::export_ngc(const string of_dir, const boost::optional<st
         throw std::invalid_argument(error_message.str());
       }
     }
+
+    // The bits are written to body first so that the header and the
+    // subroutines for the arrays can tell if some array was found.
+    std::ostringstream body;
+    body.setf(ios_base::fixed);
+    body.precision(5);
+    bool wrote_array = false;
+    for (const auto& hole : holes) {
+        const auto& bit = bits.at(hole.first);
+        if (zchange_absolute) {
+            body << "G53 ";
+        }
+        body << "G00 Z" << driller->zchange * cfactor << " (Retract)\n" << "T"
+             << hole.first << "\n" << "M5      (Spindle stop.)\n"
+             << "G04 P" << driller->spindown_time
+             << "\n(MSG, Change tool bit to drill size "
+             << drill_to_string(bit) << ")\n"
+             << (nom6?"":"M6      (Tool change.)\n")
+             << "M0      (Temporary machine stop.)\n"
+             << "M3      (Spindle on clockwise.)\n"
+             << "G0 Z" << driller->zsafe * cfactor << "\n"
+             << "G04 P" << driller->spinup_time << "\n\n";
+
+        if( nog81 )
+            body << "G1 F" << driller->feed * cfactor << '\n';
+
+        double drill_diameter = bit.unit == "mm" ? bit.diameter / 25.4 : bit.diameter;
+        GcodeWriter writer(body, compact_gcode);
+        // The first hole starts the G81 cycle.  The subroutines for the
+        // arrays start it themselves.
+        bool g81_line = !nog81;
+        const auto write_hole = [&](const point_type_fp& drill_hole) {
+            if( nog81 )
+            {
+                writer << "G0 X" << drill_hole.x() << " Y" << drill_hole.y() << "\n";
+                writer << "G1 Z" << driller->zwork * cfactor << '\n';
+                writer << "G1 Z" << driller->zsafe * cfactor << '\n';
+            }
+            else if (g81_line)
+            {
+                writer << "G81 R" << driller->zsafe * cfactor << " Z" << driller->zwork * cfactor
+                       << " F" << driller->feed * cfactor << " X" << drill_hole.x() << " Y" << drill_hole.y() << "\n";
+                g81_line = false;
+            }
+            else
+            {
+                writer << "X" << drill_hole.x() << " Y" << drill_hole.y() << "\n";
+            }
+        };
+        for( unsigned int i = 0; i < tileInfo.tileY; i++ )
+        {
+            const double yoffsetTot = yoffset - i * tileInfo.boardHeight;
+
+            for( unsigned int j = 0; j < tileInfo.tileX; j++ )
+            {
+                const double xoffsetTot = xoffset - ( i % 2 ? tileInfo.tileX - j - 1 : j ) * tileInfo.boardWidth;
+
+                vector<point_type_fp> drill_holes;
+                for (const auto& line : hole.second) {
+                    for (auto& drill_hole : line_to_holes(line, drill_diameter)) {
+                        drill_holes.push_back(point_type_fp(( get_xvalue(drill_hole.x()) - xoffsetTot ) * cfactor,
+                                                            ( get_yvalue(drill_hole.y()) - yoffsetTot ) * cfactor));
+                    }
+                }
+                const auto arrays = drill_arrays ?
+                    hole_arrays::find(drill_holes, min_array_holes, output_resolution) :
+                    vector<hole_arrays::HoleArray>();
+                auto array = arrays.cbegin();
+                for (size_t k = 0; k < drill_holes.size(); ) {
+                    if (array != arrays.cend() && array->first == k) {
+                        write_array(writer, *array);
+                        wrote_array = true;
+                        g81_line = false;
+                        k += array->size();
+                        array++;
+                    } else {
+                        write_hole(drill_holes[k]);
+                        k++;
+                    }
+                }
+            }
+        }
+        writer.flush();
+        if (!nog81) {
+          body << "G80\n"; // End the G81 from before.
+        }
+        body << "\n";
+    }
+
     //write header to .ngc file
     for (string s : header)
     {
         of << "( " << s << " )" << "\n";
     }
 
-    of << "( Software-independent Gcode )\n";
+    // The subroutines for the arrays only work on the chosen software.
+    if (wrote_array)
+        of << "( Gcode for " << tileInfo.software << " )\n";
+    else
+        of << "( Software-independent Gcode )\n";
 
     if (!onedrill)
     {
@@ -305,72 +423,167 @@ void ExcellonProcessor::export_ngc(const string of_dir, const boost::optional<st
 
     //tiling->header( of );     // See TODO #2
 
-    for (const auto& hole : holes) {
-        const auto& bit = bits.at(hole.first);
-        if (zchange_absolute) {
-            of << "G53 ";
-        }
-        of << "G00 Z" << driller->zchange * cfactor << " (Retract)\n" << "T"
-           << hole.first << "\n" << "M5      (Spindle stop.)\n"
-           << "G04 P" << driller->spindown_time
-           << "\n(MSG, Change tool bit to drill size "
-           << drill_to_string(bit) << ")\n"
-           << (nom6?"":"M6      (Tool change.)\n")
-           << "M0      (Temporary machine stop.)\n"
-           << "M3      (Spindle on clockwise.)\n"
-           << "G0 Z" << driller->zsafe * cfactor << "\n"
-           << "G04 P" << driller->spinup_time << "\n\n";
+    if (wrote_array && tileInfo.software == Software::LINUXCNC) {
+        write_array_subroutines(of, driller, nog81);
+    }
+    of << body.str();
 
-        if( nog81 )
-            of << "G1 F" << driller->feed * cfactor << '\n';
-        else
-        {
-            of << "G81 R" << driller->zsafe * cfactor << " Z"
-               << driller->zwork * cfactor << " F" << driller->feed * cfactor << " ";
-        }
+    //tiling->footer( of ); // See TODO #2
+    of << tiling->getGCodeEnd();
 
-        double drill_diameter = bit.unit == "mm" ? bit.diameter / 25.4 : bit.diameter;
-        for( unsigned int i = 0; i < tileInfo.tileY; i++ )
-        {
-            const double yoffsetTot = yoffset - i * tileInfo.boardHeight;
+    // mach3 and mach4 have the subroutines after the end of the program.
+    if (wrote_array && tileInfo.software != Software::LINUXCNC) {
+        write_array_subroutines(of, driller, nog81);
+    }
 
-            for( unsigned int j = 0; j < tileInfo.tileX; j++ )
-            {
-                const double xoffsetTot = xoffset - ( i % 2 ? tileInfo.tileX - j - 1 : j ) * tileInfo.boardWidth;
+    of.close();
 
-                for (const auto& line : hole.second) {
-                    for (auto& drill_hole : line_to_holes(line, drill_diameter)) {
-                        const auto x = drill_hole.x();
-                        const auto y = drill_hole.y();
-
-                        if( nog81 )
-                        {
-                            of << "G0 X" << ( ( get_xvalue(x) - xoffsetTot ) * cfactor)
-                               <<   " Y" << ( ( get_yvalue(y) - yoffsetTot ) * cfactor) << "\n";
-                            of << "G1 Z" << driller->zwork * cfactor << '\n';
-                            of << "G1 Z" << driller->zsafe * cfactor << '\n';
-                        }
-                        else
-                        {
-                            of << "X" << ( ( get_xvalue(x) - xoffsetTot ) * cfactor)
-                              << " Y" << ( ( get_yvalue(y) - yoffsetTot ) * cfactor) << "\n";
-                        }
-                    }
-                }
-            }
-        }
-        if (!nog81) {
-          of << "G80\n"; // End the G81 from before.
+    save_svg(bits, holes, of_dir, "original_drill.svg");
+}
+
+/******************************************************************************/
+/*
+ Writes the subroutines that drill an array of holes.  The position of the
+ next hole and the steps are in the variables from arrayVar, see write_array.
+ linuxcnc has one subroutine that is called with the number of holes in a
+ row and the number of rows.  mach3 and mach4 can't loop in a subroutine so
+ one subroutine drills a hole and is called for each hole in a row by
+ another, which is called for each row.
+ */
+/******************************************************************************/
+void ExcellonProcessor::write_array_subroutines(std::ostream& of, shared_ptr<Driller> driller,
+                                                bool nog81) {
+    const auto var = [this](unsigned int i) {
+        return "#" + to_string(arrayVar + i);
+    };
+    const auto drill_hole = [&]() {
+        if (nog81) {
+            of << "G0 X" << var(0) << " Y" << var(1) << "\n"
+               << "G1 Z" << driller->zwork * cfactor << "\n"
+               << "G1 Z" << driller->zsafe * cfactor << "\n";
+        } else {
+            // The array might be the first holes of the bit, before the
+            // G81 cycle was started.
+            of << "G81 R" << driller->zsafe * cfactor << " Z" << driller->zwork * cfactor
+               << " F" << driller->feed * cfactor << " X" << var(0) << " Y" << var(1) << "\n";
         }
-        of << "\n";
+        of << var(0) << "=[" << var(0) << "+" << var(2) << "]\n"
+           << var(1) << "=[" << var(1) << "+" << var(3) << "]\n";
+    };
+    // Back to the last hole, over to the next row and then the other way.
+    const auto next_row = [&]() {
+        of << var(0) << "=[" << var(0) << "-" << var(2) << "+" << var(4) << "]\n"
+           << var(1) << "=[" << var(1) << "-" << var(3) << "+" << var(5) << "]\n"
+           << var(2) << "=[0-" << var(2) << "]\n"
+           << var(3) << "=[0-" << var(3) << "]\n";
+    };
+
+    if (tileInfo.software == Software::LINUXCNC) {
+        of << "o" << arraySub << " sub ( Drill an array of holes )\n"
+           << "o" << arraySub + 1 << " repeat [#2]\n"
+           << "o" << arraySub + 2 << " repeat [#1]\n";
+        drill_hole();
+        of << "o" << arraySub + 2 << " endrepeat\n";
+        next_row();
+        of << "o" << arraySub + 1 << " endrepeat\n"
+           << "o" << arraySub << " endsub\n\n";
+    } else {
+        of << "\nO" << arraySub + 1 << " ( Drill a hole of an array )\n";
+        drill_hole();
+        of << "M99\n\n"
+           << "O" << arraySub << " ( Drill a row of an array )\n"
+           << "M98 P" << arraySub + 1 << " L" << var(6) << "\n";
+        next_row();
+        of << "M99\n\n";
     }
+}
 
-    //tiling->footer( of ); // See TODO #2
-    of << tiling->getGCodeEnd();
+/******************************************************************************/
+/*
+ Drills the array with the subroutines from write_array_subroutines.
+ */
+/******************************************************************************/
+void ExcellonProcessor::write_array(GcodeWriter& writer, const hole_arrays::HoleArray& array) {
+    const auto set = [&](unsigned int i, double value) {
+        writer << "#" << arrayVar + i << "=" << value << "\n";
+    };
+    set(0, array.start.x());
+    set(1, array.start.y());
+    set(2, array.step.x());
+    set(3, array.step.y());
+    if (array.rows > 1) {
+        set(4, array.row_step.x());
+        set(5, array.row_step.y());
+    }
+    if (tileInfo.software == Software::LINUXCNC) {
+        writer << "o" << arraySub << " call [" << array.columns << "] [" << array.rows << "]\n";
+    } else {
+        writer << "#" << arrayVar + 6 << "=" << array.columns << "\n"
+               << "M98 P" << arraySub << " L" << array.rows << "\n";
+    }
+}
 
-    of.close();
+/******************************************************************************/
+/*
+ *  the G-code for milling a round hole of this diameter, apart from where it is
+ */
+/******************************************************************************/
+ExcellonProcessor::MillholeTemplate ExcellonProcessor::millhole_template(
+    shared_ptr<Cutter> cutter, double holediameter)
+{
+    MillholeTemplate hole;
+    double cutdiameter = cutter->tool_diameter;
+    int stepcount = (int) ceil(std::abs(cutter->zwork / cutter->stepsize));
+    const auto append = [](string& out, double value) {
+        GcodeWriter::append_fixed(out, value, 5);
+    };
+
+    hole.drilled = cutdiameter * 1.001 >= holediameter;
+    hole.mill_x = 0;
+    hole.mill_y = 0;
+    if (hole.drilled) {
+        hole.plunge = "G1 Z";
+        append(hole.plunge, cutter->zwork * cfactor);
+    } else {
+        // Start directly north of the center and go around.
+        hole.mill_y = (holediameter - cutdiameter) / 2.;      //mill radius
+        if (mill_feed_direction == MillFeedDirection::CLIMB) {
+            hole.mill_x = -hole.mill_x;
+            hole.mill_y = -hole.mill_y;
+        }
+        // Start one step above Z0 for optimal entry
+        hole.plunge = "G1 Z";
+        append(hole.plunge, -1.0/stepcount * cutter->zwork * cfactor);
+    }
+    hole.plunge += " F";
+    append(hole.plunge, cutter->vertfeed * cfactor);
+    hole.plunge += '\n';
+    if (!hole.drilled && holediameter > 1.1 * cutdiameter) {
+        hole.plunge += "G1 F";
+        append(hole.plunge, cutter->feed * cfactor);
+        hole.plunge += '\n';
+    }
 
-    save_svg(bits, holes, of_dir, "original_drill.svg");
+    hole.arc = mill_feed_direction == MillFeedDirection::CLIMB ? "G3" : "G2";
+    if (!hole.drilled) {
+        for (int current_step = -1; current_step <= stepcount; current_step++) {
+            // Drop superfluous Z from the bottom hole to indicate that this line is not there by accident
+            string z;
+            if (stepcount != current_step) {
+                double depth = double(std::min(stepcount, current_step+1))/stepcount * cutter->zwork;
+                z = " Z";
+                append(z, depth * cfactor);
+            }
+            hole.z.push_back(z);
+        }
+    }
+
+    hole.retract = "G1 Z";
+    append(hole.retract, cutter->zsafe * cfactor);
+    hole.retract += " F";
+    append(hole.retract, cutter->vertfeed * cfactor);
+    hole.retract += "\n\n";
+    return hole;
 }
 
 /******************************************************************************/
@@ -378,17 +591,42 @@ void ExcellonProcessor::export_ngc(const string of_dir, const boost::optional<st
  *  mill one circle, returns false if tool is bigger than the circle
  */
 /******************************************************************************/
-bool ExcellonProcessor::millhole(std::ofstream &of, double start_x, double start_y,
+bool ExcellonProcessor::millhole(GcodeWriter& writer, double start_x, double start_y,
                                  double stop_x, double stop_y,
                                  shared_ptr<Cutter> cutter,
-                                 double holediameter)
+                                 double holediameter,
+                                 const MillholeTemplate& round_hole)
 {
 
     g_assert(cutter);
-    double cutdiameter = cutter->tool_diameter;
     bool slot = (start_x != stop_x ||
                  start_y != stop_y);
 
+    if (!slot) {
+        // Every hole of this size is the same, just moved.
+        if (round_hole.drilled) {
+            writer << "G0 X" << start_x * cfactor << " Y" << start_y * cfactor << '\n'
+                   << round_hole.plunge << round_hole.retract;
+            return false;
+        }
+        const double start_targetx = start_x + round_hole.mill_y;
+        const double start_targety = start_y - round_hole.mill_x;
+        writer << "G0 X" << start_targetx * cfactor << " Y" << start_targety * cfactor << '\n'
+               << round_hole.plunge;
+        for (const auto& z : round_hole.z) {
+            // Just drill a full-circle.
+            writer << round_hole.arc
+                   << " X" << start_targetx * cfactor
+                   << " Y" << start_targety * cfactor << z
+                   << " I" << (start_x-start_targetx) * cfactor
+                   << " J" << (start_y-start_targety) * cfactor << "\n";
+        }
+        writer << round_hole.retract;
+        return true;
+    }
+
+    double cutdiameter = cutter->tool_diameter;
+
     // Find the largest z_step that divides 0 through z_work into
     // evenly sized passes such that each pass is at most
     // cutter->stepsize in depth.
@@ -398,60 +636,46 @@ bool ExcellonProcessor::millhole(std::ofstream &of, double start_x, double start
     double delta_y = stop_y - start_y;
     double distance = sqrt(delta_x*delta_x + delta_y*delta_y);
     if (cutdiameter * 1.001 >= holediameter) { //In order to avoid a "zero radius arc" error
-        // Hole is smaller than cutdiameter so just drill/zig-zag.
-        of << "G0 X" << start_x * cfactor << " Y" << start_y * cfactor << '\n';
-        if (slot) {
-            // Start one step above Z0 for optimal entry
-            of << "G1 Z" << -1.0/stepcount * cutter->zwork * cfactor
+        // Hole is smaller than cutdiameter so just zig-zag.
+        writer << "G0 X" << start_x * cfactor << " Y" << start_y * cfactor << '\n';
+        // Start one step above Z0 for optimal entry
+        writer << "G1 Z" << -1.0/stepcount * cutter->zwork * cfactor
                << " F" << cutter->vertfeed * cfactor << '\n';
 
-            // Is there enough room for material evacuation?
-            if (distance > 0.3 * cutdiameter) {
-                of << "G1 F" << cutter->feed * cfactor << '\n';
-            }
+        // Is there enough room for material evacuation?
+        if (distance > 0.3 * cutdiameter) {
+            writer << "G1 F" << cutter->feed * cfactor << '\n';
+        }
 
-            double zhalfstep = cutter->zwork / stepcount / 2;
-            for (int current_step = -1; true; current_step++) {
-                // current_step == stepcount is for the bottom pass, so z needs to stay the same
-                double z = double(std::min(stepcount, current_step+1))/stepcount * cutter->zwork;
-                of << "G1 X" << stop_x * cfactor
+        double zhalfstep = cutter->zwork / stepcount / 2;
+        for (int current_step = -1; true; current_step++) {
+            // current_step == stepcount is for the bottom pass, so z needs to stay the same
+            double z = double(std::min(stepcount, current_step+1))/stepcount * cutter->zwork;
+            writer << "G1 X" << stop_x * cfactor
                    << " Y" << stop_y * cfactor;
-                if(stepcount != current_step) {
-                   // Drop superfluous Z from the bottom pass to indicate that this line is not there by accident
-                   of << " Z" << (z - zhalfstep) * cfactor;
-                }
-                of << '\n';
-                // We don't need a second "zag" on the bottom pass
-                if (current_step >= stepcount) {
-                    break;
-                }
-                of << "G1 X" << start_x * cfactor
+            if(stepcount != current_step) {
+               // Drop superfluous Z from the bottom pass to indicate that this line is not there by accident
+               writer << " Z" << (z - zhalfstep) * cfactor;
+            }
+            writer << '\n';
+            // We don't need a second "zag" on the bottom pass
+            if (current_step >= stepcount) {
+                break;
+            }
+            writer << "G1 X" << start_x * cfactor
                    << " Y" << start_y * cfactor
                    << " Z" << z * cfactor
                    << '\n';
-            }
-        } else {
-            of << "G1 Z" << cutter->zwork * cfactor
-               << " F" << cutter->vertfeed * cfactor << '\n';
         }
-        of << "G1 Z" << cutter->zsafe * cfactor
-           << " F" << cutter->vertfeed * cfactor << "\n\n";
+        writer << "G1 Z" << cutter->zsafe * cfactor
+               << " F" << cutter->vertfeed * cfactor << "\n\n";
 
         return false;
     } else {
-        // Hole is larger than cutter diameter so make circles/ovals.
+        // Hole is larger than cutter diameter so make ovals.
         double millr = (holediameter - cutdiameter) / 2.;      //mill radius
-        double mill_x;
-        double mill_y;
-        if (slot) {
-          mill_x = delta_x*millr/distance;
-          mill_y = delta_y*millr/distance;
-        } else {
-          // No distance so just use a start that is directly north
-          // of the start.
-          mill_x = 0;
-          mill_y = millr;
-        }
+        double mill_x = delta_x*millr/distance;
+        double mill_y = delta_y*millr/distance;
         // We will draw a shape that looks like a rectangle with
         // half circles attached on just two opposite sides.
         if (mill_feed_direction == MillFeedDirection::CLIMB) {
@@ -472,85 +696,67 @@ bool ExcellonProcessor::millhole(std::ofstream &of, double start_x, double start
         double stop2_targetx = stop_x + mill_y;
         double stop2_targety = stop_y - mill_x;
 
-        of << "G0 X" << start_targetx * cfactor << " Y" << start_targety * cfactor << '\n';
+        writer << "G0 X" << start_targetx * cfactor << " Y" << start_targety * cfactor << '\n';
 
         // Distribute z step depth on half circles and straight lines for slots
-        double zdiff_hcircle1 = 0;
-        double zdiff_line1 = 0;
-        double zdiff_hcircle2 = 0;
         // Distance traveled by one half circle
         double dist_hcircle = boost::math::constants::pi<double>() * millr;
-        if (slot) {
-          // How much to step down per pass
-          double zstep = cutter->zwork / stepcount;
-          double zstep_hcircle = zstep * dist_hcircle / (dist_hcircle + distance) / 2;
-          double zstep_line    = zstep / 2 - zstep_hcircle;
-          // How much to substract from the final z depth of each pass
-          zdiff_hcircle1 = zstep - zstep_hcircle;
-          zdiff_line1    = zstep / 2;
-          zdiff_hcircle2 = zstep_line;
-        }
+        // How much to step down per pass
+        double zstep = cutter->zwork / stepcount;
+        double zstep_hcircle = zstep * dist_hcircle / (dist_hcircle + distance) / 2;
+        double zstep_line    = zstep / 2 - zstep_hcircle;
+        // How much to substract from the final z depth of each pass
+        double zdiff_hcircle1 = zstep - zstep_hcircle;
+        double zdiff_line1    = zstep / 2;
+        double zdiff_hcircle2 = zstep_line;
 
         // Start one step above Z0 for optimal entry
-        of << "G1 Z" << -1.0/stepcount * cutter->zwork * cfactor
-           << " F" << cutter->vertfeed * cfactor << '\n';
+        writer << "G1 Z" << -1.0/stepcount * cutter->zwork * cfactor
+               << " F" << cutter->vertfeed * cfactor << '\n';
 
         // Is hole is big enough for horizontal speed?
         if (holediameter + distance > 1.1 * cutdiameter) {
-          of << "G1 F" << cutter->feed * cfactor << '\n';
+          writer << "G1 F" << cutter->feed * cfactor << '\n';
         }
 
         string arc_gcode = mill_feed_direction == MillFeedDirection::CLIMB ? "G3" : "G2";
         for (int current_step = -1; current_step <= stepcount; current_step++) {
           // current_step == stepcount is for the bottom circle for helix, so z needs to stay the same
           double z = double(std::min(stepcount, current_step+1))/stepcount * cutter->zwork;
-          if (!slot) {
-            // Just drill a full-circle.
-            of << arc_gcode
-               << " X" << start_targetx * cfactor
-               << " Y" << start_targety * cfactor;
-            if(stepcount != current_step) {
-               // Drop superfluous Z from the bottom hole to indicate that this line is not there by accident
-               of << " Z" << z * cfactor;
-            }
-            of << " I" << (start_x-start_targetx) * cfactor
-               << " J" << (start_y-start_targety) * cfactor << "\n";
-          } else {
-            // Draw the first half circle
-            of << arc_gcode << " X" << start2_targetx * cfactor
-               << " Y" << start2_targety * cfactor;
-            if(stepcount != current_step) {
-              of << " Z" << (z - zdiff_hcircle1) * cfactor;
-            }
-            of << " I" << (start_x-start_targetx) * cfactor
-               << " J" << (start_y-start_targety) * cfactor << "\n";
-            // Now across to the second half circle
-            of << "G1 X" << stop_targetx * cfactor
-               << " Y" << stop_targety * cfactor;
-            if(stepcount != current_step) {
-              of << " Z" << (z - zdiff_line1) * cfactor;
-            }
-            of << "\n";
-            // Draw the second half circle
-            of << arc_gcode << " X" << stop2_targetx * cfactor
-               << " Y" << stop2_targety * cfactor;
-            if(stepcount != current_step) {
-              of << " Z" << (z - zdiff_hcircle2) * cfactor;
-            }
-            of << " I" << (stop_x-stop_targetx) * cfactor
-               << " J" << (stop_y-stop_targety) * cfactor << "\n";
-            // Now back to the start of the first half circle
-            of << "G1 X" << start_targetx * cfactor
-               << " Y" << start_targety * cfactor;
-            if(stepcount != current_step) {
-              of << " Z" << z * cfactor;
-            }
-            of << "\n";
+          // Draw the first half circle
+          writer << arc_gcode << " X" << start2_targetx * cfactor
+                 << " Y" << start2_targety * cfactor;
+          if(stepcount != current_step) {
+            writer << " Z" << (z - zdiff_hcircle1) * cfactor;
+          }
+          writer << " I" << (start_x-start_targetx) * cfactor
+                 << " J" << (start_y-start_targety) * cfactor << "\n";
+          // Now across to the second half circle
+          writer << "G1 X" << stop_targetx * cfactor
+                 << " Y" << stop_targety * cfactor;
+          if(stepcount != current_step) {
+            writer << " Z" << (z - zdiff_line1) * cfactor;
           }
+          writer << "\n";
+          // Draw the second half circle
+          writer << arc_gcode << " X" << stop2_targetx * cfactor
+                 << " Y" << stop2_targety * cfactor;
+          if(stepcount != current_step) {
+            writer << " Z" << (z - zdiff_hcircle2) * cfactor;
+          }
+          writer << " I" << (stop_x-stop_targetx) * cfactor
+                 << " J" << (stop_y-stop_targety) * cfactor << "\n";
+          // Now back to the start of the first half circle
+          writer << "G1 X" << start_targetx * cfactor
+                 << " Y" << start_targety * cfactor;
+          if(stepcount != current_step) {
+            writer << " Z" << z * cfactor;
+          }
+          writer << "\n";
         }
 
-        of << "G1 Z" << cutter->zsafe * cfactor
-           << " F" << cutter->vertfeed * cfactor << "\n\n";
+        writer << "G1 Z" << cutter->zsafe * cfactor
+               << " F" << cutter->vertfeed * cfactor << "\n\n";
 
         return true;
     }
@@ -562,8 +768,6 @@ void ExcellonProcessor::export_ngc(const string of_dir, const boost::optional<st
     unsigned int badHoles = 0;
     stringstream zchange;
 
-    cout << "Exporting milldrill... " << flush;
-
     zchange << setprecision(6) << fixed << target->zchange * cfactor;
     tiling->setGCodeEnd((zchange_absolute ? "G53 " : "") + string("G00 Z") + zchange.str() +
                         " ( All done -- retract )\n" + postamble_ext +
@@ -574,7 +778,7 @@ void ExcellonProcessor::export_ngc(const string of_dir, const boost::optional<st
 
     map<int, drillbit> bits = parsed_bits;
     const auto holes =
-        optimize_holes(bits, false, min_milldrill_diameter, boost::none);
+        optimize_holes(bits, false, min_milldrill_diameter, boost::none, false);
 
     // open output file
     std::ofstream of;
@@ -631,20 +835,41 @@ void ExcellonProcessor::export_ngc(const string of_dir, const boost::optional<st
        << "G04 P" << target->spinup_time << "\n"
        << "G00 Z" << target->zsafe * cfactor << "\n\n";
 
+    // Each tile starts at the first hole and ends at the last one.
+    const auto first = std::find_if(holes.cbegin(), holes.cend(),
+                                    [](const pair<int, multi_linestring_type_fp>& hole) { return !hole.second.empty(); });
+    const auto last = std::find_if(holes.crbegin(), holes.crend(),
+                                   [](const pair<int, multi_linestring_type_fp>& hole) { return !hole.second.empty(); });
+    if (first != holes.cend()) {
+        tiling->optimiseOrder(point_type_fp(get_xvalue(first->second.front().front().x()),
+                                            get_yvalue(first->second.front().front().y())),
+                              point_type_fp(get_xvalue(last->second.back().back().x()),
+                                            get_yvalue(last->second.back().back().y())));
+    }
     tiling->header( of );
 
-    for( unsigned int i = 0; i < tileInfo.forYNum; i++ )
-    {
-        const double yoffsetTot = yoffset - i * tileInfo.boardHeight;
+    // The round holes of each size are all milled the same way.
+    vector<MillholeTemplate> round_holes;
+    for (const auto& hole : holes) {
+        const auto& bit = bits.at(hole.first);
+        double diameter = bit.unit == "mm" ? bit.diameter / 25.4 : bit.diameter;
+        round_holes.push_back(millhole_template(target, diameter));
+    }
 
-        for( unsigned int j = 0; j < tileInfo.forXNum; j++ )
+    for( unsigned int i = 0; i < tiling->lines(); i++ )
+    {
+        for( unsigned int j = 0; j < tiling->steps(); j++ )
         {
-            const double xoffsetTot = xoffset - ( i % 2 ? tileInfo.forXNum - j - 1 : j ) * tileInfo.boardWidth;
+            const auto tile = tiling->tile( i, j );
+            const double xoffsetTot = xoffset - tile.first * tileInfo.boardWidth;
+            const double yoffsetTot = yoffset - tile.second * tileInfo.boardHeight;
 
             if( tileInfo.enabled && tileInfo.software == Software::CUSTOM )
-                of << "( Piece #" << j + 1 + i * tileInfo.forXNum << ", position [" << j << ";" << i << "] )\n\n";
+                of << "( Piece #" << j + 1 + i * tiling->steps() << ", position [" << tile.first << ";" << tile.second << "] )\n\n";
 
-            for (const auto& hole : holes) {
+            GcodeWriter writer(of, compact_gcode);
+            for (size_t hole_index = 0; hole_index < holes.size(); hole_index++) {
+                const auto& hole = holes[hole_index];
                 const auto& bit = bits.at(hole.first);
                 double diameter = bit.unit == "mm" ? bit.diameter / 25.4 : bit.diameter;
                 for (const auto& line : hole.second) {
@@ -652,10 +877,10 @@ void ExcellonProcessor::export_ngc(const string of_dir, const boost::optional<st
                     const auto& start_y = line.front().y();
                     const auto& end_x = line.back().x();
                     const auto& end_y = line.back().y();
-                    if (!millhole(of,
+                    if (!millhole(writer,
                                   get_xvalue(start_x) - xoffsetTot, get_yvalue(start_y) - yoffsetTot,
                                   get_xvalue(end_x  ) - xoffsetTot, get_yvalue(  end_y) - yoffsetTot,
-                                  target, diameter)) {
+                                  target, diameter, round_holes[hole_index])) {
                         ++badHoles;
                     }
                 }
@@ -688,28 +913,14 @@ void ExcellonProcessor::save_svg(
     if (holes.size() == 0) {
       return;
     }
-    const coordinate_type_fp width = (board_dimensions.max_corner().x() - board_dimensions.min_corner().x()) * SVG_PIX_PER_IN;
-    const coordinate_type_fp height = (board_dimensions.max_corner().y() - board_dimensions.min_corner().y()) * SVG_PIX_PER_IN;
-    const coordinate_type_fp viewBox_width = (board_dimensions.max_corner().x() - board_dimensions.min_corner().x()) * SVG_DOTS_PER_IN;
-    const coordinate_type_fp viewBox_height = (board_dimensions.max_corner().y() - board_dimensions.min_corner().y()) * SVG_DOTS_PER_IN;
-
-    //Some SVG readers does not behave well when viewBox is not specified
-    const string svg_dimensions =
-        str(boost::format("width=\"%1%\" height=\"%2%\" viewBox=\"0 0 %3% %4%\"") % width % height % viewBox_width % viewBox_height);
-
-    ofstream svg_out (build_filename(of_dir, of_name));
-    bg::svg_mapper<point_type_fp> mapper (svg_out, viewBox_width, viewBox_height, svg_dimensions);
-
-    mapper.add(board_dimensions);
+    svg_writer image(build_filename(of_dir, of_name), board_dimensions);
 
     for (const auto& hole : holes) {
         const auto& bit = bits.at(hole.first);
         const double radius = bit.unit == "mm" ? (bit.diameter / 25.4) / 2 : bit.diameter / 2;
 
         for (const linestring_type_fp& line : hole.second) {
-            for (auto& hole : line_to_holes(line, radius*2)) {
-                mapper.map(hole, "", radius * SVG_DOTS_PER_IN);
-            }
+            image.add(line_to_holes(line, radius*2), radius);
         }
     }
 }
@@ -777,7 +988,7 @@ map<int, multi_linestring_type_fp> ExcellonProcessor::parse_holes() {
 vector<pair<int, multi_linestring_type_fp>> ExcellonProcessor::optimize_holes(
     map<int, drillbit>& bits, bool onedrill,
     const boost::optional<Length>& min_diameter,
-    const boost::optional<Length>& max_diameter) {
+    const boost::optional<Length>& max_diameter, bool group_arrays) {
   map<int, multi_linestring_type_fp> holes(parsed_holes);
 
   // Holes that are larger than max_diameter or smaller than min_diameter are removed.
@@ -829,23 +1040,72 @@ vector<pair<int, multi_linestring_type_fp>> ExcellonProcessor::optimize_holes(
     }
   }
 
-  //Optimize the holes path
-  for (auto& path : holes) {
-    if (tsp_2opt) {
-      tsp_solver::tsp_2opt(path.second, point_type_fp(get_xvalue(0) + xoffset, get_yvalue(0) + yoffset));
-    } else {
-      tsp_solver::nearest_neighbour(path.second, point_type_fp(get_xvalue(0) + xoffset, get_yvalue(0) + yoffset));
+  // Drill each array of holes as one path, from one end to the other.
+  if (group_arrays) {
+    for (auto& path : holes) {
+      path.second = hole_arrays::group(path.second, min_array_holes, output_resolution / 2 / cfactor);
     }
   }
 
   // Sort the holes in ascending drill size order.
-  //  vector<pair<int, multi_linestring_type_fp>> sorted_holes(holes.cbegin(), holes.cend());
   vector<pair<int, multi_linestring_type_fp>> sorted_holes(holes.cbegin(), holes.cend());
 
   std::sort(sorted_holes.begin(), sorted_holes.end(), [&bits](const auto& a, const auto& b) {
     return bits[a.first].as_length().asInch(1) < bits[b.first].as_length().asInch(1);
   });
 
+  const point_type_fp origin(get_xvalue(0) + xoffset, get_yvalue(0) + yoffset);
+  if (optimise_drill_order) {
+    // After a tool change, the next bit starts where the last one
+    // finished, so each path is found starting from there, one bit after
+    // the other.  The 2opt is slow, so it is run on all the bits at the
+    // same time, each starting from where the quick nearest neighbour
+    // path of the bit before finished.
+    vector<point_type_fp> starts;
+    point_type_fp start = origin;
+    for (auto& path : sorted_holes) {
+      starts.push_back(start);
+      tsp_solver::nearest_neighbour(path.second, start);
+      start = path.second.back().back();
+    }
+    if (tsp_2opt) {
+      TaskGraph tasks;
+      for (size_t i = 0; i < sorted_holes.size(); i++) {
+        tasks.add([&sorted_holes, &starts, i]() {
+          tsp_solver::tsp_2opt(sorted_holes[i].second, starts[i]);
+        });
+      }
+      tasks.run(jobs);
+    }
+    // The 2opt might finish the bit before somewhere else.  Each path
+    // is as long either way around so start it from the end that is
+    // nearer.
+    for (size_t i = 1; i < sorted_holes.size(); i++) {
+      const auto& finish = sorted_holes[i-1].second.back().back();
+      auto& path = sorted_holes[i].second;
+      if (bg::comparable_distance(finish, path.back().back()) <
+          bg::comparable_distance(finish, path.front().front())) {
+        std::reverse(path.begin(), path.end());
+        for (auto& line : path) {
+          std::reverse(line.begin(), line.end());
+        }
+      }
+    }
+  } else {
+    //Optimize the holes path of each bit.  The bits don't depend on each
+    //other so they are optimized at the same time.
+    TaskGraph tasks;
+    for (auto& path : sorted_holes) {
+      tasks.add([this, &path, &origin]() {
+        if (tsp_2opt) {
+          tsp_solver::tsp_2opt(path.second, origin);
+        } else {
+          tsp_solver::nearest_neighbour(path.second, origin);
+        }
+      });
+    }
+    tasks.run(jobs);
+  }
 
   return sorted_holes;
 }
@@ -907,3 +1167,12 @@ void ExcellonProcessor::set_postamble(string _postamble)
 {
     postamble_ext = _postamble;
 }
+
+/******************************************************************************/
+/*
+ */
+/******************************************************************************/
+void ExcellonProcessor::set_jobs(unsigned int _jobs)
+{
+    jobs = _jobs;
+}
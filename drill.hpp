@@ -45,6 +45,8 @@ class drill_exception: virtual std::exception, virtual boost::exception
 #include "unique_codes.hpp"
 #include "units.hpp"
 #include "available_drills.hpp"
+#include "hole_arrays.hpp"
+#include "gcode_writer.hpp"
 
 /******************************************************************************/
 /*
@@ -82,6 +84,8 @@ public:
     void add_header(std::string);
     void set_preamble(std::string);
     void set_postamble(std::string);
+    // Threads for optimizing the bits, 0 for one per core.
+    void set_jobs(unsigned int jobs);
     linestring_type_fp line_to_holes(const linestring_type_fp& line, double drill_diameter);
     void export_ngc(const std::string of_dir, const boost::optional<std::string>& of_name,
                     std::shared_ptr<Driller> target, bool onedrill, bool nog81, bool nom6, bool zchange_absolute);
@@ -99,10 +103,25 @@ private:
   std::map<int, drillbit> parse_bits();
   std::map<int, multi_linestring_type_fp> parse_holes();
 
-    bool millhole(std::ofstream &of,
+    // The G-code for milling a round hole, which is the same for every
+    // hole of the same diameter apart from where it is.
+    struct MillholeTemplate {
+        bool drilled;   // The cutter isn't smaller than the hole.
+        double mill_x;  // From the center to the start of the circles.
+        double mill_y;
+        std::string plunge;
+        std::string arc;
+        std::vector<std::string> z;  // The Z of each circle, if it changes.
+        std::string retract;
+    };
+    MillholeTemplate millhole_template(std::shared_ptr<Cutter> cutter, double holediameter);
+    bool millhole(GcodeWriter& writer,
                   double start_x, double start_y,
                   double stop_x, double stop_y,
-                  std::shared_ptr<Cutter> cutter, double holediameter);
+                  std::shared_ptr<Cutter> cutter, double holediameter,
+                  const MillholeTemplate& round_hole);
+    void write_array_subroutines(std::ostream& of, std::shared_ptr<Driller> driller, bool nog81);
+    void write_array(GcodeWriter& writer, const hole_arrays::HoleArray& array);
     double get_xvalue(double);
     double get_yvalue(double);
     std::string drill_to_string(drillbit drillbit);
@@ -110,7 +129,7 @@ private:
   std::vector<std::pair<int, multi_linestring_type_fp>> optimize_holes(
       std::map<int, drillbit>& bits, bool onedrill,
       const boost::optional<Length>& min_diameter,
-      const boost::optional<Length>& max_diameter);
+      const boost::optional<Length>& max_diameter, bool group_arrays);
   std::map<int, drillbit> optimize_bits();
 
     void save_svg(
@@ -135,6 +154,10 @@ private:
     const bool drillfront;
     const double inputFactor;   //Multiply unitless inputs by this value.
     const bool tsp_2opt;        // Perform TSP 2opt optimization on drill path.
+    const bool compact_gcode;   // Leave out what doesn't change from line to line.
+    const bool drill_arrays;    // Drill arrays of holes with a loop in a subroutine.
+    const bool optimise_drill_order; // Start each bit from the end nearer to the bit before it.
+    unsigned int jobs;          // Threads for optimizing the bits, 0 for one per core.
     const double xoffset;
     const double yoffset;
     const Length mirror_axis;
@@ -147,6 +170,10 @@ private:
     uniqueCodes globalVars;
     const Tiling::TileInfo tileInfo;
     std::unique_ptr<Tiling> tiling;
+    // For drill_arrays, the first of the O-codes and of the variables for
+    // the loop.
+    unsigned int arraySub;
+    unsigned int arrayVar;
 };
 
 #endif // DRILL_H
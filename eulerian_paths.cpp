@@ -18,7 +18,7 @@ multi_linestring_type_fp make_eulerian_paths(const multi_linestring_type_fp& pat
   for (const auto& ls : paths) {
     path_to_simplify.push_back(std::make_pair(ls, reversible));
   }
-  path_to_simplify = segmentize::segmentize_paths(path_to_simplify);
+  path_to_simplify = segmentize::segmentize_paths(std::move(path_to_simplify));
   if (unique) {
     path_to_simplify = segmentize::unique(path_to_simplify);
   }
@@ -27,7 +27,7 @@ multi_linestring_type_fp make_eulerian_paths(const multi_linestring_type_fp& pat
       linestring_type_fp>(path_to_simplify);
   multi_linestring_type_fp ret;
   for (auto& eulerian_path : eulerian_paths) {
-    ret.push_back(eulerian_path.first);
+    ret.push_back(std::move(eulerian_path.first));
   }
   return ret;
 }
@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <map>
+#include <array>
+#include <algorithm>
+#include <limits>
 #include <unordered_set>
 #include <unordered_map>
 
@@ -39,6 +42,10 @@ static inline std::ostream& operator<<(std::ostream& out, const Side& s) {
   return out;
 }
 
+// The source of a segment in an Eulerian path that didn't come from
+// any of the input paths.
+const size_t no_source = std::numeric_limits<size_t>::max();
+
 // Made public for testing.
 static inline bool must_start_helper(size_t out_edges, size_t in_edges, size_t bidi_edges) {
   if (out_edges > in_edges + bidi_edges) {
@@ -65,14 +72,17 @@ static inline bool must_start_helper(size_t out_edges, size_t in_edges, size_t b
  *
  * After adding paths, build the Eulerian paths.  The resulting paths
  * cover all segments in the input paths with the minimum number of
- * paths as described above.
+ * paths as described above.  If sources is not null, it gets, for
+ * each resulting path, the index of the input path that each of its
+ * segments came from, or no_source for a segment that joins a loop
+ * that couldn't be closed to the rest of the path.
  */
 template <typename point_t, typename linestring_t>
 class eulerian_paths {
  public:
   eulerian_paths(const std::vector<std::pair<linestring_t, bool>>& paths) :
     paths(paths) {}
-  std::vector<std::pair<linestring_t, bool>> get() {
+  std::vector<std::pair<linestring_t, bool>> get(std::vector<std::vector<size_t>>* sources = nullptr) {
     /* We use Hierholzer's algorithm to find the minimum cycles.  First, make a
      * path from each vertex with more paths out than in.  In the reversible
      * case, that means an odd path count.  Follow the path until it ends.
@@ -105,13 +115,23 @@ class eulerian_paths {
     add_paths_to_maps();
 
     std::vector<std::pair<linestring_t, bool>> euler_paths;
-    for (const auto& vertex : all_start_vertices) {
+    if (sources) {
+      sources->clear();
+    }
+    for (size_t vertex = 0; vertex < vertices.size(); vertex++) {
+      if (!is_start_vertex[vertex]) {
+        continue;
+      }
       while (must_start(vertex)) {
         // Make a path starting from vertex with odd count.
         linestring_t new_path;
-        new_path.push_back(vertex);
-        bool reversible = make_path(vertex, &new_path);
-        euler_paths.push_back(std::make_pair(new_path, reversible));
+        new_path.push_back(vertices[vertex]);
+        std::vector<size_t> new_sources;
+        bool reversible = make_path(vertex, &new_path, sources ? &new_sources : nullptr);
+        euler_paths.push_back(std::make_pair(std::move(new_path), reversible));
+        if (sources) {
+          sources->push_back(std::move(new_sources));
+        }
       }
       // The vertex is no longer must_start.  So it must have the same or fewer
       // out edges than in edges, even accounting for bidi edges becoming in
@@ -124,23 +144,29 @@ class eulerian_paths {
     // if we make a path from one, it is sure to end back where it started.
     // We'll go over all our current Euler paths and stitch in loops anywhere
     // that there is an unvisited edge.
-    for (auto& euler_path : euler_paths) {
-      stitch_loops(&euler_path);
+    for (size_t i = 0; i < euler_paths.size(); i++) {
+      stitch_loops(&euler_paths[i], sources ? &(*sources)[i] : nullptr);
     }
 
     // Anything remaining is loops on islands.  Make all those paths, too.
-    // Prefer directional edges so do those first.
-    for (auto start_map : {&start_vertex_to_unvisited_path_index, &bidi_vertex_to_unvisited_path_index}) {
-      while (start_map->size() > 0) {
-        const auto vertex = start_map->cbegin()->first;
-        std::pair<linestring_t, bool> new_path;
-        new_path.first.push_back(vertex);
-        bool reversible = make_path(vertex, &(new_path.first));
-        new_path.second = reversible;
-        // We can stitch right now because all vertices already have even number
-        // of edges.
-        stitch_loops(&new_path);
-        euler_paths.push_back(new_path);
+    // Prefer directional edges so do those first.  The vertices are in
+    // order so this always starts from the smallest vertex with edges.
+    for (auto edges : {&out_edges, &bidi_edges}) {
+      for (size_t vertex = 0; vertex < vertices.size(); vertex++) {
+        while (edges->unvisited[vertex] > 0) {
+          std::pair<linestring_t, bool> new_path;
+          new_path.first.push_back(vertices[vertex]);
+          std::vector<size_t> new_sources;
+          bool reversible = make_path(vertex, &(new_path.first), sources ? &new_sources : nullptr);
+          new_path.second = reversible;
+          // We can stitch right now because all vertices already have even number
+          // of edges.
+          stitch_loops(&new_path, sources ? &new_sources : nullptr);
+          euler_paths.push_back(std::move(new_path));
+          if (sources) {
+            sources->push_back(std::move(new_sources));
+          }
+        }
       }
     }
 
@@ -148,38 +174,149 @@ class eulerian_paths {
   }
 
  private:
-  bool must_start(const point_t& vertex) const {
+  // The edges at each vertex, stored contiguously by vertex (CSR) in
+  // the order that they were added.  Each is an index into the input
+  // paths and which end of the path is at the vertex.  Edges are
+  // marked as visited instead of being removed.
+  struct Edges {
+    void reset(size_t vertex_count) {
+      offsets.assign(vertex_count + 1, 0);
+      entries.clear();
+      visited.clear();
+      cursor.clear();
+      unvisited.clear();
+      total_unvisited = 0;
+    }
+    // Call once for each edge before finalize.
+    void count(size_t vertex) {
+      offsets[vertex + 1]++;
+    }
+    void finalize() {
+      for (size_t i = 1; i < offsets.size(); i++) {
+        offsets[i] += offsets[i-1];
+      }
+      entries.resize(offsets.back());
+      visited.assign(offsets.back(), false);
+      cursor.assign(offsets.cbegin(), offsets.cend() - 1);
+      unvisited.assign(offsets.size() - 1, 0);
+    }
+    // Call in the same order as count.  Returns the position of the edge.
+    size_t add(size_t vertex, size_t path_index, Side side) {
+      const size_t position = offsets[vertex] + unvisited[vertex];
+      entries[position] = std::make_pair(path_index, side);
+      unvisited[vertex]++;
+      total_unvisited++;
+      return position;
+    }
+    void visit(size_t vertex, size_t position) {
+      visited[position] = true;
+      unvisited[vertex]--;
+      total_unvisited--;
+      while (cursor[vertex] < offsets[vertex + 1] && visited[cursor[vertex]]) {
+        cursor[vertex]++;
+      }
+    }
+
+    std::vector<size_t> offsets;
+    std::vector<std::pair<size_t, Side>> entries;
+    std::vector<bool> visited;
+    // The first edge at each vertex that might not be visited.
+    std::vector<size_t> cursor;
+    std::vector<size_t> unvisited;
+    size_t total_unvisited;
+  };
+
+  bool must_start(size_t vertex) const {
     // A vertex must be a starting point if there are more out edges than in
     // edges, even after using the bidi edges.
-    auto out_edges = start_vertex_to_unvisited_path_index.count(vertex);
-    auto in_edges = end_vertex_to_unvisited_path_index.count(vertex);
-    auto bidi_edges = bidi_vertex_to_unvisited_path_index.count(vertex);
-    return must_start_helper(out_edges, in_edges, bidi_edges);
+    return must_start_helper(out_edges.unvisited[vertex],
+                             in_edges.unvisited[vertex],
+                             bidi_edges.unvisited[vertex]);
   }
 
-  void add_paths_to_maps() {
-    // Reset the maps
-    start_vertex_to_unvisited_path_index.clear();
-    bidi_vertex_to_unvisited_path_index.clear();
-    end_vertex_to_unvisited_path_index.clear();
-    all_start_vertices.clear();
+  size_t intern(const point_t& point) {
+    auto inserted = vertex_ids.emplace(point, vertices.size());
+    if (inserted.second) {
+      vertices.push_back(point);
+    }
+    return inserted.first->second;
+  }
 
+  void add_paths_to_maps() {
+    // Give each vertex a dense id.
+    vertex_ids.clear();
+    vertices.clear();
+    vertex_ids.reserve(paths.size() * 2);
+    path_vertices.assign(paths.size(), {{0, 0}});
     for (size_t i = 0; i < paths.size(); i++) {
-      auto& path = paths[i].first;
+      const auto& path = paths[i].first;
       if (path.size() < 2) {
         // Valid path must have a start and end.
         continue;
       }
-      point_t start = path.front();
-      point_t end = path.back();
-      all_start_vertices.insert(start);
+      path_vertices[i][0] = intern(path.front());
+      path_vertices[i][1] = intern(path.back());
+    }
+    // Renumber the ids in the order of the points so that vertices are
+    // visited in the same order as a std::set of points would be.
+    std::vector<size_t> order(vertices.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return vertices[a] < vertices[b];
+      });
+    std::vector<size_t> new_id(vertices.size());
+    std::vector<point_t> sorted_vertices;
+    sorted_vertices.reserve(vertices.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      new_id[order[i]] = i;
+      sorted_vertices.push_back(vertices[order[i]]);
+    }
+    vertices.swap(sorted_vertices);
+    for (auto& point_and_id : vertex_ids) {
+      point_and_id.second = new_id[point_and_id.second];
+    }
+
+    out_edges.reset(vertices.size());
+    bidi_edges.reset(vertices.size());
+    in_edges.reset(vertices.size());
+    is_start_vertex.assign(vertices.size(), false);
+    for (size_t i = 0; i < paths.size(); i++) {
+      if (paths[i].first.size() < 2) {
+        continue;
+      }
+      for (auto& vertex : path_vertices[i]) {
+        vertex = new_id[vertex];
+      }
+      const size_t start = path_vertices[i][0];
+      const size_t end = path_vertices[i][1];
+      is_start_vertex[start] = true;
+      if (paths[i].second) {
+        bidi_edges.count(start);
+        bidi_edges.count(end);
+        is_start_vertex[end] = true;
+      } else {
+        out_edges.count(start);
+        in_edges.count(end);
+      }
+    }
+    out_edges.finalize();
+    bidi_edges.finalize();
+    in_edges.finalize();
+    edge_positions.assign(paths.size(), {{0, 0}});
+    for (size_t i = 0; i < paths.size(); i++) {
+      if (paths[i].first.size() < 2) {
+        continue;
+      }
+      const size_t start = path_vertices[i][0];
+      const size_t end = path_vertices[i][1];
       if (paths[i].second) {
-        bidi_vertex_to_unvisited_path_index.emplace(start, std::make_pair(i, Side::front));
-        bidi_vertex_to_unvisited_path_index.emplace(end, std::make_pair(i, Side::back));
-        all_start_vertices.insert(end);
+        edge_positions[i][0] = bidi_edges.add(start, i, Side::front);
+        edge_positions[i][1] = bidi_edges.add(end, i, Side::back);
       } else {
-        start_vertex_to_unvisited_path_index.emplace(start, std::make_pair(i, Side::front));
-        end_vertex_to_unvisited_path_index.emplace(end, std::make_pair(i, Side::back));
+        edge_positions[i][0] = out_edges.add(start, i, Side::front);
+        edge_positions[i][1] = in_edges.add(end, i, Side::back);
       }
     }
   }
@@ -187,18 +324,18 @@ class eulerian_paths {
   // Higher score is better.
   template <typename p_t>
   double path_score(const linestring_t& path_so_far,
-                    const std::pair<point_t, std::pair<size_t, Side>>& option,
+                    const std::pair<size_t, Side>& option,
                     identity<p_t>) {
-    if (path_so_far.size() < 2 || paths[option.second.first].first.size() < 2) {
+    if (path_so_far.size() < 2 || paths[option.first].first.size() < 2) {
       // Doesn't matter, pick any.
       return 0;
     }
     auto p0 = path_so_far[path_so_far.size()-2];
     auto p1 = path_so_far.back();
-    auto p2 = paths[option.second.first].first[1];
-    if (option.second.second == Side::back) {
+    auto p2 = paths[option.first].first[1];
+    if (option.second == Side::back) {
       // This must be reversed.
-      p2 = paths[option.second.first].first[paths[option.second.first].first.size()-2];
+      p2 = paths[option.first].first[paths[option.first].first.size()-2];
     }
 
     // cos(theta) = (a dot b)/(|a|*|b|)
@@ -214,28 +351,28 @@ class eulerian_paths {
   }
 
   double path_score(const linestring_t&,
-                    const std::pair<point_t, std::pair<size_t, Side>>&,
+                    const std::pair<size_t, Side>&,
                     identity<int>) {
     return 0;
   }
 
   template <typename p_t>
   double path_score(const linestring_t& path_so_far,
-                    const std::pair<point_t, std::pair<size_t, Side>>& option) {
+                    const std::pair<size_t, Side>& option) {
     return path_score(path_so_far, option, identity<p_t>());
   }
 
-  // Pick the best path to continue on given the path_so_far and a
-  // range of options.  The range must have at least one element in
-  // it.
-  typename std::multimap<point_t, std::pair<size_t, Side>>::iterator select_path(
-      const linestring_t& path_so_far,
-      const std::pair<typename std::multimap<point_t, std::pair<size_t, Side>>::iterator,
-                      typename std::multimap<point_t, std::pair<size_t, Side>>::iterator>& options) {
-    auto best = options.first;
-    double best_score = path_score<point_t>(path_so_far, *best);
-    for (auto current = options.first; current != options.second; current++) {
-      double current_score = path_score<point_t>(path_so_far, *current);
+  // Pick the best unvisited edge at the vertex to continue on given
+  // the path_so_far.  There must be at least one.  Returns the
+  // position of the edge.
+  size_t select_path(const linestring_t& path_so_far, const Edges& edges, size_t vertex) {
+    size_t best = edges.cursor[vertex];
+    double best_score = path_score<point_t>(path_so_far, edges.entries[best]);
+    for (size_t current = best + 1; current < edges.offsets[vertex + 1]; current++) {
+      if (edges.visited[current]) {
+        continue;
+      }
+      double current_score = path_score<point_t>(path_so_far, edges.entries[current]);
       if (current_score > best_score) {
         best = current;
         best_score = current_score;
@@ -244,28 +381,27 @@ class eulerian_paths {
     return best;
   }
 
-  // Given a point, make a path from that point as long as possible
-  // until a dead end.  Assume that point itself is already in the
+  // Given a vertex, make a path from that vertex as long as possible
+  // until a dead end.  Assume that vertex itself is already in the
   // list.  Return true if the path is all reversible, otherwise
-  // false.
-  bool make_path(point_t point, linestring_t* new_path) {
+  // false.  If new_sources is not null, the index of the input path
+  // is appended to it for each segment added.
+  bool make_path(size_t vertex, linestring_t* new_path, std::vector<size_t>* new_sources) {
     bool all_reversible = true;
     while (true) {
-      // Find an unvisited path that leads from point.  Prefer out edges to bidi
+      // Find an unvisited path that leads from vertex.  Prefer out edges to bidi
       // because we may need to save the bidi edges to later be in edges.
-      auto vertex_and_path_range = start_vertex_to_unvisited_path_index.equal_range(point);
-      auto vertex_to_unvisited_map = &start_vertex_to_unvisited_path_index;
-      if (vertex_and_path_range.first == vertex_and_path_range.second) {
-        vertex_and_path_range = bidi_vertex_to_unvisited_path_index.equal_range(point);
-        vertex_to_unvisited_map = &bidi_vertex_to_unvisited_path_index;
-        if (vertex_and_path_range.first == vertex_and_path_range.second) {
+      Edges* edges = &out_edges;
+      if (edges->unvisited[vertex] == 0) {
+        edges = &bidi_edges;
+        if (edges->unvisited[vertex] == 0) {
           // No more paths to follow.
           return all_reversible; // Empty path is reversible.
         }
       }
-      auto vertex_and_path_index = select_path(*new_path, vertex_and_path_range);
-      size_t path_index = vertex_and_path_index->second.first;
-      Side side = vertex_and_path_index->second.second;
+      const size_t position = select_path(*new_path, *edges, vertex);
+      const size_t path_index = edges->entries[position].first;
+      const Side side = edges->entries[position].second;
       const auto& path = paths[path_index].first;
       if (side == Side::front) {
         // Append this path in the forward direction.
@@ -274,19 +410,15 @@ class eulerian_paths {
         // Append this path in the reverse direction.
         new_path->insert(new_path->end(), path.crbegin()+1, path.crend());
       }
-      vertex_to_unvisited_map->erase(vertex_and_path_index); // Remove from the first vertex.
-      point = new_path->back();
-      // We're bound to find exactly one unless there is a serious error.
-      auto end_map = paths[path_index].second ? &bidi_vertex_to_unvisited_path_index : &end_vertex_to_unvisited_path_index;
-      auto range = end_map->equal_range(point);
-      auto to_compare = std::make_pair(path_index, !side);
-      for (auto iter = range.first; iter != range.second; iter++) {
-        if (iter->second == to_compare) {
-          // Remove the path that ends on the vertex.
-          end_map->erase(iter);
-          break; // There must be only one.
-        }
+      if (new_sources) {
+        new_sources->insert(new_sources->end(), path.size() - 1, path_index);
       }
+      edges->visit(vertex, position); // Remove from the first vertex.
+      // Remove the path from the vertex where it ends.
+      const size_t end_side = side == Side::front ? 1 : 0;
+      vertex = path_vertices[path_index][end_side];
+      Edges* end_edges = paths[path_index].second ? &bidi_edges : &in_edges;
+      end_edges->visit(vertex, edge_positions[path_index][end_side]);
       all_reversible = all_reversible && paths[path_index].second;
     }
   }
@@ -299,42 +431,62 @@ class eulerian_paths {
   // path and, if it finds an unvisited edge, will make a Euler circuit there
   // and stitch it into the current path.  Because all paths have the same
   // number of in and out, the stitch can only possibly end in a loop.  This
-  // continues until the end of the path.
-  void stitch_loops(std::pair<linestring_t, bool> *euler_path) {
+  // continues until the end of the path.  euler_sources, if not null,
+  // has the sources of the segments of euler_path and is updated to
+  // match.
+  void stitch_loops(std::pair<linestring_t, bool> *euler_path, std::vector<size_t>* euler_sources) {
     // Use a counter and not a pointer because the list will grow and pointers
     // may be invalidated.
     linestring_t new_loop;
+    std::vector<size_t> new_loop_sources;
     for (size_t i = 0; i < euler_path->first.size(); i++) {
+      if (out_edges.total_unvisited == 0 && bidi_edges.total_unvisited == 0) {
+        return; // Nothing left to stitch in.
+      }
+      const auto vertex = vertex_ids.find(euler_path->first[i]);
+      if (vertex == vertex_ids.cend()) {
+        continue; // Not the end of any path so there are no edges here.
+      }
       // Make a path from here.  We don't need the first element, it's already in our path.
-      bool new_loop_reversible = make_path(euler_path->first[i], &new_loop);
+      bool new_loop_reversible = make_path(vertex->second, &new_loop,
+                                           euler_sources ? &new_loop_sources : nullptr);
       // Did this vertex have any unvisited edges?
       if (new_loop.size() > 0) {
         // Now we stitch it in.
         euler_path->first.insert(euler_path->first.begin()+i+1, new_loop.begin(), new_loop.end());
         euler_path->second = euler_path->second && new_loop_reversible;
         new_loop.clear(); // Prepare for the next one.
+        if (euler_sources) {
+          // The loop's segments go before the segment that started at
+          // the vertex.  If the loop didn't make it back to the
+          // vertex, the segment after it isn't from any input path.
+          if (i < euler_sources->size() && euler_path->first[i + new_loop_sources.size()] != euler_path->first[i]) {
+            (*euler_sources)[i] = no_source;
+          }
+          euler_sources->insert(euler_sources->begin()+i, new_loop_sources.begin(), new_loop_sources.end());
+          new_loop_sources.clear();
+        }
       }
     }
   }
 
   const std::vector<std::pair<linestring_t, bool>>& paths;
-  // Create a map from vertex to each path that start at that vertex.
-  // It's a map to an index into the input paths.  The bool tells us
-  // if the point_t is at the front or back.  For start, it will
-  // always be true.
-  std::multimap<point_t, std::pair<size_t, Side>> start_vertex_to_unvisited_path_index;
-  // Create a map from vertex to each bidi path that may start or end
-  // at that vertex.  It's a map to an index into the input paths.
-  // The bool tells us if the point_t is at the front or back.  For
-  // bidi, it could be either.
-  std::multimap<point_t, std::pair<size_t, Side>> bidi_vertex_to_unvisited_path_index;
-  // Create a map from vertex to each path that may start or end at
-  // that vertex.  It's a map to an index into the input paths.  The
-  // bool tells us if the point_t is at the front or back.  For end,
-  // it will always be false.
-  std::multimap<point_t, std::pair<size_t, Side>> end_vertex_to_unvisited_path_index;
+  // Every start and end of a path, in order, so that each has a dense
+  // id that is its index.
+  std::vector<point_t> vertices;
+  std::unordered_map<point_t, size_t> vertex_ids;
+  // The ids of the front and back of each input path.
+  std::vector<std::array<size_t, 2>> path_vertices;
+  // Where the front and back of each input path are in the Edges.
+  std::vector<std::array<size_t, 2>> edge_positions;
+  // Edges that start at each vertex and can't be reversed.
+  Edges out_edges;
+  // Edges that may start or end at each vertex.
+  Edges bidi_edges;
+  // Edges that end at each vertex and can't be reversed.
+  Edges in_edges;
   // Only the ones that have at least one potential edge leading out.
-  std::set<point_t> all_start_vertices;
+  std::vector<bool> is_start_vertex;
 }; //class eulerian_paths
 
 // Returns a minimal number of toolpaths that include all the milling in the
@@ -346,6 +498,15 @@ std::vector<std::pair<linestring_t, bool>> get_eulerian_paths(const std::vector<
       paths).get();
 }
 
+// The same and also fills sources with, for each returned path, the
+// index in paths of each of its segments.
+template <typename point_t, typename linestring_t>
+std::vector<std::pair<linestring_t, bool>> get_eulerian_paths(const std::vector<std::pair<linestring_t, bool>>& paths,
+                                                              std::vector<std::vector<size_t>>* sources) {
+  return eulerian_paths<point_t, linestring_t>(
+      paths).get(sources);
+}
+
 multi_linestring_type_fp make_eulerian_paths(const multi_linestring_type_fp& paths, bool reversible, bool unique);
 
 } // namespace eulerian_paths
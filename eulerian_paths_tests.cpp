@@ -3,10 +3,13 @@
 
 #include <tuple>
 #include <utility>
+#include <iostream>
+#include <chrono>
 #include "geometry_int.hpp"
 
 #include "eulerian_paths.hpp"
 #include "bg_operators.hpp"
+#include "segmentize.hpp"
 
 using std::vector;
 using std::pair;
@@ -250,6 +253,47 @@ BOOST_AUTO_TEST_CASE(prefer_straight_lines) {
   BOOST_CHECK_EQUAL(result, expected);
 }
 
+// Each segment of the result knows which path it came from.
+BOOST_AUTO_TEST_CASE(sources) {
+  vector<pair<linestring_type_fp, bool>> mls{
+    {{{5,5}, {6,0}, {4,0}, {5,5}}, true},
+    {{{5,5}, {10,4}}, true},
+    {{{10,4}, {10,6}, {5,5}}, true},
+    {{{4,10}, {5,5}}, true},
+    {{{6,10}, {4,10}}, true},
+    {{{5,5}, {6,10}}, true},
+    {{{20,20}, {30,20}}, false},
+    {{{30,20}, {30,30}, {20,20}}, false},
+  };
+  vector<vector<size_t>> sources;
+  vector<pair<linestring_type_fp, bool>> result =
+      get_eulerian_paths<point_type_fp, linestring_type_fp>(mls, &sources);
+  BOOST_CHECK_EQUAL(result, (get_eulerian_paths<point_type_fp, linestring_type_fp>(mls)));
+  BOOST_REQUIRE_EQUAL(sources.size(), result.size());
+  vector<size_t> segments(mls.size(), 0);
+  for (size_t i = 0; i < result.size(); i++) {
+    BOOST_REQUIRE_EQUAL(sources[i].size() + 1, result[i].first.size());
+    for (size_t j = 0; j < sources[i].size(); j++) {
+      BOOST_REQUIRE_LT(sources[i][j], mls.size());
+      const auto& source = mls[sources[i][j]].first;
+      const auto& start = result[i].first[j];
+      const auto& end = result[i].first[j+1];
+      bool found = false;
+      for (size_t k = 0; k + 1 < source.size(); k++) {
+        if ((source[k] == start && source[k+1] == end) ||
+            (source[k] == end && source[k+1] == start)) {
+          found = true;
+        }
+      }
+      BOOST_CHECK(found);
+      segments[sources[i][j]]++;
+    }
+  }
+  for (size_t i = 0; i < mls.size(); i++) {
+    BOOST_CHECK_EQUAL(segments[i], mls[i].first.size() - 1);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(must_start_tests) {
   vector<std::tuple<size_t, size_t, size_t, bool>> tests{
     // Sum = 0
@@ -304,4 +348,27 @@ BOOST_AUTO_TEST_CASE(must_start_tests) {
   }
 }
 
+// A grid of lines that segmentize splits into about a million segments.
+BOOST_AUTO_TEST_CASE(benchmark, *boost::unit_test::disabled()) {
+  const int lines = 710;
+  vector<pair<linestring_type_fp, bool>> grid;
+  for (int i = 0; i < lines; i++) {
+    grid.push_back({{{double(i), -1}, {double(i), double(lines)}}, true});
+    grid.push_back({{{-1, double(i)}, {double(lines), double(i)}}, i % 2 == 0});
+  }
+  auto start_time = std::chrono::steady_clock::now();
+  const auto segments = segmentize::segmentize_paths(grid);
+  const std::chrono::duration<double> segmentize_time = std::chrono::steady_clock::now() - start_time;
+  start_time = std::chrono::steady_clock::now();
+  const auto result = get_eulerian_paths<point_type_fp, linestring_type_fp>(segments);
+  const std::chrono::duration<double> eulerian_time = std::chrono::steady_clock::now() - start_time;
+  size_t points = 0;
+  for (const auto& path : result) {
+    points += path.first.size();
+  }
+  std::cout << segments.size() << " segments segmentized in " << segmentize_time.count()
+            << " seconds, " << result.size() << " eulerian paths with " << points
+            << " points in " << eulerian_time.count() << " seconds" << std::endl;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
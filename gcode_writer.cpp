@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "gcode_writer.hpp"
+
+using std::string;
+using std::vector;
+using std::pair;
+
+namespace {
+
+// Comments that the controller acts on, like (MSG, ...) in LinuxCNC.
+bool is_active_comment(const string& comment) {
+  size_t start = comment.find_first_not_of(" \t");
+  if (start == string::npos) {
+    return false;
+  }
+  for (const char* active : {"MSG", "PROBE", "DEBUG", "PRINT", "LOG"}) {
+    const size_t length = std::strlen(active);
+    if (comment.size() - start >= length &&
+        std::equal(active, active + length, comment.begin() + start,
+                   [](char a, char b) { return a == std::toupper(static_cast<unsigned char>(b)); })) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The shortest way to write a number, without a plus sign, leading
+// zeros or trailing zeros.
+string trim_number(const string& number) {
+  size_t start = 0;
+  bool negative = false;
+  if (number[0] == '-' || number[0] == '+') {
+    negative = number[0] == '-';
+    start = 1;
+  }
+  const size_t point = number.find('.');
+  string integer = number.substr(start, point == string::npos ? string::npos : point - start);
+  string fraction = point == string::npos ? string() : number.substr(point + 1);
+  integer.erase(0, std::min(integer.find_first_not_of('0'), integer.size()));
+  fraction.erase(fraction.find_last_not_of('0') + 1);
+  if (integer.empty()) {
+    integer = "0";
+  }
+  string result = fraction.empty() ? integer : integer + "." + fraction;
+  if (negative && result != "0") {
+    result = "-" + result;
+  }
+  return result;
+}
+
+} // namespace
+
+GcodeWriter::GcodeWriter(std::ostream& out, bool compact, unsigned int precision) :
+    out(out), compact(compact), precision(precision) {
+  buffer.reserve(flush_size + 256);
+}
+
+GcodeWriter::~GcodeWriter() {
+  flush();
+}
+
+void GcodeWriter::flush() {
+  if (!line.empty()) {
+    // Not a whole line so it can't be made shorter.
+    buffer.append(line);
+    line.clear();
+    forget();
+    cut = true;
+  }
+  out.write(buffer.data(), buffer.size());
+  buffer.clear();
+}
+
+void GcodeWriter::forget() {
+  motion.clear();
+  for (auto& value : last) {
+    value.clear();
+  }
+}
+
+void GcodeWriter::compact_lines() {
+  size_t start = 0;
+  size_t newline;
+  while ((newline = line.find('\n', start)) != string::npos) {
+    compact_line(line.substr(start, newline - start));
+    start = newline + 1;
+  }
+  line.erase(0, start);
+}
+
+void GcodeWriter::compact_line(const string& input) {
+  if (cut) {
+    // The start of this line was already written by flush.
+    buffer.append(input);
+    buffer.push_back('\n');
+    cut = false;
+    return;
+  }
+  // Split the line into words, leaving out the comments.
+  vector<pair<char, string>> words;
+  bool understood = true;
+  for (size_t i = 0; i < input.size() && understood;) {
+    const char c = input[i];
+    if (c == ' ' || c == '\t' || c == '\r') {
+      i++;
+    } else if (c == '(') {
+      const size_t end = input.find(')', i);
+      if (end == string::npos || is_active_comment(input.substr(i + 1, end - i - 1))) {
+        understood = false;
+      } else {
+        i = end + 1;
+      }
+    } else {
+      const char letter = std::toupper(static_cast<unsigned char>(c));
+      size_t end = i + 1;
+      if (end < input.size() && (input[end] == '-' || input[end] == '+')) {
+        end++;
+      }
+      size_t digits = 0;
+      size_t points = 0;
+      for (; end < input.size(); end++) {
+        if (std::isdigit(static_cast<unsigned char>(input[end]))) {
+          digits++;
+        } else if (input[end] == '.') {
+          points++;
+        } else {
+          break;
+        }
+      }
+      if (letter == '\0' || std::strchr("FGIJKMNPRSTXYZ", letter) == nullptr ||
+          digits == 0 || points > 1) {
+        understood = false;
+      } else if (letter != 'N') { // Line numbers are left out.
+        words.emplace_back(letter, trim_number(input.substr(i + 1, end - i - 1)));
+      }
+      i = end;
+    }
+  }
+  if (!understood) {
+    buffer.append(input);
+    buffer.push_back('\n');
+    forget();
+    return;
+  }
+  if (words.empty()) {
+    return; // Blank or just comments.
+  }
+  // Is it a line with just G0 or G1 and the axes and feed?
+  bool is_motion = true;
+  size_t g_words = 0;
+  for (const auto& word : words) {
+    if (word.first == 'G') {
+      g_words++;
+      is_motion = is_motion && (word.second == "0" || word.second == "1");
+    } else {
+      is_motion = is_motion && std::strchr("XYZF", word.first) != nullptr;
+    }
+  }
+  if (!is_motion || g_words > 1) {
+    for (const auto& word : words) {
+      buffer.push_back(word.first);
+      buffer.append(word.second);
+    }
+    buffer.push_back('\n');
+    // Dwelling doesn't change anything, everything else might.
+    if (!(words.size() == 2 && words[0].first == 'G' && words[0].second == "4" && words[1].first == 'P')) {
+      forget();
+    }
+    return;
+  }
+  string output;
+  for (const auto& word : words) {
+    if (word.first == 'G') {
+      if (word.second != motion) {
+        motion = word.second;
+        output.push_back('G');
+        output.append(word.second);
+      }
+    }
+  }
+  for (const auto& word : words) {
+    if (word.first != 'G') {
+      string& previous = last[std::strchr("XYZF", word.first) - "XYZF"];
+      // Without the G0 or G1 the axes are needed to make it move.
+      if (word.second != previous || motion.empty()) {
+        previous = word.second;
+        output.push_back(word.first);
+        output.append(word.second);
+      }
+    }
+  }
+  if (!output.empty()) {
+    buffer.append(output);
+    buffer.push_back('\n');
+  }
+}
+
+void GcodeWriter::append_fixed(string& out, double value, unsigned int precision) {
+  static const uint64_t powers[] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+                                    1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL};
+  if (precision < sizeof(powers) / sizeof(powers[0]) && std::isfinite(value)) {
+    const uint64_t power = powers[precision];
+    const double scaled = std::abs(value) * power;
+    if (scaled < 1e15) {
+      const double whole = std::floor(scaled);
+      const double fraction = scaled - whole;
+      // scaled might be off by half a bit from the exact product so it
+      // can only be rounded here if it isn't too close to a half.
+      // Otherwise printf does it, which rounds the exact value.
+      if (std::abs(fraction - 0.5) > scaled * std::numeric_limits<double>::epsilon()) {
+        const uint64_t digits = static_cast<uint64_t>(whole) + (fraction > 0.5 ? 1 : 0);
+        char text[32];
+        char* end = text + sizeof(text);
+        char* start = end;
+        uint64_t fractional_digits = digits % power;
+        for (unsigned int i = 0; i < precision; i++) {
+          *--start = '0' + fractional_digits % 10;
+          fractional_digits /= 10;
+        }
+        if (precision > 0) {
+          *--start = '.';
+        }
+        uint64_t integer_digits = digits / power;
+        do {
+          *--start = '0' + integer_digits % 10;
+          integer_digits /= 10;
+        } while (integer_digits > 0);
+        if (std::signbit(value)) {
+          *--start = '-';
+        }
+        out.append(start, end);
+        return;
+      }
+    }
+  }
+  char text[512];
+  const int length = std::snprintf(text, sizeof(text), "%.*f", precision, value);
+  if (length >= 0 && static_cast<size_t>(length) < sizeof(text)) {
+    out.append(text, length);
+  } else {
+    // Too long for text, which only happens for huge numbers.
+    string long_text(length + 1, '\0');
+    std::snprintf(&long_text[0], long_text.size(), "%.*f", precision, value);
+    out.append(long_text.c_str(), length);
+  }
+}
@@ -0,0 +1,85 @@
+#ifndef GCODE_WRITER_HPP
+#define GCODE_WRITER_HPP
+
+#include <array>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+// Collects G-code text in a large buffer and writes it to an ostream in
+// big blocks.  Numbers are written the same as an ostream with
+// std::fixed and the precision would write them, so the output doesn't
+// change, but it's much faster than going through the ostream for each
+// number.  The text is written when the buffer is full, on flush and
+// when the GcodeWriter is destroyed so nothing else should write to the
+// ostream in the meantime.
+//
+// If compact is true, each line is made as short as possible: comments,
+// spaces, blank lines and extra zeros are removed and the G0/G1, X, Y,
+// Z and F words that are the same as before are left out, as are lines
+// that have nothing left.  Lines that aren't understood, like ones with
+// expressions or active comments like (MSG, ...), are written as they
+// are and forget what came before.
+class GcodeWriter {
+ public:
+  GcodeWriter(std::ostream& out, bool compact = false, unsigned int precision = 5);
+  ~GcodeWriter();
+  GcodeWriter& operator<<(const char* s) {
+    text().append(s);
+    return maybe_flush();
+  }
+  GcodeWriter& operator<<(const std::string& s) {
+    text().append(s);
+    return maybe_flush();
+  }
+  GcodeWriter& operator<<(char c) {
+    text().push_back(c);
+    return maybe_flush();
+  }
+  GcodeWriter& operator<<(double value) {
+    append_fixed(text(), value, precision);
+    return maybe_flush();
+  }
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value, GcodeWriter&>::type operator<<(T value) {
+    text().append(std::to_string(value));
+    return maybe_flush();
+  }
+  void flush();
+
+  // Appends value to out like printf("%.*f", precision, value) would.
+  static void append_fixed(std::string& out, double value, unsigned int precision);
+
+ private:
+  std::string& text() {
+    return compact ? line : buffer;
+  }
+  GcodeWriter& maybe_flush() {
+    if (compact) {
+      compact_lines();
+    }
+    if (buffer.size() >= flush_size) {
+      flush();
+    }
+    return *this;
+  }
+  void compact_lines();
+  void compact_line(const std::string& input);
+  void forget();
+
+  static const size_t flush_size = 1 << 16;
+  std::ostream& out;
+  const bool compact;
+  const unsigned int precision;
+  std::string buffer;
+  // For compact, the text after the last newline.
+  std::string line;
+  // For compact, true if flush wrote the start of the line.
+  bool cut = false;
+  // For compact, the last G0 or G1 and the last X, Y, Z and F, empty if
+  // not known.
+  std::string motion;
+  std::array<std::string, 4> last;
+};
+
+#endif //GCODE_WRITER_HPP
@@ -0,0 +1,198 @@
+#define BOOST_TEST_MODULE gcode writer tests
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gcode_writer.hpp"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(gcode_writer_tests)
+
+string ostream_fixed(double value, unsigned int precision) {
+  ostringstream out;
+  out.setf(ios_base::fixed);
+  out.precision(precision);
+  out << value;
+  return out.str();
+}
+
+string writer_fixed(double value, unsigned int precision) {
+  string out;
+  GcodeWriter::append_fixed(out, value, precision);
+  return out;
+}
+
+BOOST_AUTO_TEST_CASE(special_values) {
+  for (const double value : {0.0, -0.0, 1.0, -1.0, 0.5, 1e-20, -1e-20, 123456.789,
+                             0.000005, 0.000015, -0.000025, 1.234565, 2.5, 1e14, 1e15, 1e16, 1e300,
+                             -1e300, numeric_limits<double>::max(), numeric_limits<double>::min(),
+                             numeric_limits<double>::denorm_min(),
+                             numeric_limits<double>::infinity(), -numeric_limits<double>::infinity(),
+                             numeric_limits<double>::quiet_NaN()}) {
+    for (unsigned int precision = 0; precision < 12; precision++) {
+      BOOST_CHECK_EQUAL(writer_fixed(value, precision), ostream_fixed(value, precision));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ties) {
+  // Numbers that are close to halfway between two outputs, where the
+  // rounding must be done on the exact value.
+  for (int64_t i = -100000; i < 100000; i++) {
+    for (const double value : {(i + 0.5) / 100000, (i + 0.5) / 100000 * 25.4, i * 0.00001 + 0.000005}) {
+      BOOST_REQUIRE_EQUAL(writer_fixed(value, 5), ostream_fixed(value, 5));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(random_values) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> small(-10, 10);
+  std::uniform_real_distribution<double> exponent(-30, 30);
+  for (size_t i = 0; i < 200000; i++) {
+    const double value = small(gen);
+    BOOST_REQUIRE_EQUAL(writer_fixed(value, 5), ostream_fixed(value, 5));
+    const double scaled = value * pow(10, exponent(gen));
+    BOOST_REQUIRE_EQUAL(writer_fixed(scaled, 5), ostream_fixed(scaled, 5));
+    BOOST_REQUIRE_EQUAL(writer_fixed(scaled, 3), ostream_fixed(scaled, 3));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(same_as_ostream) {
+  ostringstream expected;
+  expected.setf(ios_base::fixed);
+  expected.precision(5);
+  ostringstream actual;
+  {
+    GcodeWriter writer(actual);
+    for (int i = 0; i < 100000; i++) {
+      const double x = i * 0.001;
+      const double y = -i * 0.0127;
+      expected << "G01 X" << x << " Y" << y << '\n' << "( " << i << " " << size_t(i) << " )\n" << string("text");
+      writer << "G01 X" << x << " Y" << y << '\n' << "( " << i << " " << size_t(i) << " )\n" << string("text");
+    }
+    writer.flush();
+    BOOST_CHECK(actual.str() == expected.str());
+    writer << "more";
+  }
+  // Written when the writer is destroyed.
+  expected << "more";
+  BOOST_CHECK(actual.str() == expected.str());
+}
+
+string compact(const string& input) {
+  ostringstream out;
+  {
+    GcodeWriter writer(out, true);
+    writer << input;
+  }
+  return out.str();
+}
+
+BOOST_AUTO_TEST_CASE(compact_moves) {
+  BOOST_CHECK_EQUAL(compact(
+      "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n"
+      "G00 Z0.10000 ( retract )\n"
+      "\n"
+      "G00 X1.00000 Y-2.50000 ( rapid move to begin. )\n"
+      "G01 F10.00000\n"
+      "G01 Z-0.05000\n"
+      "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n"
+      "G01 F20.00000\n"
+      "G01 X1.00000 Y-2.50000\n"
+      "G01 X1.50000 Y-2.50000\n"
+      "G01 X1.50000 Y-2.50000\n"
+      "G01 X1.50000 Y0.00000\n"
+      "G01 X-0.00000 Y0.00000\n"),
+    "G4P0\n"
+    "G0Z0.1\n"
+    "X1Y-2.5\n"
+    "G1F10\n"
+    "Z-0.05\n"
+    "G4P0\n"
+    "F20\n"
+    "X1.5\n"
+    "Y0\n"
+    "X0\n");
+}
+
+BOOST_AUTO_TEST_CASE(compact_not_understood) {
+  // Expressions and active comments are kept and whatever was known
+  // before is forgotten.
+  BOOST_CHECK_EQUAL(compact(
+      "G01 X1.00000 Y2.00000\n"
+      "G01 X1.00000 Y2.00000 Z[#100+0.1]\n"
+      "G01 X1.00000 Y2.00000\n"
+      "(MSG, Change tool bit to mill diameter 0.01000in)\n"
+      "X1.00000 Y2.00000\n"
+      "G01 X1.00000 Y3.00000\n"
+      "M0      (Temporary machine stop.)\n"
+      "G01 X1.00000 Y3.00000\n"
+      "N10 G81 R0.1 Z-0.1 F10\n"
+      "X1.00000 Y3.00000\n"
+      "X1.00000 Y3.00000\n"),
+    "G1X1Y2\n"
+    "G01 X1.00000 Y2.00000 Z[#100+0.1]\n"
+    "G1X1Y2\n"
+    "(MSG, Change tool bit to mill diameter 0.01000in)\n"
+    "X1Y2\n"
+    "G1Y3\n"
+    "M0\n"
+    "G1X1Y3\n"
+    "G81R0.1Z-0.1F10\n"
+    "X1Y3\n"
+    "X1Y3\n");
+}
+
+BOOST_AUTO_TEST_CASE(compact_partial_line) {
+  ostringstream out;
+  {
+    GcodeWriter writer(out, true);
+    writer << "G01 X" << 1.0 << " Y" << 2.0 << '\n' << "G01 X" << 1.0;
+    writer.flush();
+    BOOST_CHECK_EQUAL(out.str(), "G1X1Y2\nG01 X1.00000");
+    writer << " Y" << 3.0 << "\nG01 X" << 1.0 << " Y" << 3.0 << "\n";
+  }
+  // The line that was cut by the flush is written as it is and then
+  // nothing is known about the position.
+  BOOST_CHECK_EQUAL(out.str(), "G1X1Y2\nG01 X1.00000 Y3.00000\nG1X1Y3\n");
+}
+
+BOOST_AUTO_TEST_CASE(benchmark, *boost::unit_test::disabled()) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> position(-100, 100);
+  vector<double> values(2000000);
+  for (auto& value : values) {
+    value = position(gen);
+  }
+  ostringstream expected;
+  expected.setf(ios_base::fixed);
+  expected.precision(5);
+  auto start = chrono::steady_clock::now();
+  for (size_t i = 0; i < values.size(); i += 2) {
+    expected << "G01 X" << values[i] << " Y" << values[i+1] << '\n';
+  }
+  const auto ostream_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  ostringstream actual;
+  start = chrono::steady_clock::now();
+  {
+    GcodeWriter writer(actual);
+    for (size_t i = 0; i < values.size(); i += 2) {
+      writer << "G01 X" << values[i] << " Y" << values[i+1] << '\n';
+    }
+  }
+  const auto writer_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  BOOST_CHECK(actual.str() == expected.str());
+  cout << values.size() / 2 << " lines: ostream " << ostream_time << " seconds, GcodeWriter "
+       << writer_time << " seconds" << endl;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -306,30 +306,30 @@ inline static void unsupported_polarity_throw_exception() {
 // or.
 struct mp_pair {
   mp_pair() {}
-  mp_pair(multi_polygon_type_fp shapes) : shapes(shapes) {}
+  mp_pair(multi_polygon_type_fp shapes) : shapes(std::move(shapes)) {}
   mp_pair(multi_polygon_type_fp shapes,
           multi_polygon_type_fp filled_closed_lines) :
-    shapes(shapes),
-    filled_closed_lines(filled_closed_lines) {}
+    shapes(std::move(shapes)),
+    filled_closed_lines(std::move(filled_closed_lines)) {}
   multi_polygon_type_fp shapes;
   multi_polygon_type_fp filled_closed_lines;
 };
 
 // To speed up the merging, we do them in pairs so that we're mostly merging
 // equal-sized shapes.
-mp_pair merge_multi_draws(const vector<mp_pair>& multi_draws) {
+mp_pair merge_multi_draws(vector<mp_pair> multi_draws) {
   if (multi_draws.size() == 0) {
     return multi_polygon_type_fp();
   } else if (multi_draws.size() == 1) {
-    return multi_draws.front();
+    return std::move(multi_draws.front());
   }
   vector<multi_polygon_type_fp> shapes;
   vector<multi_polygon_type_fp> filled_closed_lines;
   shapes.reserve(multi_draws.size());
   filled_closed_lines.reserve(multi_draws.size());
-  for (const auto& multi_draw : multi_draws) {
-    shapes.push_back(multi_draw.shapes);
-    filled_closed_lines.push_back(multi_draw.filled_closed_lines);
+  for (auto& multi_draw : multi_draws) {
+    shapes.push_back(std::move(multi_draw.shapes));
+    filled_closed_lines.push_back(std::move(multi_draw.filled_closed_lines));
   }
   return mp_pair(sum(shapes), symdiff(filled_closed_lines));
 }
@@ -352,10 +352,10 @@ multi_polygon_type_fp generate_layers(vector<pair<const gerbv_layer_t *, mp_pair
   for (auto layer = layers.cbegin(); layer != layers.cend(); layer++) {
     const gerbv_polarity_t polarity = layer->first->polarity;
     const gerbv_step_and_repeat_t& stepAndRepeat = layer->first->stepAndRepeat;
-    mp_pair draw_pair = layer->second;
-    multi_polygon_type_fp draws = draw_pair.*member;
+    const multi_polygon_type_fp* draws = &(layer->second.*member);
+    multi_polygon_type_fp repeated_draws;
     if (stepAndRepeat.X > 0 || stepAndRepeat.Y > 0) {
-      vector<multi_polygon_type_fp> to_sum{draws};
+      vector<multi_polygon_type_fp> to_sum{*draws};
 
       to_sum.reserve(stepAndRepeat.X * stepAndRepeat.Y);
       for (int sr_x = 0; sr_x < stepAndRepeat.X; sr_x++) {
@@ -364,21 +364,22 @@ multi_polygon_type_fp generate_layers(vector<pair<const gerbv_layer_t *, mp_pair
             continue; // Already got this one.
           }
           multi_polygon_type_fp translated_draws;
-          bg::transform(draws, translated_draws,
+          bg::transform(*draws, translated_draws,
                         translate(stepAndRepeat.dist_X * sr_x,
                                   stepAndRepeat.dist_Y * sr_y));
-          to_sum.push_back(translated_draws);
+          to_sum.push_back(std::move(translated_draws));
         }
       }
-      draws = sum(to_sum);
+      repeated_draws = sum(to_sum);
+      draws = &repeated_draws;
     }
 
     if (xor_layers) {
-      output = output ^ draws;
+      output = output ^ *draws;
     } else if (polarity == GERBV_POLARITY_DARK) {
-      output = output + draws;
+      output = output + *draws;
     } else if (polarity == GERBV_POLARITY_CLEAR) {
-      output = output - draws;
+      output = output - *draws;
     } else {
       unsupported_polarity_throw_exception();
     }
@@ -694,7 +695,9 @@ mp_pair paths_to_shapes(const coordinate_type_fp& diameter, const multi_linestri
   multi_linestring_type_fp euler_paths;
   for (const auto& ls : euler_paths_with_rings) {
     auto all_ls = get_all_ls(ls);
-    euler_paths.insert(euler_paths.cend(), all_ls.cbegin(), all_ls.cend());
+    euler_paths.insert(euler_paths.cend(),
+                       std::make_move_iterator(all_ls.begin()),
+                       std::make_move_iterator(all_ls.end()));
   }
   mp_pair ovals;
   if (fill_closed_lines) {
@@ -705,7 +708,7 @@ mp_pair paths_to_shapes(const coordinate_type_fp& diameter, const multi_linestri
         loop_poly.outer().swap(euler_path);
         bg::correct(loop_poly);
         multi_polygon_type_fp loop_mpoly;
-        loop_mpoly.push_back(loop_poly);
+        loop_mpoly.push_back(std::move(loop_poly));
         ovals.filled_closed_lines = ovals.filled_closed_lines ^ loop_mpoly;
       }
     }
@@ -897,8 +900,8 @@ pair<multi_polygon_type_fp, map<coordinate_type_fp, multi_linestring_type_fp>> G
   }
   vector<pair<const gerbv_layer_t *, mp_pair>> merged_layers;
   merged_layers.reserve(layers.size());
-  for (const auto& layer : layers) {
-    merged_layers.emplace_back(layer.first, merge_multi_draws(layer.second));
+  for (auto& layer : layers) {
+    merged_layers.emplace_back(layer.first, merge_multi_draws(std::move(layer.second)));
   }
   auto result = generate_layers(merged_layers, &mp_pair::filled_closed_lines, fill_closed_lines);
   if (fill_closed_lines) {
@@ -919,5 +922,5 @@ pair<multi_polygon_type_fp, map<coordinate_type_fp, multi_linestring_type_fp>> G
   for (auto& path : linear_circular_paths) {
     path.second = eulerian_paths::make_eulerian_paths(path.second, true, true);
   }
-  return make_pair(result, linear_circular_paths);
+  return make_pair(std::move(result), std::move(linear_circular_paths));
 }
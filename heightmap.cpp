@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "heightmap.hpp"
+
+using std::vector;
+using std::pair;
+using std::make_pair;
+using std::string;
+using std::min;
+using std::max;
+
+namespace {
+
+// Groups the sorted values that are close together and returns the
+// average of each group.
+vector<double> grid_lines(vector<double> values) {
+  std::sort(values.begin(), values.end());
+  const double gap = (values.back() - values.front()) * 1e-3;
+  vector<double> lines;
+  size_t start = 0;
+  for (size_t i = 1; i <= values.size(); i++) {
+    if (i == values.size() || values[i] - values[start] > gap) {
+      double sum = 0;
+      for (size_t j = start; j < i; j++) {
+        sum += values[j];
+      }
+      lines.push_back(sum / (i - start));
+      start = i;
+    }
+  }
+  return lines;
+}
+
+size_t nearest(const vector<double>& lines, double value) {
+  const size_t upper = std::lower_bound(lines.cbegin(), lines.cend(), value) - lines.cbegin();
+  if (upper == 0) {
+    return 0;
+  }
+  if (upper == lines.size() || value - lines[upper - 1] < lines[upper] - value) {
+    return upper - 1;
+  }
+  return upper;
+}
+
+// The index of the grid cell that value is in and how far across it,
+// from 0 to 1.
+pair<size_t, double> locate(const vector<double>& lines, double value) {
+  value = max(lines.front(), min(value, lines.back()));
+  size_t index = std::upper_bound(lines.cbegin(), lines.cend(), value) - lines.cbegin();
+  index = min(max(index, size_t(1)), lines.size() - 1) - 1;
+  return make_pair(index, (value - lines[index]) / (lines[index + 1] - lines[index]));
+}
+
+} // namespace
+
+HeightMap::HeightMap(vector<double> xs, vector<double> ys, vector<double> heights) :
+    xs(std::move(xs)), ys(std::move(ys)), heights(std::move(heights)) {
+  if (this->xs.size() < 2 || this->ys.size() < 2 ||
+      this->heights.size() != this->xs.size() * this->ys.size()) {
+    throw std::invalid_argument("The height map must have at least 2 by 2 probes.");
+  }
+}
+
+HeightMap HeightMap::read(std::istream& in) {
+  vector<double> probe_xs;
+  vector<double> probe_ys;
+  vector<double> probe_zs;
+  string line;
+  while (std::getline(in, line)) {
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream words(line);
+    double x, y, z;
+    if (!(words >> x)) {
+      continue;
+    }
+    if (!(words >> y >> z)) {
+      throw std::invalid_argument("Can't read x, y and z from the probe: " + line);
+    }
+    probe_xs.push_back(x);
+    probe_ys.push_back(y);
+    probe_zs.push_back(z);
+  }
+  if (probe_xs.empty()) {
+    throw std::invalid_argument("There are no probes in the height map.");
+  }
+  vector<double> xs = grid_lines(probe_xs);
+  vector<double> ys = grid_lines(probe_ys);
+  // If a point was probed more than once, use the average.
+  vector<double> sums(xs.size() * ys.size(), 0);
+  vector<size_t> counts(xs.size() * ys.size(), 0);
+  for (size_t i = 0; i < probe_xs.size(); i++) {
+    const size_t index = nearest(xs, probe_xs[i]) * ys.size() + nearest(ys, probe_ys[i]);
+    sums[index] += probe_zs[i];
+    counts[index]++;
+  }
+  for (size_t i = 0; i < xs.size(); i++) {
+    for (size_t j = 0; j < ys.size(); j++) {
+      const size_t index = i * ys.size() + j;
+      if (counts[index] == 0) {
+        std::ostringstream error;
+        error << "The probes aren't on a grid, there is no probe at X" << xs[i] << " Y" << ys[j] << ".";
+        throw std::invalid_argument(error.str());
+      }
+      sums[index] /= counts[index];
+    }
+  }
+  return HeightMap(std::move(xs), std::move(ys), std::move(sums));
+}
+
+double HeightMap::height(const point_type_fp& p) const {
+  const auto x = locate(xs, p.x());
+  const auto y = locate(ys, p.y());
+  const double* const left = &heights[x.first * ys.size() + y.first];
+  const double* const right = left + ys.size();
+  const double bottom = left[0] + (right[0] - left[0]) * x.second;
+  const double top = left[1] + (right[1] - left[1]) * x.second;
+  return bottom + (top - bottom) * y.second;
+}
+
+vector<pair<point_type_fp, double>> HeightMap::follow(const point_type_fp& source,
+                                                      const point_type_fp& dest,
+                                                      double z, double tolerance) const {
+  if (source.x() == dest.x() && source.y() == dest.y()) {
+    return {make_pair(dest, z + height(dest))};
+  }
+  const double dx = dest.x() - source.x();
+  const double dy = dest.y() - source.y();
+  const auto at = [&](double t) {
+    return point_type_fp(source.x() + dx * t, source.y() + dy * t);
+  };
+  // Between the grid lines, the height along the line is a quadratic
+  // in t so the points to make it straight can be worked out exactly.
+  vector<double> breaks{0, 1};
+  for (const double x : xs) {
+    if (dx != 0 && (x - source.x()) / dx > 0 && (x - source.x()) / dx < 1) {
+      breaks.push_back((x - source.x()) / dx);
+    }
+  }
+  for (const double y : ys) {
+    if (dy != 0 && (y - source.y()) / dy > 0 && (y - source.y()) / dy < 1) {
+      breaks.push_back((y - source.y()) / dy);
+    }
+  }
+  std::sort(breaks.begin(), breaks.end());
+  breaks.erase(std::unique(breaks.begin(), breaks.end()), breaks.end());
+  // Half of the tolerance is for the curve between the points here and
+  // the other half for removing some of the points after.
+  vector<pair<double, double>> points{make_pair(0.0, height(source))};
+  for (size_t i = 1; i < breaks.size(); i++) {
+    const double start = breaks[i - 1];
+    const double end = breaks[i];
+    const double curve = std::abs(points.back().second + height(at(end)) -
+                                  2 * height(at((start + end) / 2))) * 2;
+    // The line between the ends of a quadratic is furthest from it by
+    // curve/4, in the middle, and splitting it into n parts divides
+    // that by n*n.
+    const size_t parts = max(std::ceil(std::sqrt(curve / (2 * tolerance))), 1.0);
+    for (size_t part = 1; part <= parts; part++) {
+      const double t = part == parts ? end : start + (end - start) * part / parts;
+      points.push_back(make_pair(t, height(at(t))));
+    }
+  }
+  // Skip the points that are close enough to the line between the ones
+  // around them.
+  vector<pair<point_type_fp, double>> output{make_pair(source, z + points.front().second)};
+  size_t last = 0;
+  for (size_t next = 2; next <= points.size(); next++) {
+    bool straight = next < points.size();
+    for (size_t i = last + 1; straight && i < next; i++) {
+      const double fraction = (points[i].first - points[last].first) /
+                              (points[next].first - points[last].first);
+      const double line = points[last].second + (points[next].second - points[last].second) * fraction;
+      straight = std::abs(points[i].second - line) <= tolerance / 2;
+    }
+    if (!straight) {
+      last = next - 1;
+      output.push_back(make_pair(last == points.size() - 1 ? dest : at(points[last].first),
+                                 z + points[last].second));
+    }
+  }
+  return output;
+}
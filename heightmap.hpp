@@ -0,0 +1,49 @@
+#ifndef HEIGHTMAP_HPP
+#define HEIGHTMAP_HPP
+
+#include <istream>
+#include <utility>
+#include <vector>
+
+#include "geometry.hpp"
+
+// The heights of the board, probed on a grid.  Between the probes the
+// height is interpolated bilinearly and outside of the grid the nearest
+// edge of the grid is used, like the autoleveller does on the
+// controller.
+class HeightMap {
+ public:
+  // xs and ys are the grid lines in increasing order and heights has
+  // the height at xs[i], ys[j] at heights[i * ys.size() + j].
+  HeightMap(std::vector<double> xs, std::vector<double> ys, std::vector<double> heights);
+
+  // Reads the probes, one on each line, with x, y and z as the first
+  // three numbers.  The numbers can be separated by spaces, tabs or
+  // commas so the logs of LinuxCNC's PROBEOPEN and Mach's M40 both
+  // work.  Lines that don't start with a number are skipped.  The
+  // probes must be on a grid, though the grid lines need not be evenly
+  // spaced.  Throws std::invalid_argument if they aren't.
+  static HeightMap read(std::istream& in);
+
+  double height(const point_type_fp& p) const;
+
+  // The points, each with its z, to go through to move in a straight
+  // line from source to dest at depth z above the height map.  The
+  // output starts with source and ends with dest.  Between any two
+  // output points, the height map is within tolerance of the straight
+  // line.  So where the board is flat, there are few points and where
+  // it curves there are more.
+  std::vector<std::pair<point_type_fp, double>> follow(const point_type_fp& source,
+                                                       const point_type_fp& dest,
+                                                       double z, double tolerance) const;
+
+  const std::vector<double>& get_xs() const { return xs; }
+  const std::vector<double>& get_ys() const { return ys; }
+
+ private:
+  std::vector<double> xs;
+  std::vector<double> ys;
+  std::vector<double> heights;
+};
+
+#endif //HEIGHTMAP_HPP
@@ -0,0 +1,109 @@
+#define BOOST_TEST_MODULE heightmap tests
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+#include "geometry.hpp"
+
+#include "heightmap.hpp"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(heightmap_tests)
+
+// Tilted along x, 0 at x=0 and 1 at x=10.
+HeightMap tilted() {
+  return HeightMap({0, 10}, {0, 10}, {0, 0, 1, 1});
+}
+
+BOOST_AUTO_TEST_CASE(read_linuxcnc) {
+  // PROBEOPEN writes x y z a b c u v w, in any order of probing.
+  istringstream in("0.000000 0.000000 -0.010000 0.000000 0.000000 0.000000 0.000000 0.000000 0.000000\n"
+                   "0.000000 5.000000 0.020000 0.000000 0.000000 0.000000 0.000000 0.000000 0.000000\n"
+                   "10.000001 4.999999 0.040000 0.000000 0.000000 0.000000 0.000000 0.000000 0.000000\n"
+                   "9.999999 0.000000 0.010000 0.000000 0.000000 0.000000 0.000000 0.000000 0.000000\n");
+  const auto map = HeightMap::read(in);
+  BOOST_CHECK_EQUAL(map.get_xs().size(), 2UL);
+  BOOST_CHECK_EQUAL(map.get_ys().size(), 2UL);
+  BOOST_CHECK_CLOSE(map.height(point_type_fp(0, 0)), -0.01, 1e-3);
+  BOOST_CHECK_CLOSE(map.height(point_type_fp(10, 5)), 0.04, 1e-3);
+  BOOST_CHECK_CLOSE(map.height(point_type_fp(5, 2.5)), 0.015, 1e-3);
+  // Outside of the grid, the nearest edge is used.
+  BOOST_CHECK_CLOSE(map.height(point_type_fp(-5, -5)), -0.01, 1e-3);
+  BOOST_CHECK_CLOSE(map.height(point_type_fp(20, 2.5)), 0.025, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(read_csv) {
+  istringstream in("X,Y,Z\n"
+                   "0,0,0\n0,1,0\n0,2,0\n"
+                   "1,0,1\n1,1,1\n1,2,1\n"
+                   "1,1,3\n");
+  const auto map = HeightMap::read(in);
+  BOOST_CHECK_EQUAL(map.get_xs().size(), 2UL);
+  BOOST_CHECK_EQUAL(map.get_ys().size(), 3UL);
+  // Probed twice so it's the average.
+  BOOST_CHECK_CLOSE(map.height(point_type_fp(1, 1)), 2, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(not_a_grid) {
+  istringstream missing("0 0 0\n0 1 0\n1 0 0\n");
+  BOOST_CHECK_THROW(HeightMap::read(missing), std::invalid_argument);
+  istringstream line("0 0 0\n0 1 0\n");
+  BOOST_CHECK_THROW(HeightMap::read(line), std::invalid_argument);
+  istringstream empty("");
+  BOOST_CHECK_THROW(HeightMap::read(empty), std::invalid_argument);
+  istringstream short_line("0 0 0\n0 1\n");
+  BOOST_CHECK_THROW(HeightMap::read(short_line), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(flat) {
+  // A plane needs no points in between, even across the grid.
+  const HeightMap map({0, 1, 2, 3}, {0, 1, 2, 3},
+                      {0, 1, 2, 3, 1, 2, 3, 4, 2, 3, 4, 5, 3, 4, 5, 6});
+  const auto points = map.follow(point_type_fp(0, 0), point_type_fp(3, 2.5), -0.1, 0.001);
+  BOOST_REQUIRE_EQUAL(points.size(), 2UL);
+  BOOST_CHECK_CLOSE(points[0].second, -0.1, 1e-6);
+  BOOST_CHECK_CLOSE(points[1].second, 5.4, 1e-6);
+  BOOST_CHECK(bg::equals(points[1].first, point_type_fp(3, 2.5)));
+  const auto tilted_points = tilted().follow(point_type_fp(0, 5), point_type_fp(10, 5), 0, 0.001);
+  BOOST_CHECK_EQUAL(tilted_points.size(), 2UL);
+}
+
+BOOST_AUTO_TEST_CASE(same_point) {
+  const auto points = tilted().follow(point_type_fp(5, 5), point_type_fp(5, 5), -1, 0.001);
+  BOOST_REQUIRE_EQUAL(points.size(), 1UL);
+  BOOST_CHECK_CLOSE(points[0].second, -0.5, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(kink) {
+  // A ridge along x=1 needs a point on it and none elsewhere.
+  const HeightMap map({0, 1, 2}, {0, 1}, {0, 0, 1, 1, 0, 0});
+  const auto points = map.follow(point_type_fp(0, 0.5), point_type_fp(2, 0.5), 0, 0.001);
+  BOOST_REQUIRE_EQUAL(points.size(), 3UL);
+  BOOST_CHECK_CLOSE(points[1].first.x(), 1, 1e-6);
+  BOOST_CHECK_CLOSE(points[1].second, 1, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(within_tolerance) {
+  // A twisted cell, where the height along a diagonal is a parabola.
+  const HeightMap map({0, 10}, {0, 10}, {0, 1, 1, 0});
+  for (const double tolerance : {0.1, 0.01, 0.001}) {
+    const auto points = map.follow(point_type_fp(0, 0), point_type_fp(10, 10), 0, tolerance);
+    BOOST_CHECK_GT(points.size(), 2UL);
+    for (size_t i = 1; i < points.size(); i++) {
+      for (double f = 0; f <= 1; f += 0.01) {
+        const point_type_fp p(points[i-1].first.x() + (points[i].first.x() - points[i-1].first.x()) * f,
+                              points[i-1].first.y() + (points[i].first.y() - points[i-1].first.y()) * f);
+        const double z = points[i-1].second + (points[i].second - points[i-1].second) * f;
+        BOOST_CHECK_LE(std::abs(z - map.height(p)), tolerance * (1 + 1e-9));
+      }
+    }
+  }
+  // 100 times smaller tolerance needs only about 10 times as many points.
+  BOOST_CHECK_LE(map.follow(point_type_fp(0, 0), point_type_fp(10, 10), 0, 0.0001).size(),
+                 10 * map.follow(point_type_fp(0, 0), point_type_fp(10, 10), 0, 0.01).size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
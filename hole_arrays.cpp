@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "geometry.hpp"
+
+#include "hole_arrays.hpp"
+
+namespace hole_arrays {
+
+using std::vector;
+using std::map;
+using std::tuple;
+
+namespace {
+
+// Adding 0 makes -0 into 0 so that it isn't written as -0.00000.
+point_type_fp round_to(const point_type_fp& p, double resolution) {
+  return point_type_fp(std::round(p.x() / resolution) * resolution + 0.0,
+                       std::round(p.y() / resolution) * resolution + 0.0);
+}
+
+// The number of holes, from first and at most max_holes, that are in a
+// row from position going by step.  position is moved along the row the
+// way that the controller moves it, to just after the last hole that
+// matched.
+size_t row_length(const vector<point_type_fp>& holes, size_t first, size_t max_holes,
+                  point_type_fp& position, const point_type_fp& step, double tolerance) {
+  size_t count = 0;
+  while (count < max_holes && first + count < holes.size()) {
+    const auto& hole = holes[first + count];
+    if (std::abs(position.x() - hole.x()) > tolerance ||
+        std::abs(position.y() - hole.y()) > tolerance) {
+      break;
+    }
+    position = point_type_fp(position.x() + step.x(), position.y() + step.y());
+    count++;
+  }
+  return count;
+}
+
+// A row of evenly spaced holes, in order.
+struct Run {
+  vector<size_t> holes;
+  coordinate_type_fp step;
+  coordinate_type_fp v; // Where the row is across.
+};
+
+// Find the rows and grids of holes that aren't used yet with rows along
+// the axis, add them to paths and mark their holes as used.
+void find_grids(const vector<point_type_fp>& holes, vector<bool>& used, bool along_y,
+                size_t min_holes, double tolerance, multi_linestring_type_fp& paths) {
+  const auto u = [&](size_t i) { return along_y ? holes[i].y() : holes[i].x(); };
+  const auto v = [&](size_t i) { return along_y ? holes[i].x() : holes[i].y(); };
+  vector<size_t> sorted;
+  for (size_t i = 0; i < holes.size(); i++) {
+    if (!used[i]) {
+      sorted.push_back(i);
+    }
+  }
+  std::sort(sorted.begin(), sorted.end(), [&](size_t a, size_t b) {
+    return std::make_tuple(v(a), u(a), a) < std::make_tuple(v(b), u(b), b);
+  });
+
+  // The runs of each row, keyed by their length, step and start so that
+  // the runs that can make a grid together are together.
+  map<tuple<size_t, long long, long long>, vector<Run>> runs;
+  for (size_t row_start = 0; row_start < sorted.size(); ) {
+    size_t row_end = row_start + 1;
+    while (row_end < sorted.size() && v(sorted[row_end]) - v(sorted[row_start]) <= tolerance) {
+      row_end++;
+    }
+    vector<size_t> row(sorted.begin() + row_start, sorted.begin() + row_end);
+    std::sort(row.begin(), row.end(), [&](size_t a, size_t b) {
+      return std::make_tuple(u(a), a) < std::make_tuple(u(b), b);
+    });
+    // The index of the last hole in the run from first.
+    const auto run_end = [&](size_t first) {
+      const coordinate_type_fp step = u(row[first + 1]) - u(row[first]);
+      size_t last = first + 1;
+      while (last + 1 < row.size() &&
+             std::abs(u(row[last + 1]) - u(row[last]) - step) <= tolerance) {
+        last++;
+      }
+      return last;
+    };
+    for (size_t first = 0; first + 1 < row.size(); ) {
+      const coordinate_type_fp step = u(row[first + 1]) - u(row[first]);
+      if (step <= tolerance) {
+        first++; // The same place twice.
+        continue;
+      }
+      const size_t last = run_end(first);
+      if (last == first + 1 && first + 2 < row.size() &&
+          u(row[first + 2]) - u(row[first + 1]) > tolerance && run_end(first + 1) > first + 2) {
+        first++; // Leave the hole for the longer run after it.
+        continue;
+      }
+      Run run{vector<size_t>(row.begin() + first, row.begin() + last + 1), step, v(row[first])};
+      runs[std::make_tuple(run.holes.size(),
+                           std::llround(step / (2 * tolerance)),
+                           std::llround(u(row[first]) / (2 * tolerance)))].push_back(run);
+      first = last + 1;
+    }
+    row_start = row_end;
+  }
+
+  const auto add = [&](const vector<Run>& grid) {
+    linestring_type_fp path;
+    for (size_t r = 0; r < grid.size(); r++) {
+      // Back and forth.
+      const auto& row = grid[r].holes;
+      for (size_t c = 0; c < row.size(); c++) {
+        const auto hole = row[r % 2 ? row.size() - 1 - c : c];
+        path.push_back(holes[hole]);
+        used[hole] = true;
+      }
+    }
+    paths.push_back(path);
+  };
+  for (const auto& same_runs : runs) {
+    // The runs are sorted across already.
+    const auto& rows = same_runs.second;
+    const size_t columns = std::get<0>(same_runs.first);
+    for (size_t first = 0; first < rows.size(); ) {
+      size_t last = first;
+      if (first + 1 < rows.size()) {
+        const coordinate_type_fp row_step = rows[first + 1].v - rows[first].v;
+        while (last + 1 < rows.size() &&
+               std::abs(rows[last + 1].v - rows[last].v - row_step) <= tolerance) {
+          last++;
+        }
+      }
+      if ((last - first + 1) * columns >= min_holes) {
+        add(vector<Run>(rows.begin() + first, rows.begin() + last + 1));
+      } else if (columns >= min_holes) {
+        for (size_t r = first; r <= last; r++) {
+          add({rows[r]});
+        }
+      }
+      first = last + 1;
+    }
+  }
+}
+
+} // namespace
+
+vector<HoleArray> find(const vector<point_type_fp>& holes,
+                       size_t min_holes, double resolution) {
+  const double tolerance = resolution / 2;
+  vector<HoleArray> arrays;
+  size_t i = 0;
+  while (i + 1 < holes.size()) {
+    HoleArray array{i, 1, 1, round_to(holes[i], resolution),
+                    round_to(point_type_fp(holes[i+1].x() - holes[i].x(),
+                                           holes[i+1].y() - holes[i].y()), resolution),
+                    point_type_fp(0, 0)};
+    if (array.step.x() == 0 && array.step.y() == 0) {
+      i++;
+      continue;
+    }
+    auto position = array.start;
+    array.columns = row_length(holes, i, holes.size(), position, array.step, tolerance);
+    size_t next = i + array.columns;
+    if (array.columns >= 2 && next < holes.size()) {
+      const auto& row_end = holes[next - 1];
+      const auto row_step = round_to(point_type_fp(holes[next].x() - row_end.x(),
+                                                   holes[next].y() - row_end.y()), resolution);
+      auto step = array.step;
+      while (next + array.columns <= holes.size()) {
+        // Back to the end of the row, over to the next one and then the
+        // other way.
+        auto row_position = point_type_fp(position.x() - step.x() + row_step.x(),
+                                          position.y() - step.y() + row_step.y());
+        step = point_type_fp(-step.x(), -step.y());
+        if (row_length(holes, next, array.columns, row_position, step, tolerance) < array.columns) {
+          break;
+        }
+        position = row_position;
+        array.rows++;
+        next += array.columns;
+      }
+      if (array.rows > 1) {
+        array.row_step = row_step;
+      }
+    }
+    if (array.size() >= min_holes) {
+      arrays.push_back(array);
+      i += array.size();
+    } else {
+      i++;
+    }
+  }
+  return arrays;
+}
+
+multi_linestring_type_fp group(const multi_linestring_type_fp& paths,
+                               size_t min_holes, double tolerance) {
+  multi_linestring_type_fp grouped;
+  vector<point_type_fp> holes;
+  for (const auto& path : paths) {
+    if (path.size() == 2 && path.front().x() == path.back().x() && path.front().y() == path.back().y()) {
+      holes.push_back(path.front());
+    } else {
+      grouped.push_back(path);
+    }
+  }
+  vector<bool> used(holes.size(), false);
+  find_grids(holes, used, false, min_holes, tolerance, grouped);
+  find_grids(holes, used, true, min_holes, tolerance, grouped);
+  for (size_t i = 0; i < holes.size(); i++) {
+    if (!used[i]) {
+      grouped.push_back(linestring_type_fp{holes[i], holes[i]});
+    }
+  }
+  return grouped;
+}
+
+} // namespace hole_arrays
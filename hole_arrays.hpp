@@ -0,0 +1,47 @@
+#ifndef HOLE_ARRAYS_HPP
+#define HOLE_ARRAYS_HPP
+
+#include <vector>
+
+#include "geometry.hpp"
+
+namespace hole_arrays {
+
+// Holes in a row of columns holes, step apart, or in a few such rows.
+// Each row after the first goes back the other way and starts row_step
+// from the end of the row before, which is the order that group puts a
+// grid in.
+struct HoleArray {
+  size_t first; // The index of the first hole.
+  size_t columns;
+  size_t rows;
+  point_type_fp start;
+  point_type_fp step;
+  point_type_fp row_step; // (0, 0) if there is just one row.
+  size_t size() const {
+    return columns * rows;
+  }
+};
+
+// Find the arrays of at least min_holes holes among consecutive holes,
+// so that they can be drilled by a loop in the G-code.  start, step and
+// row_step are rounded to a multiple of resolution, as they will be
+// written, and the loop that adds them up on the controller stays within
+// resolution/2 of every hole.  The arrays are in order and don't
+// overlap.
+std::vector<HoleArray> find(const std::vector<point_type_fp>& holes,
+                            size_t min_holes, double resolution);
+
+// Each path of a drill bit is a hole, with the same start and end, or a
+// slot.  The holes that are evenly spaced in rows along x or y, or in
+// grids of such rows, with at least min_holes holes, are put together in
+// one path each with the holes in order, so that the path is drilled as
+// a whole.  Rows are along x if they can be.  Positions within tolerance
+// of each other are the same.  The other paths are left alone.
+// min_holes must be more than 2 so that a group isn't taken for a slot.
+multi_linestring_type_fp group(const multi_linestring_type_fp& paths,
+                               size_t min_holes, double tolerance);
+
+} // namespace hole_arrays
+
+#endif //HOLE_ARRAYS_HPP
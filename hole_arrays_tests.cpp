@@ -0,0 +1,190 @@
+#define BOOST_TEST_MODULE hole arrays tests
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include "geometry.hpp"
+#include "hole_arrays.hpp"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(hole_arrays_tests)
+
+// The holes that the controller drills for the array, adding up the
+// steps like the G-code does.
+vector<point_type_fp> replay(const hole_arrays::HoleArray& array) {
+  vector<point_type_fp> holes;
+  auto position = array.start;
+  auto step = array.step;
+  for (size_t row = 0; row < array.rows; row++) {
+    for (size_t column = 0; column < array.columns; column++) {
+      holes.push_back(position);
+      position = point_type_fp(position.x() + step.x(), position.y() + step.y());
+    }
+    position = point_type_fp(position.x() - step.x() + array.row_step.x(),
+                             position.y() - step.y() + array.row_step.y());
+    step = point_type_fp(-step.x(), -step.y());
+  }
+  return holes;
+}
+
+void check_replay(const vector<point_type_fp>& holes, const hole_arrays::HoleArray& array,
+                  double resolution) {
+  const auto replayed = replay(array);
+  for (size_t i = 0; i < replayed.size(); i++) {
+    BOOST_CHECK_LE(std::abs(replayed[i].x() - holes[array.first + i].x()), resolution / 2);
+    BOOST_CHECK_LE(std::abs(replayed[i].y() - holes[array.first + i].y()), resolution / 2);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(row) {
+  vector<point_type_fp> holes{{5, 5}};
+  for (int i = 0; i < 10; i++) {
+    holes.push_back(point_type_fp(1 + 2.54 * i, 3));
+  }
+  holes.push_back(point_type_fp(7, 7));
+  const auto arrays = hole_arrays::find(holes, 8, 1e-5);
+  BOOST_REQUIRE_EQUAL(arrays.size(), 1UL);
+  BOOST_CHECK_EQUAL(arrays[0].first, 1UL);
+  BOOST_CHECK_EQUAL(arrays[0].columns, 10UL);
+  BOOST_CHECK_EQUAL(arrays[0].rows, 1UL);
+  BOOST_CHECK_CLOSE(arrays[0].step.x(), 2.54, 1e-9);
+  BOOST_CHECK_EQUAL(arrays[0].step.y(), 0);
+  BOOST_CHECK_EQUAL(arrays[0].row_step.x(), 0);
+  check_replay(holes, arrays[0], 1e-5);
+}
+
+BOOST_AUTO_TEST_CASE(grid) {
+  // Serpentine, like the nearest neighbour leaves it.
+  vector<point_type_fp> holes;
+  for (int row = 0; row < 3; row++) {
+    for (int column = 0; column < 4; column++) {
+      const int x = row % 2 ? 3 - column : column;
+      holes.push_back(point_type_fp(0.1 * x, 0.8 * row));
+    }
+  }
+  const auto arrays = hole_arrays::find(holes, 8, 1e-5);
+  BOOST_REQUIRE_EQUAL(arrays.size(), 1UL);
+  BOOST_CHECK_EQUAL(arrays[0].first, 0UL);
+  BOOST_CHECK_EQUAL(arrays[0].columns, 4UL);
+  BOOST_CHECK_EQUAL(arrays[0].rows, 3UL);
+  BOOST_CHECK_CLOSE(arrays[0].row_step.y(), 0.8, 1e-9);
+  check_replay(holes, arrays[0], 1e-5);
+}
+
+BOOST_AUTO_TEST_CASE(partial_row) {
+  // The last row is short so it isn't part of the grid.
+  vector<point_type_fp> holes;
+  for (int row = 0; row < 3; row++) {
+    for (int column = 0; column < (row < 2 ? 5 : 2); column++) {
+      const int x = row % 2 ? 4 - column : column;
+      holes.push_back(point_type_fp(x, row));
+    }
+  }
+  const auto arrays = hole_arrays::find(holes, 8, 1e-5);
+  BOOST_REQUIRE_EQUAL(arrays.size(), 1UL);
+  BOOST_CHECK_EQUAL(arrays[0].columns, 5UL);
+  BOOST_CHECK_EQUAL(arrays[0].rows, 2UL);
+}
+
+BOOST_AUTO_TEST_CASE(too_few) {
+  vector<point_type_fp> holes;
+  for (int i = 0; i < 7; i++) {
+    holes.push_back(point_type_fp(i, 0));
+  }
+  BOOST_CHECK_EQUAL(hole_arrays::find(holes, 8, 1e-5).size(), 0UL);
+  BOOST_CHECK_EQUAL(hole_arrays::find(holes, 7, 1e-5).size(), 1UL);
+  BOOST_CHECK_EQUAL(hole_arrays::find({}, 8, 1e-5).size(), 0UL);
+}
+
+BOOST_AUTO_TEST_CASE(same_place) {
+  const vector<point_type_fp> holes(10, point_type_fp(1, 1));
+  BOOST_CHECK_EQUAL(hole_arrays::find(holes, 2, 1e-5).size(), 0UL);
+}
+
+BOOST_AUTO_TEST_CASE(rounding) {
+  // The rounded step drifts away from the holes so the array is cut
+  // short before the loop would be more than half a digit off.
+  vector<point_type_fp> holes;
+  for (int i = 0; i < 100; i++) {
+    holes.push_back(point_type_fp(i / 3.0, 0));
+  }
+  const auto arrays = hole_arrays::find(holes, 2, 1e-5);
+  BOOST_REQUIRE_GT(arrays.size(), 1UL);
+  size_t next = 0;
+  for (const auto& array : arrays) {
+    BOOST_CHECK_GE(array.first, next);
+    BOOST_CHECK_LT(array.size(), 100UL);
+    check_replay(holes, array, 1e-5);
+    next = array.first + array.size();
+  }
+}
+
+linestring_type_fp hole(double x, double y) {
+  return linestring_type_fp{{x, y}, {x, y}};
+}
+
+BOOST_AUTO_TEST_CASE(group_grid) {
+  multi_linestring_type_fp paths;
+  // A grid in no order, with a stray hole and a slot.
+  for (int i = 0; i < 12; i++) {
+    const int shuffled = i * 5 % 12;
+    paths.push_back(hole(0.1 * (shuffled % 4), 0.3 + 0.05 * (shuffled / 4)));
+  }
+  paths.push_back(hole(2, 2));
+  paths.push_back(linestring_type_fp{{3, 3}, {3, 4}});
+  const auto grouped = hole_arrays::group(paths, 8, 1e-6);
+  BOOST_REQUIRE_EQUAL(grouped.size(), 3UL);
+  BOOST_CHECK_EQUAL(grouped[0].size(), 2UL); // The slot.
+  BOOST_CHECK_EQUAL(grouped[1].size(), 12UL);
+  BOOST_CHECK_EQUAL(grouped[2].size(), 2UL);
+  BOOST_CHECK_EQUAL(grouped[2].front().x(), 2);
+
+  const vector<point_type_fp> holes(grouped[1].begin(), grouped[1].end());
+  const auto arrays = hole_arrays::find(holes, 8, 1e-5);
+  BOOST_REQUIRE_EQUAL(arrays.size(), 1UL);
+  BOOST_CHECK_EQUAL(arrays[0].columns, 4UL);
+  BOOST_CHECK_EQUAL(arrays[0].rows, 3UL);
+  check_replay(holes, arrays[0], 1e-5);
+}
+
+BOOST_AUTO_TEST_CASE(group_column) {
+  multi_linestring_type_fp paths;
+  for (int i = 9; i >= 0; i--) {
+    paths.push_back(hole(1, 0.1 * i));
+  }
+  const auto grouped = hole_arrays::group(paths, 8, 1e-6);
+  BOOST_REQUIRE_EQUAL(grouped.size(), 1UL);
+  BOOST_REQUIRE_EQUAL(grouped[0].size(), 10UL);
+  BOOST_CHECK_EQUAL(grouped[0].front().y(), 0);
+  const vector<point_type_fp> holes(grouped[0].begin(), grouped[0].end());
+  BOOST_CHECK_EQUAL(hole_arrays::find(holes, 8, 1e-5).size(), 1UL);
+}
+
+BOOST_AUTO_TEST_CASE(group_neighbour) {
+  // The hole on the left isn't taken into a run of 2 with the first hole
+  // of the row.
+  multi_linestring_type_fp paths{hole(-5, 0)};
+  for (int i = 0; i < 8; i++) {
+    paths.push_back(hole(i, 0));
+  }
+  const auto grouped = hole_arrays::group(paths, 8, 1e-6);
+  BOOST_REQUIRE_EQUAL(grouped.size(), 2UL);
+  BOOST_CHECK_EQUAL(grouped[0].size(), 8UL);
+  BOOST_CHECK_EQUAL(grouped[1].front().x(), -5);
+}
+
+BOOST_AUTO_TEST_CASE(group_too_few) {
+  multi_linestring_type_fp paths;
+  for (int i = 0; i < 7; i++) {
+    paths.push_back(hole(i, 0));
+  }
+  // Uneven.
+  for (int i = 0; i < 10; i++) {
+    paths.push_back(hole(i * i, 1));
+  }
+  BOOST_CHECK_EQUAL(hole_arrays::group(paths, 8, 1e-6).size(), 17UL);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -40,6 +40,10 @@ TEST_CASES = ([TestCase(x, os.path.join(EXAMPLES_PATH, x), [], 0)
                   "backtrack",
                   "backtrack_0",
                   "D1MiniGSR",
+                  "drill_arrays_linuxcnc",
+                  "drill_arrays_linuxcnc_nog81",
+                  "drill_arrays_mach3",
+                  "drill_arrays_mach3_nog81",
                   "Easy-SDR_HF_Upconverter_SMD_Gerbers",
                   "edge-cuts-broken-loop",
                   "edge-cuts-inside-cuts",
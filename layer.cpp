@@ -50,11 +50,21 @@ Layer::Layer(const std::string& name, shared_ptr<Surface_vectorial> surface,
     this->manufacturer = manufacturer;
 }
 
+Layer::Layer(const toolpath_file::LayerToolpaths& saved, shared_ptr<RoutingMill> manufacturer) :
+    name(saved.name), mirrored(saved.backside), ymirrored(false), manufacturer(manufacturer),
+    saved_toolpaths(saved.toolpaths), saved_bridges(saved.bridges) {}
+
 #include <iostream>
 
 /******************************************************************************/
-vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Layer::get_toolpaths() {
-  return surface->get_toolpath(manufacturer, mirrored, ymirrored);
+void Layer::get_toolpaths(const Surface_vectorial::ToolpathDone& done) {
+  if (!surface) {
+    for (const auto& tool : saved_toolpaths) {
+      done(saved_toolpaths.size(), tool.first, tool.second);
+    }
+    return;
+  }
+  surface->get_toolpath(manufacturer, mirrored, ymirrored, done);
 }
 
 /******************************************************************************/
@@ -66,6 +76,18 @@ shared_ptr<RoutingMill> Layer::get_manufacturer()
     return manufacturer;
 }
 
+vector<coordinate_type_fp> Layer::get_tool_diameters() const {
+  vector<coordinate_type_fp> tool_diameters;
+  if (auto isolator = dynamic_pointer_cast<Isolator>(manufacturer)) {
+    for (const auto& tool : isolator->tool_diameters_and_overlap_widths) {
+      tool_diameters.push_back(tool.first);
+    }
+  } else if (auto cutter = dynamic_pointer_cast<Cutter>(manufacturer)) {
+    tool_diameters.push_back(cutter->tool_diameter);
+  }
+  return tool_diameters;
+}
+
 /******************************************************************************/
 /*
  */
@@ -75,12 +97,17 @@ void Layer::add_mask(shared_ptr<Layer> mask)
     surface->add_mask(mask->surface);
 }
 
-vector<size_t> Layer::get_bridges(linestring_type_fp& toolpath) {
+vector<vector<size_t>> Layer::get_bridges(multi_linestring_type_fp& toolpaths) {
+  if (!surface) {
+    return saved_bridges; // Already in the saved toolpaths.
+  }
   auto cutter = dynamic_pointer_cast<Cutter>(manufacturer);
-  auto bridges = outline_bridges::makeBridges(
-      toolpath,
-      cutter->bridges_num,
-      cutter->bridges_width + cutter->tool_diameter );
-
+  vector<vector<size_t>> bridges;
+  for (auto& toolpath : toolpaths) {
+    bridges.push_back(outline_bridges::makeBridges(
+        toolpath,
+        cutter->bridges_num,
+        cutter->bridges_width + cutter->tool_diameter));
+  }
   return bridges;
 }
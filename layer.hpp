@@ -29,18 +29,35 @@
 #include "geometry.hpp"
 #include "surface_vectorial.hpp"
 #include "mill.hpp"
+#include "toolpath_file.hpp"
 
 class Layer : private boost::noncopyable {
  public:
   Layer(const std::string& name, std::shared_ptr<Surface_vectorial> surface,
         std::shared_ptr<RoutingMill> manufacturer, bool backside, bool ymirror);
+  // A layer with the toolpaths and bridges saved by an earlier run,
+  // which has no surface.
+  Layer(const toolpath_file::LayerToolpaths& saved, std::shared_ptr<RoutingMill> manufacturer);
 
-  std::vector<std::pair<coordinate_type_fp, multi_linestring_type_fp>> get_toolpaths();
+  // Calls done with the toolpaths of each tool as soon as they are found.
+  void get_toolpaths(const Surface_vectorial::ToolpathDone& done);
   std::shared_ptr<RoutingMill> get_manufacturer();
-  std::vector<size_t> get_bridges(linestring_type_fp& toolpath);
+  // Adds the bridges to the outline and returns them, one list for each
+  // path.
+  std::vector<std::vector<size_t>> get_bridges(multi_linestring_type_fp& toolpaths);
   std::string get_name() {
     return name;
   }
+  // Whether the layer is mirrored, which is true for the back side.
+  bool get_mirrored() const {
+    return mirrored;
+  }
+  // The diameters of the tools of the manufacturer, in inches.
+  std::vector<coordinate_type_fp> get_tool_diameters() const;
+  // The number of points in the shapes after each step, for reporting.
+  const std::vector<std::pair<std::string, size_t>>& get_point_counts() const {
+    return surface->get_point_counts();
+  }
   void add_mask(std::shared_ptr<Layer>);
 
  private:
@@ -49,6 +66,9 @@ class Layer : private boost::noncopyable {
   bool ymirrored;
   std::shared_ptr<Surface_vectorial> surface;
   std::shared_ptr<RoutingMill> manufacturer;
+  // Only for layers without a surface.
+  std::vector<std::pair<coordinate_type_fp, multi_linestring_type_fp>> saved_toolpaths;
+  std::vector<std::vector<size_t>> saved_bridges;
 
   friend class Board;
 };
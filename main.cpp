@@ -24,6 +24,7 @@
 #include <fstream>
 #include <sstream>
 #include <memory>
+#include <algorithm>
 
 #include <vector>
 using std::vector;
@@ -43,6 +44,9 @@ using std::string;
 #include "ngc_exporter.hpp"
 #include "board.hpp"
 #include "drill.hpp"
+#include "task_graph.hpp"
+#include "svg_writer.hpp"
+#include "toolpath_file.hpp"
 #include "options.hpp"
 #include "units.hpp"
 
@@ -118,9 +122,15 @@ void do_pcb2gcode(int argc, const char* argv[]) {
         isolator->preserve_thermal_reliefs = vm["preserve-thermal-reliefs"].as<bool>();
         isolator->eulerian_paths = vm["eulerian-paths"].as<bool>();
         isolator->path_finding_limit = vm["path-finding-limit"].as<size_t>();
+        isolator->path_finding_time_limit = vm.count("path-finding-time-limit") ?
+            vm["path-finding-time-limit"].as<Time>().asSecond(1) :
+            std::numeric_limits<double>::infinity();
         isolator->g0_vertical_speed = vm["g0-vertical-speed"].as<Velocity>().asInchPerMinute(unit);
         isolator->g0_horizontal_speed = vm["g0-horizontal-speed"].as<Velocity>().asInchPerMinute(unit);
         isolator->backtrack = vm["backtrack"].as<Velocity>().asInchPerMinute(unit);
+        isolator->jobs = vm["jobs"].as<unsigned int>();
+        isolator->voronoi_tile_size = vm["voronoi-tile-size"].as<Length>().asInch(unit);
+        isolator->cache_dir = vm["cache-dir"].as<string>();
         if (vm.count("mill-infeed")) {
           isolator->stepsize = vm["mill-infeed"].as<Length>().asInch(unit);
         } else {
@@ -158,6 +168,8 @@ void do_pcb2gcode(int argc, const char* argv[]) {
       cutter->path_finding_limit = vm["path-finding-limit"].as<size_t>();
       cutter->g0_vertical_speed = vm["g0-vertical-speed"].as<Velocity>().asInchPerMinute(unit);
       cutter->g0_horizontal_speed = vm["g0-horizontal-speed"].as<Velocity>().asInchPerMinute(unit);
+      cutter->jobs = vm["jobs"].as<unsigned int>();
+      cutter->cache_dir = vm["cache-dir"].as<string>();
       cutter->tolerance = tolerance;
       cutter->explicit_tolerance = explicit_tolerance;
       cutter->spinup_time = vm["spinup-time"].as<Time>().asMillisecond(1);
@@ -266,7 +278,8 @@ void do_pcb2gcode(int argc, const char* argv[]) {
         vm["tsp-2opt"].as<bool>(),
         vm["mill-feed-direction"].as<MillFeedDirection::MillFeedDirection>(),
         vm["invert-gerbers"].as<bool>(),
-        !vm["draw-gerber-lines"].as<bool>());
+        !vm["draw-gerber-lines"].as<bool>(),
+        vm["svg-resolution"].as<Length>().asInch(unit));
 
     // this is currently disabled, use --outline instead
     if (vm.count("margins"))
@@ -277,14 +290,26 @@ void do_pcb2gcode(int argc, const char* argv[]) {
     //--------------------------------------------------------------------------
     //load files, import layer files, create surface:
 
+    // With from-toolpaths, the layers come from that file and the gerbers
+    // aren't read.
+    const string from_toolpaths = vm["from-toolpaths"].as<string>();
+    auto import = [&from_toolpaths](const string& filename) {
+      shared_ptr<GerberImporter> importer;
+      if (from_toolpaths.empty()) {
+        importer = make_shared<GerberImporter>();
+        if (!importer->load_file(filename)) {
+          options::maybe_throw("ERROR.", ERR_INVALIDPARAMETER);
+        }
+      }
+      return importer;
+    };
+
     cout << "Importing front side... " << flush;
     if (vm.count("front") > 0) {
       string frontfile = vm["front"].as<string>();
-      auto importer = make_shared<GerberImporter>();
-      if (!importer->load_file(frontfile)) {
-        options::maybe_throw("ERROR.", ERR_INVALIDPARAMETER);
-      }
-      board->prepareLayer("front", importer, isolator, false, ymirror);
+      auto importer = import(frontfile);
+      board->prepareLayer("front", importer, isolator, false, ymirror,
+                          vm["front-simplify"].as<Length>().asInch(unit));
       cout << "DONE.\n";
     } else {
       cout << "not specified.\n";
@@ -293,11 +318,9 @@ void do_pcb2gcode(int argc, const char* argv[]) {
     cout << "Importing back side... " << flush;
     if (vm.count("back") > 0) {
       string backfile = vm["back"].as<string>();
-      auto importer = make_shared<GerberImporter>();
-      if (!importer->load_file(backfile)) {
-        options::maybe_throw("ERROR.", ERR_INVALIDPARAMETER);
-      }
-      board->prepareLayer("back", importer, isolator, true, ymirror);
+      auto importer = import(backfile);
+      board->prepareLayer("back", importer, isolator, true, ymirror,
+                          vm["back-simplify"].as<Length>().asInch(unit));
       cout << "DONE.\n";
     } else {
       cout << "not specified.\n";
@@ -306,22 +329,38 @@ void do_pcb2gcode(int argc, const char* argv[]) {
     cout << "Importing outline... " << flush;
     if (vm.count("outline") > 0) {
       string outline = vm["outline"].as<string>();
-      auto importer = make_shared<GerberImporter>();
-      if (!importer->load_file(outline)) {
-        options::maybe_throw("ERROR.", ERR_INVALIDPARAMETER);
-      }
-      board->prepareLayer("outline", importer, cutter, !workSide(vm, "cut"), ymirror);
+      auto importer = import(outline);
+      board->prepareLayer("outline", importer, cutter, !workSide(vm, "cut"), ymirror,
+                          vm["outline-simplify"].as<Length>().asInch(unit));
       cout << "DONE.\n";
     } else {
       cout << "not specified.\n";
     }
 
-    cout << "Processing input files... " << flush;
-    board->createLayers();
+    const unsigned int jobs = vm["jobs"].as<unsigned int>();
+    if (from_toolpaths.empty()) {
+      cout << "Processing input files... " << flush;
+      board->createLayers(jobs);
+    } else {
+      cout << "Loading toolpaths... " << flush;
+      const auto toolpaths = toolpath_file::load(from_toolpaths);
+      // The saved paths are already mirrored.
+      if (std::abs(toolpaths.mirror_axis - vm["mirror-axis"].as<Length>().asInch(unit)) > 1e-9 ||
+          toolpaths.mirror_yaxis != ymirror ||
+          toolpaths.mirror_absolute != vm["mirror-absolute"].as<bool>()) {
+        options::maybe_throw("The toolpaths file was made with different --mirror-axis, --mirror-yaxis or "
+                             "--mirror-absolute.", ERR_INVALIDPARAMETER);
+      }
+      board->loadLayers(toolpaths);
+    }
     cout << "DONE.\n";
 
+    // The layers and the drill file are exported by these tasks, which
+    // run together at the end.
+    TaskGraph tasks;
+    shared_ptr<NGC_Exporter> exporter;
     if (!vm["no-export"].as<bool>()) {
-      auto exporter = make_shared<NGC_Exporter>(board);
+      exporter = make_shared<NGC_Exporter>(board);
       exporter->add_header(PACKAGE_STRING);
 
       if (vm.count("preamble") || vm.count("preamble-text")) {
@@ -332,13 +371,21 @@ void do_pcb2gcode(int argc, const char* argv[]) {
         exporter->set_postamble(postamble);
       }
 
-      exporter->export_all(vm);
+      exporter->export_all(vm, tasks);
+      // The front and back find their toolpaths side by side, each on
+      // one of the jobs, so they don't start more threads of their own.
+      const auto layers = board->list_layers();
+      if (std::find(layers.cbegin(), layers.cend(), "front") != layers.cend() &&
+          std::find(layers.cbegin(), layers.cend(), "back") != layers.cend()) {
+        isolator->jobs = 1;
+      }
     }
 
     //---------------------------------------------------------------------------
     //load and process the drill file
 
     cout << "Importing drill... " << flush;
+    string drill_message;
 
     if (vm.count("drill") > 0) {
         try
@@ -363,18 +410,23 @@ void do_pcb2gcode(int argc, const char* argv[]) {
               max = board->get_bounding_box().max_corner();
             }
 
-            ExcellonProcessor ep(vm, min, max);
+            auto ep = make_shared<ExcellonProcessor>(vm, min, max);
 
-            ep.add_header(PACKAGE_STRING);
+            ep->add_header(PACKAGE_STRING);
+            // The drill file is exported alongside the layers, which
+            // already use all the jobs.
+            if (tasks.size() > 0) {
+              ep->set_jobs(1);
+            }
 
             if (vm.count("preamble") || vm.count("preamble-text"))
             {
-                ep.set_preamble(preamble);
+                ep->set_preamble(preamble);
             }
 
             if (vm.count("postamble"))
             {
-                ep.set_postamble(postamble);
+                ep->set_postamble(postamble);
             }
 
             cout << "DONE.\n";
@@ -386,25 +438,34 @@ void do_pcb2gcode(int argc, const char* argv[]) {
                 drill_filename = boost::none;
                 milldrill_filename = boost::none;
             }
-            // We can modify the cutter because we're not going to use it again.
+            // The outline might still be using the cutter so modify a copy.
+            auto milldriller = make_shared<Cutter>(*cutter);
             if (vm.count("milldrill-diameter")) {
-              cutter->tool_diameter = vm["milldrill-diameter"].as<Length>().asInch(unit);
+              milldriller->tool_diameter = vm["milldrill-diameter"].as<Length>().asInch(unit);
             }
             if (vm.count("zmilldrill")) {
-              cutter->zwork = vm["zmilldrill"].as<Length>().asInch(unit);
+              milldriller->zwork = vm["zmilldrill"].as<Length>().asInch(unit);
             } else {
-              cutter->zwork = vm["zdrill"].as<Length>().asInch(unit);
+              milldriller->zwork = vm["zdrill"].as<Length>().asInch(unit);
             }
-            ep.export_ngc(outputdir, milldrill_filename, cutter,
-                          vm["zchange-absolute"].as<bool>());
-            ep.export_ngc(outputdir, drill_filename,
-                          driller, vm["onedrill"].as<bool>(), 
-                          vm["nog81"].as<bool>(),
-                          vm["nom6"].as<bool>(),
-                          vm["zchange-absolute"].as<bool>());
-
-            cout << "DONE. The board should be drilled from the " << ( workSide(vm, "drill") ? "FRONT" : "BACK" ) << " side.\n";
-
+            // The message is printed once all the tasks are done so that
+            // it isn't mixed up with the messages of the layers.
+            tasks.add([&vm, &drill_message, ep, outputdir, drill_filename, milldrill_filename, milldriller, driller]() {
+                  try {
+                    ep->export_ngc(outputdir, milldrill_filename, milldriller,
+                                       vm["zchange-absolute"].as<bool>());
+                    ep->export_ngc(outputdir, drill_filename,
+                                       driller, vm["onedrill"].as<bool>(),
+                                       vm["nog81"].as<bool>(),
+                                       vm["nom6"].as<bool>(),
+                                       vm["zchange-absolute"].as<bool>());
+                  } catch (const drill_exception& e) {
+                    options::maybe_throw("ERROR: drill_exception", ERR_INVALIDPARAMETER);
+                  }
+
+                  drill_message = string("Exporting milldrill... Exporting drill... DONE. The board should be drilled from the ") +
+                                  (workSide(vm, "drill") ? "FRONT" : "BACK") + " side.\n";
+                });
         }
         catch (const drill_exception& e) {
           options::maybe_throw("ERROR: drill_exception", ERR_INVALIDPARAMETER);
@@ -413,6 +474,21 @@ void do_pcb2gcode(int argc, const char* argv[]) {
         cout << "not specified.\n";
     }
 
+    tasks.run(jobs);
+    svg_writer::flush();
+    cout << drill_message;
+    // The points of each step, up to the toolpaths that were just made.
+    for (const auto& layername : board->list_layers()) {
+      if (from_toolpaths.empty() && vm[layername + "-simplify"].as<Length>().asInch(unit) > 0) {
+        cout << "Points in " << layername << ":";
+        const auto& point_counts = board->get_layer(layername)->get_point_counts();
+        for (size_t i = 0; i < point_counts.size(); i++) {
+          cout << " " << point_counts[i].second << " " << point_counts[i].first
+               << (i + 1 < point_counts.size() ? "," : ".\n");
+        }
+      }
+    }
+
     cout << "END." << endl;
 
 }
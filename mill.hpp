@@ -60,6 +60,8 @@ class RoutingMill: public Mill {
   double g0_vertical_speed;
   double g0_horizontal_speed;
   double backtrack;
+  unsigned int jobs; // Threads for the searches in one layer, 0 for one per core.
+  std::string cache_dir; // Where to save the voronoi regions between runs, empty for nowhere.
   double stepsize;
   double offset;  // Stay away from the traces by this amount.
 };
@@ -77,6 +79,10 @@ class Isolator: public RoutingMill {
   bool voronoi;
   bool preserve_thermal_reliefs;
   double isolation_width;
+  double voronoi_tile_size; // 0 to make the voronoi regions all at once.
+  // Seconds per layer for joining the paths of the traces, infinity for
+  // no limit.  The outline doesn't search between its paths.
+  double path_finding_time_limit;
 };
 
 /******************************************************************************/
@@ -40,14 +40,19 @@ using std::vector;
 
 #include <utility>
 using std::pair;
+using std::make_pair;
 
 #include <cmath>
 using std::ceil;
 
+#include <algorithm>
+
 #include <memory>
 using std::shared_ptr;
 using std::dynamic_pointer_cast;
 
+#include <exception>
+
 #include <iomanip>
 
 #include <boost/format.hpp>
@@ -58,6 +63,16 @@ using boost::format;
 NGC_Exporter::NGC_Exporter(shared_ptr<Board> board)
     : board(board), ocodes(1), globalVars(100) {}
 
+NGC_Exporter::~NGC_Exporter() {
+  if (export_thread.joinable()) {
+    // Finding the toolpaths failed, so not all of them will come.
+    for (const auto& queue : queues) {
+      queue->fail();
+    }
+    export_thread.join();
+  }
+}
+
 /******************************************************************************/
 /*
  */
@@ -71,13 +86,14 @@ void NGC_Exporter::add_header(string header)
 /*
  */
 /******************************************************************************/
-void NGC_Exporter::export_all(boost::program_options::variables_map& options)
+void NGC_Exporter::export_all(boost::program_options::variables_map& options, TaskGraph& tasks)
 {
 
     bMetricinput = options["metric"].as<bool>();      //set flag for metric input
     bMetricoutput = options["metricoutput"].as<bool>();      //set flag for metric output
     bZchangeG53 = options["zchange-absolute"].as<bool>();
     nom6 = options["nom6"].as<bool>();
+    compact_gcode = options["compact-gcode"].as<bool>();
     
     string outputdir = options["output-dir"].as<string>();
     
@@ -86,48 +102,130 @@ void NGC_Exporter::export_all(boost::program_options::variables_map& options)
     
     tileInfo = Tiling::generateTileInfo( options, board->get_height(), board->get_width() );
 
-    for ( string layername : board->list_layers() )
-    {
-        if (options["zero-start"].as<bool>()) {
-          xoffset = board->get_bounding_box().min_corner().x();
-          yoffset = board->get_bounding_box().min_corner().y();
-        } else {
-          xoffset = 0;
-          yoffset = 0;
+    // Finding the toolpaths is the slow part and each layer can do it
+    // on its own, except that the other layers use the outline as a
+    // mask, so the outline must wait for them.  Writing the files uses
+    // the unique codes, so that is done one layer at a time, in order,
+    // on a thread of its own that writes each tool while the next one
+    // is being found.
+    const vector<string> layernames = board->list_layers();
+    const string save_toolpaths = options["save-toolpaths"].as<string>();
+    auto all_toolpaths = std::make_shared<toolpath_file::Toolpaths>();
+    all_toolpaths->bounding_box = board->get_bounding_box();
+    all_toolpaths->mirror_axis = options["mirror-axis"].as<Length>().asInch(bMetricinput ? 1.0/25.4 : 1);
+    all_toolpaths->mirror_yaxis = options["mirror-yaxis"].as<bool>();
+    all_toolpaths->mirror_absolute = options["mirror-absolute"].as<bool>();
+    all_toolpaths->layers.resize(layernames.size());
+    vector<TaskGraph::TaskId> toolpaths_done;
+    for (size_t i = 0; i < layernames.size(); i++) {
+        shared_ptr<Layer> layer = board->get_layer(layernames[i]);
+        auto queue = std::make_shared<ToolpathQueue>();
+        queues.push_back(queue);
+        vector<TaskGraph::TaskId> dependencies;
+        if (layernames[i] == "outline") {
+            dependencies = toolpaths_done;
         }
-        xoffset -= options["x-offset"].as<Length>().asInch(bMetricinput ? 1.0/25.4 : 1);
-        yoffset -= options["y-offset"].as<Length>().asInch(bMetricinput ? 1.0/25.4 : 1);
-        if (layername == "back" ||
-            (layername == "outline" && !workSide(options, "cut"))) {
-            if (options["mirror-yaxis"].as<bool>()) {
-                yoffset = -yoffset + tileInfo.boardHeight*(tileInfo.tileY-1);
-                yoffset -= 2 * options["mirror-axis"].as<Length>().asInch(bMetricinput ? 1.0/25.4 : 1);
-            } else {
-                xoffset = -xoffset + tileInfo.boardWidth*(tileInfo.tileX-1);
-                xoffset -= 2 * options["mirror-axis"].as<Length>().asInch(bMetricinput ? 1.0/25.4 : 1);
+        const bool save = !save_toolpaths.empty();
+        toolpaths_done.push_back(tasks.add([layer, all_toolpaths, queue, save, i]() {
+              auto& layer_toolpaths = all_toolpaths->layers[i];
+              layer_toolpaths.name = layer->get_name();
+              layer_toolpaths.backside = layer->get_mirrored();
+              layer_toolpaths.tool_diameters = layer->get_tool_diameters();
+              try {
+                layer->get_toolpaths([&](size_t tool_count, coordinate_type_fp tool_diameter,
+                                         multi_linestring_type_fp toolpaths) {
+                    ToolpathQueue::Tool tool{tool_diameter, std::move(toolpaths), {}};
+                    // Cutter layer can only have one tool_diameter.
+                    if (dynamic_pointer_cast<Cutter>(layer->get_manufacturer())) {
+                      tool.bridges = layer->get_bridges(tool.paths);
+                    }
+                    if (save) {
+                      layer_toolpaths.toolpaths.push_back(make_pair(tool.diameter, tool.paths));
+                      layer_toolpaths.bridges = tool.bridges;
+                    }
+                    queue->push(tool_count, std::move(tool));
+                  });
+              } catch (...) {
+                queue->fail();
+                throw;
+              }
+              queue->close();
+            }, dependencies));
+    }
+
+    if (!save_toolpaths.empty()) {
+        tasks.add([all_toolpaths, save_toolpaths]() {
+              toolpath_file::save(save_toolpaths, *all_toolpaths);
+            }, toolpaths_done);
+    }
+
+    export_thread = std::thread([this, &options, outputdir, layernames]() {
+          try {
+            for (size_t i = 0; i < layernames.size(); i++) {
+              export_layer(options, outputdir, layernames[i], *queues[i]);
             }
-        }
+          } catch (...) {
+            export_exception = std::current_exception();
+            // Don't keep the tasks that find the toolpaths waiting.
+            for (const auto& queue : queues) {
+              queue->abandon();
+            }
+          }
+        });
+    tasks.add([this]() {
+          export_thread.join();
+          if (export_exception) {
+            std::rethrow_exception(export_exception);
+          }
+        }, toolpaths_done);
+}
 
-        boost::optional<autoleveller> leveller = boost::none;
-        if ((options["al-front"].as<bool>() && layername == "front") ||
-            (options["al-back"].as<bool>() && layername == "back")) {
-          leveller.emplace(options, &ocodes, &globalVars,
-                           xoffset, yoffset, tileInfo);
+void NGC_Exporter::export_layer(boost::program_options::variables_map& options,
+                                const string& outputdir, const string& layername,
+                                ToolpathQueue& queue)
+{
+    if (options["zero-start"].as<bool>()) {
+      xoffset = board->get_bounding_box().min_corner().x();
+      yoffset = board->get_bounding_box().min_corner().y();
+    } else {
+      xoffset = 0;
+      yoffset = 0;
+    }
+    xoffset -= options["x-offset"].as<Length>().asInch(bMetricinput ? 1.0/25.4 : 1);
+    yoffset -= options["y-offset"].as<Length>().asInch(bMetricinput ? 1.0/25.4 : 1);
+    if (layername == "back" ||
+        (layername == "outline" && !workSide(options, "cut"))) {
+        if (options["mirror-yaxis"].as<bool>()) {
+            yoffset = -yoffset + tileInfo.boardHeight*(tileInfo.tileY-1);
+            yoffset -= 2 * options["mirror-axis"].as<Length>().asInch(bMetricinput ? 1.0/25.4 : 1);
+        } else {
+            xoffset = -xoffset + tileInfo.boardWidth*(tileInfo.tileX-1);
+            xoffset -= 2 * options["mirror-axis"].as<Length>().asInch(bMetricinput ? 1.0/25.4 : 1);
         }
+    }
 
-        std::stringstream option_name;
-        option_name << layername << "-output";
-        string of_name = build_filename(outputdir, options[option_name.str()].as<string>());
-        cout << "Exporting " << layername << "... " << flush;
-        export_layer(board->get_layer(layername), of_name, leveller);
-        cout << "DONE." << " (Height: " << board->get_height() * cfactor
-             << (bMetricoutput ? "mm" : "in") << " Width: "
-             << board->get_width() * cfactor << (bMetricoutput ? "mm" : "in")
-             << ")";
-        if (layername == "outline")
-            cout << " The board should be cut from the " << ( workSide(options, "cut") ? "FRONT" : "BACK" ) << " side. ";
-        cout << endl;
+    boost::optional<autoleveller> leveller = boost::none;
+    if ((options["al-front"].as<bool>() && layername == "front") ||
+        (options["al-back"].as<bool>() && layername == "back")) {
+      leveller.emplace(options, &ocodes, &globalVars,
+                       xoffset, yoffset, tileInfo);
     }
+
+    std::stringstream option_name;
+    option_name << layername << "-output";
+    string of_name = build_filename(outputdir, options[option_name.str()].as<string>());
+    write_layer(board->get_layer(layername), queue, of_name, leveller);
+    // Print the whole message at once so that it isn't interleaved
+    // with output from other threads.
+    std::stringstream message;
+    message << "Exporting " << layername << "... "
+            << "DONE." << " (Height: " << board->get_height() * cfactor
+            << (bMetricoutput ? "mm" : "in") << " Width: "
+            << board->get_width() * cfactor << (bMetricoutput ? "mm" : "in")
+            << ")";
+    if (layername == "outline")
+        message << " The board should be cut from the " << ( workSide(options, "cut") ? "FRONT" : "BACK" ) << " side. ";
+    cout << message.str() << endl;
 }
 
 /* Assume that we start at a safe height above the first point in path.  Cut
@@ -135,7 +233,7 @@ void NGC_Exporter::export_all(boost::program_options::variables_map& options)
  * by where the bridges begins.  So the bridges is from points with indecies x
  * to x+1 for each element in the bridges vector.  We can always assume that the
  * bridge segment and the segments on either side form a straight line. */
-void NGC_Exporter::cutter_milling(std::ofstream& of, shared_ptr<Cutter> cutter, const linestring_type_fp& path,
+void NGC_Exporter::cutter_milling(GcodeWriter& of, shared_ptr<Cutter> cutter, const linestring_type_fp& path,
                                   const vector<size_t>& bridges, const double xoffsetTot, const double yoffsetTot) {
   const unsigned int steps_num = cutter->stepsize == 0 ?
                                  1 :
@@ -185,7 +283,7 @@ void NGC_Exporter::cutter_milling(std::ofstream& of, shared_ptr<Cutter> cutter,
   }
 }
 
-void NGC_Exporter::isolation_milling(std::ofstream& of, shared_ptr<RoutingMill> mill, const linestring_type_fp& path,
+void NGC_Exporter::isolation_milling(GcodeWriter& of, shared_ptr<RoutingMill> mill, const linestring_type_fp& path,
                                      boost::optional<autoleveller>& leveller, const double xoffsetTot, const double yoffsetTot) {
   of << "G01 F" << mill->vertfeed * cfactor << '\n';
 
@@ -215,9 +313,9 @@ void NGC_Exporter::isolation_milling(std::ofstream& of, shared_ptr<RoutingMill>
     if (leveller) {
       leveller->setLastChainPoint(point_type_fp((path.begin()->x() - xoffsetTot) * cfactor,
                                                 (path.begin()->y() - yoffsetTot) * cfactor));
-      of << leveller->g01Corrected(point_type_fp((path.begin()->x() - xoffsetTot) * cfactor,
-                                                 (path.begin()->y() - yoffsetTot) * cfactor),
-                                   z * cfactor);
+      leveller->g01Corrected(of, point_type_fp((path.begin()->x() - xoffsetTot) * cfactor,
+                                               (path.begin()->y() - yoffsetTot) * cfactor),
+                             z * cfactor);
     } else {
       of << "G01 Z" << z * cfactor << "\n";
     }
@@ -225,9 +323,9 @@ void NGC_Exporter::isolation_milling(std::ofstream& of, shared_ptr<RoutingMill>
     of << "G01 F" << mill->feed * cfactor << '\n';
     while (iter != path.cend()) {
       if (leveller) {
-        of << leveller->addChainPoint(point_type_fp((iter->x() - xoffsetTot) * cfactor,
-                                                    (iter->y() - yoffsetTot) * cfactor),
-                                      z * cfactor);
+        leveller->addChainPoint(of, point_type_fp((iter->x() - xoffsetTot) * cfactor,
+                                                  (iter->y() - yoffsetTot) * cfactor),
+                                z * cfactor);
       } else {
         of << "G01 X" << (iter->x() - xoffsetTot) * cfactor << " Y"
            << (iter->y() - yoffsetTot) * cfactor << '\n';
@@ -243,12 +341,14 @@ void NGC_Exporter::isolation_milling(std::ofstream& of, shared_ptr<RoutingMill>
 }
 
 
-void NGC_Exporter::export_layer(shared_ptr<Layer> layer, string of_name, boost::optional<autoleveller> leveller) {
+void NGC_Exporter::write_layer(shared_ptr<Layer> layer,
+                               ToolpathQueue& queue,
+                               string of_name, boost::optional<autoleveller> leveller) {
     string layername = layer->get_name();
     shared_ptr<RoutingMill> mill = layer->get_manufacturer();
-    vector<pair<coordinate_type_fp, multi_linestring_type_fp>> all_toolpaths = layer->get_toolpaths();
+    const size_t tool_count = queue.tool_count();
 
-    if (all_toolpaths.size() < 1) {
+    if (tool_count < 1) {
       return; // Nothing to do.
     }
 
@@ -270,7 +370,7 @@ void NGC_Exporter::export_layer(shared_ptr<Layer> layer, string of_name, boost::
         of << "( " << s << " )\n";
     }
 
-    if( leveller || ( tileInfo.enabled && tileInfo.software != Software::CUSTOM ) )
+    if( ( leveller && !leveller->heightmap ) || ( tileInfo.enabled && tileInfo.software != Software::CUSTOM ) )
         of << "( Gcode for " << tileInfo.software << " )\n";
     else
         of << "( Software-independent Gcode )\n";
@@ -298,30 +398,31 @@ void NGC_Exporter::export_layer(shared_ptr<Layer> layer, string of_name, boost::
     of << "G01 F" << mill->feed * cfactor << " ( Feedrate. )\n\n";
 
     if (leveller) {
-      leveller->prepareWorkarea(all_toolpaths);
+      if (!leveller->heightmap) {
+        // The probing covers all the tools so they must all be found
+        // before any is written.
+        const auto& tools = queue.wait_all();
+        vector<pair<coordinate_type_fp, multi_linestring_type_fp>> all_toolpaths;
+        for (const auto& tool : tools) {
+          all_toolpaths.push_back(make_pair(tool.diameter, tool.paths));
+        }
+        leveller->prepareWorkarea(all_toolpaths);
+      }
       leveller->header(of);
     }
 
     shared_ptr<Cutter> cutter = dynamic_pointer_cast<Cutter>(mill);
     shared_ptr<Isolator> isolator = dynamic_pointer_cast<Isolator>(mill);
 
-    // One list of bridges for each path.
-    vector<vector<size_t>> all_bridges;
-    if (cutter) {
-      for (auto& path : all_toolpaths[0].second) {  // Cutter layer can only have one tool_diameter.
-        auto bridges = layer->get_bridges(path);
-        all_bridges.push_back(bridges);
-      }
-    }
-
     uniqueCodes main_sub_ocodes(200);
-    for (size_t toolpaths_index = 0; toolpaths_index < all_toolpaths.size(); toolpaths_index++) {
-      const auto& toolpaths = all_toolpaths[toolpaths_index].second;
+    for (size_t toolpaths_index = 0; toolpaths_index < tool_count; toolpaths_index++) {
+      const ToolpathQueue::Tool tool = queue.pop();
+      const auto& toolpaths = tool.paths;
       if (toolpaths.size() < 1) {
         continue; // Nothing to do for this mill size.
       }
       Tiling tiling(tileInfo, cfactor, main_sub_ocodes.getUniqueCode());
-      if (toolpaths_index == all_toolpaths.size() - 1) {
+      if (toolpaths_index == tool_count - 1) {
         tiling.setGCodeEnd(string("\nG04 P0 ( dwell for no time -- G64 should not smooth over this point )\n")
                            + (bZchangeG53 ? "G53 " : "") + "G00 Z" + str( format("%.6f") % ( mill->zchange * cfactor ) ) +
                            " ( retract )\n\n" + postamble + "M5 ( Spindle off. )\nG04 P" +
@@ -341,7 +442,7 @@ void NGC_Exporter::export_layer(shared_ptr<Layer> layer, string of_name, boost::
       } else {
         throw std::logic_error("Can't cast to Cutter nor Isolator.");
       }
-      const auto& tool_diameter = all_toolpaths[toolpaths_index].first;
+      const auto& tool_diameter = tool.diameter;
       if (bMetricoutput) {
         of << (tool_diameter * 25.4) << "mm)" << endl;
       } else {
@@ -352,15 +453,29 @@ void NGC_Exporter::export_layer(shared_ptr<Layer> layer, string of_name, boost::
          << "M3 ( Spindle on clockwise. )" << endl
          << "G04 P" << mill->spinup_time << " (Wait for spindle to get up to speed)" << endl;
 
+      // The toolpaths are the same in each tile so the rapids between
+      // tiles only depend on where the first one starts and the last one
+      // ends.
+      const auto first = std::find_if(toolpaths.cbegin(), toolpaths.cend(),
+                                      [](const linestring_type_fp& path) { return !path.empty(); });
+      const auto last = std::find_if(toolpaths.crbegin(), toolpaths.crend(),
+                                     [](const linestring_type_fp& path) { return !path.empty(); });
+      if (first != toolpaths.cend()) {
+        tiling.optimiseOrder(first->front(), last->back());
+      }
       tiling.header( of );
 
-      for( unsigned int i = 0; i < tileInfo.forYNum; i++ ) {
-        double yoffsetTot = yoffset - i * tileInfo.boardHeight;
-        for( unsigned int j = 0; j < tileInfo.forXNum; j++ ) {
-          double xoffsetTot = xoffset - ( i % 2 ? tileInfo.forXNum - j - 1 : j ) * tileInfo.boardWidth;
+      // Most of the output is the paths so it goes through a
+      // GcodeWriter, which is faster and can make it compact.
+      GcodeWriter writer(of, compact_gcode);
+      for( unsigned int i = 0; i < tiling.lines(); i++ ) {
+        for( unsigned int j = 0; j < tiling.steps(); j++ ) {
+          const auto tile = tiling.tile( i, j );
+          double xoffsetTot = xoffset - tile.first * tileInfo.boardWidth;
+          double yoffsetTot = yoffset - tile.second * tileInfo.boardHeight;
 
           if( tileInfo.enabled && tileInfo.software == Software::CUSTOM )
-            of << "( Piece #" << j + 1 + i * tileInfo.forXNum << ", position [" << j << ";" << i << "] )\n\n";
+            writer << "( Piece #" << j + 1 + i * tiling.steps() << ", position [" << tile.first << ";" << tile.second << "] )\n\n";
 
           // contours
           for(size_t path_index = 0; path_index < toolpaths.size(); path_index++) {
@@ -370,22 +485,23 @@ void NGC_Exporter::export_layer(shared_ptr<Layer> layer, string of_name, boost::
             }
 
             // retract, move to the starting point of the next contour
-            of << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
-            of << "G00 Z" << mill->zsafe * cfactor << " ( retract )" << endl << endl;
-            of << "G00 X" << ( path.begin()->x() - xoffsetTot ) * cfactor << " Y"
-               << ( path.begin()->y() - yoffsetTot ) * cfactor << " ( rapid move to begin. )\n";
+            writer << "G04 P0 ( dwell for no time -- G64 should not smooth over this point )\n";
+            writer << "G00 Z" << mill->zsafe * cfactor << " ( retract )\n\n";
+            writer << "G00 X" << ( path.begin()->x() - xoffsetTot ) * cfactor << " Y"
+                   << ( path.begin()->y() - yoffsetTot ) * cfactor << " ( rapid move to begin. )\n";
 
             /* if we're cutting, perhaps do it in multiple steps, but do isolations just once.
              * i know this is partially repetitive, but this way it's easier to read
              */
             if (cutter) {
-              cutter_milling(of, cutter, path, all_bridges[path_index], xoffsetTot, yoffsetTot);
+              cutter_milling(writer, cutter, path, tool.bridges[path_index], xoffsetTot, yoffsetTot);
             } else {
-              isolation_milling(of, mill, path, leveller, xoffsetTot, yoffsetTot);
+              isolation_milling(writer, mill, path, leveller, xoffsetTot, yoffsetTot);
             }
           }
         }
       }
+      writer.flush();
 
       tiling.footer( of );
     }
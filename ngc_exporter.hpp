@@ -27,6 +27,8 @@
 #include <string>
 #include <fstream>
 #include <memory>
+#include <thread>
+#include <exception>
 
 #include <boost/program_options.hpp>
 
@@ -36,6 +38,10 @@
 #include "autoleveller.hpp"
 #include "common.hpp"
 #include "board.hpp"
+#include "task_graph.hpp"
+#include "gcode_writer.hpp"
+#include "toolpath_file.hpp"
+#include "toolpath_queue.hpp"
 
 /******************************************************************************/
 /*
@@ -44,16 +50,24 @@
 class NGC_Exporter: private boost::noncopyable {
 public:
     NGC_Exporter(std::shared_ptr<Board> board);
+    ~NGC_Exporter();
     void add_header(std::string);
-    void export_all(boost::program_options::variables_map&);
+    // Adds the tasks for exporting all the layers and starts the thread
+    // that writes them.  The exporter must outlive the tasks.
+    void export_all(boost::program_options::variables_map&, TaskGraph& tasks);
     void set_preamble(std::string);
     void set_postamble(std::string);
 
 protected:
-  void export_layer(std::shared_ptr<Layer> layer, std::string of_name, boost::optional<autoleveller> leveller);
-  void cutter_milling(std::ofstream& of, std::shared_ptr<Cutter> cutter, const linestring_type_fp& path,
+  void export_layer(boost::program_options::variables_map& options,
+                    const std::string& outputdir, const std::string& layername,
+                    ToolpathQueue& queue);
+  void write_layer(std::shared_ptr<Layer> layer,
+                   ToolpathQueue& queue,
+                   std::string of_name, boost::optional<autoleveller> leveller);
+  void cutter_milling(GcodeWriter& of, std::shared_ptr<Cutter> cutter, const linestring_type_fp& path,
                       const std::vector<size_t>& bridges, const double xoffsetTot, const double yoffsetTot);
-  void isolation_milling(std::ofstream& of, std::shared_ptr<RoutingMill> mill, const linestring_type_fp& path,
+  void isolation_milling(GcodeWriter& of, std::shared_ptr<RoutingMill> mill, const linestring_type_fp& path,
                          boost::optional<autoleveller>& leveller, const double xoffsetTot, const double yoffsetTot);
 
     std::shared_ptr<Board> board;
@@ -66,6 +80,7 @@ protected:
     bool bMetricoutput;     //if true, metric g-code output
     bool bZchangeG53;
     bool nom6; // missing m6
+    bool compact_gcode; // leave out what doesn't change from line to line
 
     bool bTile;
 
@@ -78,6 +93,12 @@ protected:
     
     uniqueCodes ocodes;
     uniqueCodes globalVars;
+
+    // One for each layer, from the tasks that find the toolpaths to the
+    // thread that writes them.
+    std::vector<std::shared_ptr<ToolpathQueue>> queues;
+    std::thread export_thread;
+    std::exception_ptr export_exception;
 };
 
 #endif // NGCEXPORTER_H
@@ -229,6 +229,8 @@ options::options()
        ("nog91-1", po::value<bool>()->default_value(false)->implicit_value(true), "do not explicitly set G91.1 in drill headers")
        ("nog81", po::value<bool>()->default_value(false)->implicit_value(true), "replace G81 with G0+G1")
        ("nom6", po::value<bool>()->default_value(false)->implicit_value(true), "do not emit M6 on tool changes")
+       ("drill-arrays", po::value<bool>()->default_value(false)->implicit_value(true), "drill rows and grids of evenly spaced holes with a loop in a subroutine instead of a line for each hole, for smaller files.  Needs software linuxcnc, mach3 or mach4")
+       ("optimise-drill-order", po::value<bool>()->default_value(false)->implicit_value(true), "find the path through the holes of each bit size starting from where the bit before it finished, instead of from the origin")
        ("milldrill-output", po::value<string>()->default_value("milldrill.ngc"), "output file for milldrilling");
    cfg_options.add(drilling_options);
 
@@ -293,9 +295,16 @@ options::options()
        ("vectorial", po::value<bool>()->default_value(true)->implicit_value(true), "enable or disable the vectorial rendering engine")
        ("tsp-2opt", po::value<bool>()->default_value(true)->implicit_value(true), "use TSP 2OPT to find a faster toolpath (but slows down gcode generation)")
        ("path-finding-limit", po::value<size_t>()->default_value(1), "Use path finding for up to this many steps in the search (more is slower but makes a faster gcode path)")
+       ("path-finding-time-limit", po::value<Time>(), "limit the time that the front and back layers each spend on path finding between the paths of different traces, giving the shortest connections the most time first.  Searches that run out of time are counted in a warning.  It only makes a difference if --path-finding-limit is more than its default of 1, which makes each search try only a straight line")
        ("g0-vertical-speed", po::value<Velocity>()->default_value(parse_unit<Velocity>("50in/min")), "speed of vertical G0 movements, for use in path-finding")
        ("g0-horizontal-speed", po::value<Velocity>()->default_value(parse_unit<Velocity>("100in/min")), "speed of horizontal G0 movements, for use in path-finding")
-       ("backtrack", po::value<Velocity>()->default_value(std::numeric_limits<double>::infinity()), "allow retracing a milled path if it's faster than retract-move-lower.  For example, set to 5in/s if you are willing to remill 5 inches of trace in order to save 1 second of milling time.");
+       ("backtrack", po::value<Velocity>()->default_value(std::numeric_limits<double>::infinity()), "allow retracing a milled path if it's faster than retract-move-lower.  For example, set to 5in/s if you are willing to remill 5 inches of trace in order to save 1 second of milling time.")
+       ("jobs", po::value<unsigned int>()->default_value(1), "process up to this many layers and the drill file at the same time, 0 for one per processor core.  The work in each of them is also spread over this many threads, except for the front and back when both are milled and for the drill file when there are layers, which use one thread each.  The output is the same for any number of jobs")
+       ("voronoi-tile-size", po::value<Length>()->default_value(Length(0)), "make the voronoi regions in square tiles of this size instead of all at once, so that very large boards need less memory and the tiles can be made on many threads.  Inside the board, the regions have the same edges as without tiles but curved edges might be sampled at other points, up to --tolerance away.  Tiles whose traces are far apart are made one at a time.  0 to disable")
+       ("front-simplify", po::value<Length>()->default_value(Length(0)), "simplify the front layer right after importing it so that every point stays within this distance and no traces touch that didn't before.  Everything after works on fewer points.  0 to just use --optimise")
+       ("back-simplify", po::value<Length>()->default_value(Length(0)), "the same as --front-simplify but for the back layer")
+       ("outline-simplify", po::value<Length>()->default_value(Length(0)), "the same as --front-simplify but for the outline")
+       ("cache-dir", po::value<string>()->default_value(""), "save the voronoi regions of each layer in this directory and use them again on later runs with the same traces, so that changing just the tools or the feeds is faster.  The directory must exist.  Empty to disable");
    cfg_options.add(optimization_options);
 
    po::options_description autolevelling_options("Autolevelling options, for generating gcode to automatically probe the board and adjust milling depth to the actual board height");
@@ -314,7 +323,9 @@ options::options()
         "execute this commands to disable the probe tool (default is M0)")
        ("al-probecode", po::value<string>()->default_value("G31"), "custom probe code (default is G31)")
        ("al-probevar", po::value<unsigned int>()->default_value(2002), "number of the variable where the result of the probing is saved (default is 2002)")
-       ("al-setzzero", po::value<string>()->default_value("G92 Z0"), "gcode for setting the actual position as zero (default is G92 Z0)");
+       ("al-setzzero", po::value<string>()->default_value("G92 Z0"), "gcode for setting the actual position as zero (default is G92 Z0)")
+       ("al-heightmap", po::value<string>()->default_value(""), "instead of probing, correct Z with the heights in this file, one probe on each line as x y z like the probe log of LinuxCNC.  The probes must be on a grid and in the work coordinates and units of the output")
+       ("al-heightmap-tolerance", po::value<Length>()->default_value(parse_unit<Length>("0.0001in")), "with al-heightmap, split the moves so that the milling depth is never off by more than this");
    cfg_options.add(autolevelling_options);
 
    po::options_description alignment_options("Alignment options, useful for aligning the milling on opposite sides of the PCB");
@@ -336,12 +347,14 @@ options::options()
        ("zchange", po::value<Length>(), "tool changing height")
        ("zchange-absolute", po::value<bool>()->default_value(false)->implicit_value(true), "use zchange as a machine coordinates height (G53)")
        ("tile-x", po::value<int>()->default_value(1), "number of tiling columns. Default value is 1")
-       ("tile-y", po::value<int>()->default_value(1), "number of tiling rows. Default value is 1");
+       ("tile-y", po::value<int>()->default_value(1), "number of tiling rows. Default value is 1")
+       ("optimise-tile-order", po::value<bool>()->default_value(false)->implicit_value(true), "go through the tiles column by column instead of row by row if that makes the rapid moves between the tiles shorter");
    cfg_options.add(cnc_options);
 
    cfg_options.add_options()
        ("ignore-warnings", po::value<bool>()->default_value(false)->implicit_value(true), "Ignore warnings")
        ("svg", po::value<string>(), "[DEPRECATED] use --vectorial, SVGs will be generated automatically; this option has no effect")
+       ("svg-resolution", po::value<Length>()->default_value(0), "simplify the shapes in the SVG images to this resolution, making them smaller and faster to write.  0 keeps every point")
        ("metric", po::value<bool>()->default_value(false)->implicit_value(true), "use metric units for parameters. does not affect gcode output")
        ("metricoutput", po::value<bool>()->default_value(false)->implicit_value(true), "use metric units for output")
        ("g64", po::value<double>(), "[DEPRECATED, use tolerance instead] maximum deviation from toolpath, overrides internal calculation")
@@ -352,7 +365,10 @@ options::options()
        ("preamble-text", po::value<string>(), "preamble text file, inserted at the very beginning as a comment.")
        ("preamble", po::value<string>(), "gcode preamble file, inserted at the very beginning.")
        ("postamble", po::value<string>(), "gcode postamble file, inserted before M9 and M2.")
-       ("no-export", po::value<bool>()->default_value(false)->implicit_value(true), "skip the exporting process");
+       ("no-export", po::value<bool>()->default_value(false)->implicit_value(true), "skip the exporting process")
+       ("compact-gcode", po::value<bool>()->default_value(false)->implicit_value(true), "make the milling paths and drill holes shorter by leaving out comments, spaces, extra zeros and the G0/G1, axes and feeds that are the same as on the line before.  Good for slow serial links")
+       ("save-toolpaths", po::value<string>()->default_value(""), "save the toolpaths of all the layers to this file so that --from-toolpaths can make the G-code again without finding them.  Empty to disable")
+       ("from-toolpaths", po::value<string>()->default_value(""), "read the toolpaths of the layers from this file, made by --save-toolpaths, instead of from the gerber files, which aren't read.  The layers must still be given, with their feeds, heights and other options that don't change the toolpaths.  The tools, the sides of the layers and the mirror options must be the same as when the file was saved.  The bridges are the ones saved.  Empty to disable");
 }
 
 /******************************************************************************/
@@ -376,6 +392,29 @@ static void check_generic_parameters(po::variables_map const& vm)
       options::maybe_throw("spindown-time can't be negative!", ERR_NEGATIVESPINDOWN);
     }
 
+    //---------------------------------------------------------------------------
+    //Check path-finding-time-limit parameter:
+
+    if (vm.count("path-finding-time-limit") && vm["path-finding-time-limit"].as<Time>().asSecond(1) < 0) {
+      options::maybe_throw("path-finding-time-limit can't be negative!", ERR_NEGATIVEPATHFINDINGTIMELIMIT);
+    }
+
+    //---------------------------------------------------------------------------
+    //Check voronoi-tile-size parameter:
+
+    if (vm["voronoi-tile-size"].as<Length>().asInch(unit) < 0) {
+      options::maybe_throw("voronoi-tile-size can't be negative!", ERR_NEGATIVEVORONOITILESIZE);
+    }
+
+    //---------------------------------------------------------------------------
+    //Check simplify parameters:
+
+    for (const string layer : {"front", "back", "outline"}) {
+      if (vm[layer + "-simplify"].as<Length>().asInch(unit) < 0) {
+        options::maybe_throw(layer + "-simplify can't be negative!", ERR_NEGATIVESIMPLIFY);
+      }
+    }
+
     //---------------------------------------------------------------------------
     //Check g64 parameter:
 
@@ -456,7 +495,19 @@ static void check_generic_parameters(po::variables_map const& vm)
     //---------------------------------------------------------------------------
     //Check for autoleveller parameters
 
-    if (vm["al-front"].as<bool>() || vm["al-back"].as<bool>())
+    if ((vm["al-front"].as<bool>() || vm["al-back"].as<bool>()) && !vm["al-heightmap"].as<string>().empty())
+    {
+        if (vm["al-heightmap-tolerance"].as<Length>().asInch(unit) <= 0) {
+          options::maybe_throw("Error: al-heightmap-tolerance <= 0!", ERR_NEGATIVEALHEIGHTMAPTOLERANCE);
+        }
+        // The tiles are only written out one by one for custom, otherwise
+        // they all run the same code.
+        if ((vm["tile-x"].as<int>() > 1 || vm["tile-y"].as<int>() > 1) &&
+            vm.count("software") && vm["software"].as<Software::Software>() != Software::CUSTOM) {
+          options::maybe_throw("Error: al-heightmap with tiling needs software=custom.", ERR_INVALIDPARAMETER);
+        }
+    }
+    else if (vm["al-front"].as<bool>() || vm["al-back"].as<bool>())
     {
         if (!vm.count("software")) {
           options::maybe_throw("Error: unspecified or unsupported software, please specify a supported software (linuxcnc, mach3, mach4 or custom).", ERR_NOSOFTWARE);
@@ -480,6 +531,13 @@ static void check_generic_parameters(po::variables_map const& vm)
           options::maybe_throw("Error: al-probefeed < 0!", ERR_NEGATIVEPROBEFEED);
         }
     }
+    //---------------------------------------------------------------------------
+    //Check save-toolpaths parameter:
+
+    if (!vm["save-toolpaths"].as<string>().empty() && vm["no-export"].as<bool>()) {
+      options::maybe_throw("Error: --save-toolpaths needs the toolpaths, which aren't made with --no-export.", ERR_INVALIDPARAMETER);
+    }
+
     if (vm["mill-feed-direction"].as<MillFeedDirection::MillFeedDirection>() != MillFeedDirection::ANY &&
         vm["tsp-2opt"].as<bool>()) {
       options::maybe_throw("Error: Can't use tsp-2opt together with mill-feed-direction", ERR_INVALIDPARAMETER);
@@ -595,6 +653,11 @@ static void check_drilling_parameters(po::variables_map const& vm)
             options::maybe_throw("You can't specify both drill-front and drill-side!", ERR_BOTHDRILLFRONTSIDE);
           }
         }
+
+        if (vm["drill-arrays"].as<bool>() &&
+            (!vm.count("software") || vm["software"].as<Software::Software>() == Software::CUSTOM)) {
+          options::maybe_throw("Error: --drill-arrays needs software linuxcnc, mach3 or mach4.", ERR_INVALIDPARAMETER);
+        }
     }
 
 }
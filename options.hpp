@@ -88,6 +88,10 @@ enum ErrorCodes {
     ERR_NEGATIVESPINDOWN = 53,
     ERR_FALSEMIRRORABSOLUTE = 54,
     ERR_LOWMILLINFEED = 55,
+    ERR_NEGATIVEPATHFINDINGTIMELIMIT = 56,
+    ERR_NEGATIVEVORONOITILESIZE = 57,
+    ERR_NEGATIVESIMPLIFY = 58,
+    ERR_NEGATIVEALHEIGHTMAPTOLERANCE = 59,
     ERR_INVALIDPARAMETER = 100,
     ERR_UNKNOWNPARAMETER = 101
 };
@@ -4,11 +4,10 @@ using std::vector;
 #include <unordered_map>
 using std::unordered_map;
 
-#include <unordered_set>
-using std::unordered_set;
-
-#include <queue>
-using std::priority_queue;
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
 
 #include <utility>
 using std::pair;
@@ -144,7 +143,9 @@ vector<vector<std::reference_wrapper<const ring_type_fp>>> get_all_rings(
 
 PathFindingSurface::PathFindingSurface(const optional<multi_polygon_type_fp>& keep_in,
                                        const multi_polygon_type_fp& keep_out,
-                                       const coordinate_type_fp tolerance) {
+                                       const coordinate_type_fp tolerance) :
+    tries_until_clock_check(0),
+    deadline_passed(false) {
   if (keep_in) {
     multi_polygon_type_fp total_keep_in = *keep_in - keep_out;
 
@@ -356,6 +357,9 @@ const boost::optional<SearchKey>& PathFindingSurface::in_surface(point_type_fp p
   return point_in_surface_memo.emplace(p, ring_indices_cache.size()-1).first->second;
 }
 
+// Reading the clock is slower than a try so only do it every so often.
+static constexpr size_t tries_per_clock_check = 64;
+
 void PathFindingSurface::decrement_tries() const {
   if (tries) {
     if (*tries == 0) {
@@ -363,6 +367,20 @@ void PathFindingSurface::decrement_tries() const {
     }
     (*tries)--;
   }
+  if (deadline) {
+    if (tries_until_clock_check == 0) {
+      if (std::chrono::steady_clock::now() > *deadline) {
+        deadline_passed = true;
+        throw GiveUp();
+      }
+      tries_until_clock_check = tries_per_clock_check;
+    }
+    tries_until_clock_check--;
+  }
+}
+
+bool PathFindingSurface::timed_out() const {
+  return deadline_passed;
 }
 
 // Return true if this edge from a to b is part of the path finding surface.
@@ -391,20 +409,101 @@ Neighbors PathFindingSurface::neighbors(const point_type_fp& start, const point_
   return Neighbors(start, goal, current, max_path_length, vertices(search_key), this);
 }
 
+// The state of an A* search, reused between searches so that
+// find_path doesn't need to allocate once the arrays are big enough.
+// Instead of clearing the arrays for each search, entries are stamped
+// with the generation of the search that wrote them and entries from
+// older generations are considered empty.
+class SearchArena {
+ public:
+  struct OpenEntry {
+    coordinate_type_fp f_score;
+    point_type_fp point;
+    size_t id;
+  };
+
+  // Prepare for a new search over size ids.
+  void reset(size_t size) {
+    if (g_score_generation.size() < size) {
+      g_score_generation.resize(size, 0);
+      closed_generation.resize(size, 0);
+      g_score.resize(size);
+      came_from.resize(size);
+    }
+    generation++;
+    if (generation == 0) {
+      // Wrapped around so the old stamps can no longer be trusted.
+      std::fill(g_score_generation.begin(), g_score_generation.end(), 0);
+      std::fill(closed_generation.begin(), closed_generation.end(), 0);
+      generation = 1;
+    }
+    open_set.clear();
+  }
+
+  bool has_g_score(size_t id) const { return g_score_generation[id] == generation; }
+  coordinate_type_fp get_g_score(size_t id) const { return g_score[id]; }
+  void set_g_score(size_t id, coordinate_type_fp score, size_t from) {
+    g_score_generation[id] = generation;
+    g_score[id] = score;
+    came_from[id] = from;
+  }
+  size_t get_came_from(size_t id) const { return came_from[id]; }
+  bool is_closed(size_t id) const { return closed_generation[id] == generation; }
+  void close(size_t id) { closed_generation[id] = generation; }
+
+  // The open set is a binary heap ordered the same way as a
+  // priority_queue of (f_score, point) would be.
+  void push(coordinate_type_fp f_score, const point_type_fp& point, size_t id) {
+    open_set.push_back({f_score, point, id});
+    std::push_heap(open_set.begin(), open_set.end(), greater);
+  }
+  const OpenEntry& top() const { return open_set.front(); }
+  void pop() {
+    std::pop_heap(open_set.begin(), open_set.end(), greater);
+    open_set.pop_back();
+  }
+  bool empty() const { return open_set.empty(); }
+
+  static constexpr size_t no_id = std::numeric_limits<size_t>::max();
+
+ private:
+  static bool greater(const OpenEntry& a, const OpenEntry& b) {
+    return b.f_score < a.f_score || (!(a.f_score < b.f_score) && b.point < a.point);
+  }
+
+  uint32_t generation = 0;
+  vector<uint32_t> g_score_generation;
+  vector<uint32_t> closed_generation;
+  vector<coordinate_type_fp> g_score;
+  vector<size_t> came_from;
+  vector<OpenEntry> open_set;
+};
+
+constexpr size_t SearchArena::no_id;
+
+// One per thread so that a surface can be searched from many threads.
+SearchArena& search_arena() {
+  static thread_local SearchArena arena;
+  return arena;
+}
+
 // Return a path from the start to the current.  Always return at
 // least two points.
+template <typename GetPoint>
 linestring_type_fp build_path(
-    point_type_fp current,
-    const unordered_map<point_type_fp, point_type_fp>& came_from) {
+    size_t current,
+    const SearchArena& arena,
+    const GetPoint& get_point) {
   linestring_type_fp result;
-  while (came_from.count(current)) {
-    result.push_back(current);
-    current = came_from.at(current);
+  while (arena.get_came_from(current) != SearchArena::no_id) {
+    result.push_back(get_point(current));
+    current = arena.get_came_from(current);
   }
-  result.push_back(current);
+  result.push_back(get_point(current));
   bg::reverse(result);
   return result;
 }
+
 optional<linestring_type_fp> PathFindingSurface::find_path(
     const point_type_fp& start, const point_type_fp& goal,
     const coordinate_type_fp& max_path_length,
@@ -426,39 +525,61 @@ optional<linestring_type_fp> PathFindingSurface::find_path(
   } catch (GiveUp g) {
     return boost::none;
   }
-  // Do astar.
-  priority_queue<pair<coordinate_type_fp, point_type_fp>,
-                 vector<pair<coordinate_type_fp, point_type_fp>>,
-                 std::greater<pair<coordinate_type_fp, point_type_fp>>> open_set;
-  open_set.emplace(bg::distance(start, goal), start);
-  unordered_set<point_type_fp> closed_set;
-  unordered_map<point_type_fp, point_type_fp> came_from;
-  unordered_map<point_type_fp, coordinate_type_fp> g_score; // Empty should be considered infinity.
-  g_score[start] = 0;
-  while (!open_set.empty()) {
-    const auto current = open_set.top().second;
-    open_set.pop();
-    if (current == goal) {
+  // Do astar.  Start and goal might already be among the vertices.
+  // If not, they get the next ids.
+  const VertexIds& vertex_ids = this->vertex_ids(search_key);
+  const size_t vertex_count = vertex_ids.points.size();
+  std::array<point_type_fp, 2> extra_points;
+  size_t extra_count = 0;
+  auto get_id = [&](const point_type_fp& p) {
+    auto found = vertex_ids.lookup.find(p);
+    if (found != vertex_ids.lookup.cend()) {
+      return found->second;
+    }
+    extra_points[extra_count] = p;
+    return vertex_count + extra_count++;
+  };
+  const size_t start_id = get_id(start);
+  const size_t goal_id = start == goal ? start_id : get_id(goal);
+  auto get_point = [&](size_t id) -> const point_type_fp& {
+    return id < vertex_count ? vertex_ids.points[id] : extra_points[id - vertex_count];
+  };
+  auto& arena = search_arena();
+  arena.reset(vertex_count + extra_count);
+  arena.push(bg::distance(start, goal), start, start_id);
+  arena.set_g_score(start_id, 0, SearchArena::no_id);
+  while (!arena.empty()) {
+    const auto current = arena.top().point;
+    const auto current_id = arena.top().id;
+    arena.pop();
+    if (current_id == goal_id) {
       // We're done.
-      return boost::make_optional(build_path(current, came_from));
+      return boost::make_optional(build_path(current_id, arena, get_point));
     }
-    if (closed_set.count(current) > 0) {
+    if (arena.is_closed(current_id)) {
       // Skip this because we already "removed it", sort of.
       continue;
     }
     try {
+      const auto current_g_score = arena.get_g_score(current_id);
       const auto current_neighbors = neighbors(
           start, goal,
-          max_path_length - g_score.at(current),
+          max_path_length - current_g_score,
           search_key,
           current);
-      for (const auto& neighbor : current_neighbors) {
-        const auto tentative_g_score = g_score.at(current) + bg::distance(current, neighbor);
-        if (g_score.count(neighbor) == 0 || tentative_g_score < g_score.at(neighbor)) {
+      for (auto neighbor_iterator = current_neighbors.begin();
+           neighbor_iterator != current_neighbors.end();
+           ++neighbor_iterator) {
+        const auto& neighbor = *neighbor_iterator;
+        const auto position = neighbor_iterator.position();
+        const size_t neighbor_id = position == 0 ? start_id :
+                                   position == 1 ? goal_id :
+                                   vertex_ids.ids[position - 2];
+        const auto tentative_g_score = current_g_score + bg::distance(current, neighbor);
+        if (!arena.has_g_score(neighbor_id) || tentative_g_score < arena.get_g_score(neighbor_id)) {
           // This path to neighbor is better than any previous one.
-          came_from[neighbor] = current;
-          g_score[neighbor] = tentative_g_score;
-          open_set.emplace(tentative_g_score + bg::distance(neighbor, goal), neighbor);
+          arena.set_g_score(neighbor_id, tentative_g_score, current_id);
+          arena.push(tentative_g_score + bg::distance(neighbor, goal), neighbor, neighbor_id);
         }
       }
     } catch (GiveUp g) {
@@ -466,7 +587,7 @@ optional<linestring_type_fp> PathFindingSurface::find_path(
     }
     // Because we can't delete from the open_set, we'll just marked
     // items as closed and ignore them later.
-    closed_set.insert(current);
+    arena.close(current_id);
   }
   return boost::none;
 }
@@ -475,7 +596,9 @@ optional<linestring_type_fp> PathFindingSurface::find_path(
     const point_type_fp& start, const point_type_fp& goal,
     const coordinate_type_fp& max_path_length,
     const boost::optional<size_t>& max_tries,
-    SearchKey search_key) const {
+    SearchKey search_key,
+    const boost::optional<Deadline>& deadline) const {
+  deadline_passed = false;
   if (max_tries) {
     if (*max_tries == 0) {
       return boost::none;
@@ -484,6 +607,8 @@ optional<linestring_type_fp> PathFindingSurface::find_path(
   } else {
     tries = boost::none;
   }
+  this->deadline = deadline;
+  tries_until_clock_check = 0;
   return find_path(start, goal, max_path_length, search_key);
 }
 
@@ -491,6 +616,8 @@ optional<linestring_type_fp> PathFindingSurface::find_path(
     const point_type_fp& start, const point_type_fp& goal,
     const coordinate_type_fp& max_path_length,
     const boost::optional<size_t>& max_tries) const {
+  deadline_passed = false;
+  deadline = boost::none;
   if (max_tries) {
     if (*max_tries == 0) {
       return boost::none;
@@ -535,4 +662,45 @@ PathFindingSurface::vertices(SearchKey search_key) const {
   return vertices_memo.emplace(search_key, ret).first->second;
 }
 
+const PathFindingSurface::VertexIds&
+PathFindingSurface::vertex_ids(SearchKey search_key) const {
+  auto memoized_result = vertex_ids_memo.find(search_key);
+  if (memoized_result != vertex_ids_memo.cend()) {
+    return memoized_result->second;
+  }
+  VertexIds ret;
+  for (const auto& vertex : vertices(search_key)) {
+    auto inserted = ret.lookup.emplace(vertex, ret.points.size());
+    if (inserted.second) {
+      ret.points.push_back(vertex);
+    }
+    ret.ids.push_back(inserted.first->second);
+  }
+  return vertex_ids_memo.emplace(search_key, std::move(ret)).first->second;
+}
+
+// The fraction of the remaining budget that a single search may use.
+static constexpr double search_budget_fraction = 1.0/8;
+
+SearchBudget::SearchBudget(double seconds) :
+    remaining(seconds),
+    cut_short_count(0),
+    skipped_count(0) {}
+
+boost::optional<Deadline> SearchBudget::start_search() {
+  if (used_up()) {
+    return boost::none;
+  }
+  search_start = std::chrono::steady_clock::now();
+  return search_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      remaining * search_budget_fraction);
+}
+
+void SearchBudget::end_search(bool timed_out) {
+  remaining -= std::chrono::steady_clock::now() - search_start;
+  if (timed_out) {
+    cut_short_count++;
+  }
+}
+
 } //namespace path_finding
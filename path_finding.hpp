@@ -2,6 +2,7 @@
 #define PATH_FINDING_H
 
 #include <boost/optional.hpp>
+#include <chrono>
 #include <unordered_map>
 
 #include "geometry.hpp"
@@ -126,6 +127,7 @@ using nested_multipolygon_type_fp = std::vector<nested_polygon_type_fp>;
 using MPRingIndices = std::vector<std::pair<size_t, std::vector<size_t>>>;
 using RingIndices = std::vector<std::pair<size_t, std::vector<std::pair<size_t, MPRingIndices>>>>;
 using SearchKey = size_t;
+using Deadline = std::chrono::steady_clock::time_point;
 boost::optional<MPRingIndices> inside_multipolygon(const point_type_fp& p,
                                   const multi_polygon_type_fp& mp);
 boost::optional<MPRingIndices> outside_multipolygon(const point_type_fp& p,
@@ -148,6 +150,9 @@ class Neighbors {
     bool operator!=(const iterator& other) const;
     bool operator==(const iterator& other) const;
     const point_type_fp& operator*() const;
+    // 0 is start, 1 is goal, and the rest are offset by 2 into the
+    // vertices.
+    size_t position() const { return point_index; }
    private:
     const Neighbors* neighbors;
     size_t point_index;
@@ -193,15 +198,30 @@ class PathFindingSurface {
       const coordinate_type_fp& max_path_length,
       const boost::optional<size_t>& max_tries) const;
   // Find a path from start to goal in the available surface, limited
-  // in operations.
+  // in operations and, optionally, in time.
   boost::optional<linestring_type_fp> find_path(
       const point_type_fp& start, const point_type_fp& goal,
       const coordinate_type_fp& max_path_length,
       const boost::optional<size_t>& max_tries,
-      SearchKey search_key) const;
+      SearchKey search_key,
+      const boost::optional<Deadline>& deadline = boost::none) const;
+  // True if the last find_path gave up because the deadline passed.
+  bool timed_out() const;
   const std::vector<point_type_fp>& vertices(SearchKey search_key) const;
   multi_polygon_type_fp get_surface() const;
 
+  // Dense ids for the vertices of a search key so that the search can
+  // keep its state in flat arrays instead of maps keyed by point.
+  // Vertices that are the same point share an id.
+  struct VertexIds {
+    // Same length and order as vertices(search_key).
+    std::vector<size_t> ids;
+    // The point for each id.
+    std::vector<point_type_fp> points;
+    std::unordered_map<point_type_fp, size_t> lookup;
+  };
+  const VertexIds& vertex_ids(SearchKey search_key) const;
+
  private:
   friend class Neighbors;
   bool in_surface(
@@ -231,7 +251,41 @@ class PathFindingSurface {
   mutable std::unordered_map<point_type_fp, boost::optional<SearchKey>> point_in_surface_memo;
   segment_tree::SegmentTree tree;
   mutable std::unordered_map<SearchKey, std::vector<point_type_fp>> vertices_memo;
+  mutable std::unordered_map<SearchKey, VertexIds> vertex_ids_memo;
   mutable boost::optional<size_t> tries; // This is not great to be mutable.
+  mutable boost::optional<Deadline> deadline;
+  mutable size_t tries_until_clock_check;
+  mutable bool deadline_passed;
+};
+
+// A time budget shared by all the searches of a layer.  The searches
+// should be requested from the shortest connection to the longest.
+// Each search may use a fixed fraction of the time that remains, so
+// the early, short connections can use the most and whatever they
+// don't use is left for the later ones.
+class SearchBudget {
+ public:
+  explicit SearchBudget(double seconds);
+  // Returns the deadline for the next search, or none if the budget
+  // is used up, in which case the search should be skipped and skip
+  // called.  If a deadline is returned, end_search must be called after
+  // the search.
+  boost::optional<Deadline> start_search();
+  void end_search(bool timed_out);
+  void skip() { skipped_count++; }
+  // Number of searches that were cut short by their deadline.
+  size_t cut_short() const { return cut_short_count; }
+  // Number of connections that weren't searched because the time was
+  // used up.
+  size_t skipped() const { return skipped_count; }
+  // True once all the time is used so no more searches are started.
+  bool used_up() const { return remaining.count() <= 0; }
+
+ private:
+  std::chrono::duration<double> remaining;
+  std::chrono::steady_clock::time_point search_start;
+  size_t cut_short_count;
+  size_t skipped_count;
 };
 
 struct GiveUp {};
@@ -2,6 +2,9 @@
 #include <boost/test/unit_test.hpp>
 
 #include <ostream>
+#include <iostream>
+#include <chrono>
+#include <iomanip>
 #include "geometry.hpp"
 #include "bg_operators.hpp"
 #include "bg_helpers.hpp"
@@ -565,4 +568,109 @@ BOOST_AUTO_TEST_CASE(u_shape_keep_out) {
   BOOST_CHECK_EQUAL(ret, boost::make_optional(expected));
 }
 
+BOOST_AUTO_TEST_CASE(deadline_passed) {
+  multi_polygon_type_fp barbell{{{{0,0}, {0,50}, {40,50}, {40,2}, {60,2},
+                                  {60,50}, {100,50}, {100,0}, {0,0}}}};
+  auto surface = PathFindingSurface(boost::none, barbell, 5);
+  const auto search_key = surface.in_surface({-10,-10});
+  BOOST_REQUIRE(search_key);
+  BOOST_CHECK_EQUAL(surface.find_path({-10,-10}, {110,60}, infinity, boost::none, *search_key,
+                                      std::chrono::steady_clock::now() - std::chrono::seconds(1)),
+                    boost::none);
+  BOOST_CHECK(surface.timed_out());
+  BOOST_CHECK_EQUAL(surface.find_path({-10,-10}, {110,60}, infinity, boost::none, *search_key,
+                                      std::chrono::steady_clock::now() + std::chrono::hours(1)),
+                    linestring_type_fp({{-10,-10},{40,2},{60,50},{110,60}}));
+  BOOST_CHECK(!surface.timed_out());
+}
+
+BOOST_AUTO_TEST_CASE(search_budget) {
+  SearchBudget empty_budget(0);
+  BOOST_CHECK(empty_budget.used_up());
+  BOOST_CHECK(!empty_budget.start_search());
+  // Searches that aren't started aren't cut short.
+  BOOST_CHECK_EQUAL(empty_budget.cut_short(), 0UL);
+  BOOST_CHECK_EQUAL(empty_budget.skipped(), 0UL);
+
+  SearchBudget budget(3600);
+  auto deadline = budget.start_search();
+  BOOST_REQUIRE(deadline);
+  BOOST_CHECK(*deadline > std::chrono::steady_clock::now());
+  BOOST_CHECK(*deadline < std::chrono::steady_clock::now() + std::chrono::seconds(3600));
+  budget.end_search(false);
+  BOOST_CHECK_EQUAL(budget.cut_short(), 0UL);
+  BOOST_REQUIRE(budget.start_search());
+  budget.end_search(true);
+  BOOST_CHECK_EQUAL(budget.cut_short(), 1UL);
+  BOOST_CHECK(!budget.used_up());
+  BOOST_CHECK_EQUAL(budget.skipped(), 0UL);
+}
+
+BOOST_AUTO_TEST_CASE(search_budget_skipped) {
+  // Connections between the two halves of the barbell, searched the way
+  // that the toolpaths are joined.  With no time, none are searched.
+  multi_polygon_type_fp barbell{{{{0,0}, {0,50}, {40,50}, {40,2}, {60,2},
+                                  {60,50}, {100,50}, {100,0}, {0,0}}}};
+  auto surface = PathFindingSurface(boost::none, barbell, 5);
+  const std::vector<std::pair<point_type_fp, point_type_fp>> connections{
+    {{-10,-10}, {110,60}}, {{-10,60}, {110,-10}}, {{50,-10}, {50,60}}};
+  SearchBudget budget(0);
+  size_t found = 0;
+  for (const auto& connection : connections) {
+    const auto search_key = surface.in_surface(connection.first);
+    BOOST_REQUIRE(search_key);
+    const auto deadline = budget.start_search();
+    if (!deadline) {
+      budget.skip();
+      continue;
+    }
+    if (surface.find_path(connection.first, connection.second, infinity, boost::none,
+                          *search_key, *deadline)) {
+      found++;
+    }
+    budget.end_search(surface.timed_out());
+  }
+  BOOST_CHECK_EQUAL(found, 0UL);
+  BOOST_CHECK_EQUAL(budget.cut_short(), 0UL);
+  BOOST_CHECK_EQUAL(budget.skipped(), connections.size());
+}
+
+// Prints searches per second on a grid of obstacles.  The checksum
+// of the found paths should not change when optimizing the search.
+BOOST_AUTO_TEST_CASE(benchmark, *boost::unit_test::disabled()) {
+  multi_polygon_type_fp keep_out;
+  for (int x = 0; x < 8; x++) {
+    for (int y = 0; y < 8; y++) {
+      box_type_fp box{point_type_fp(x*10, y*10), point_type_fp(x*10+6, y*10+6+(x%3))};
+      multi_polygon_type_fp box_mp;
+      bg::convert(box, box_mp);
+      keep_out = keep_out + box_mp;
+    }
+  }
+  auto surface = PathFindingSurface(boost::none, keep_out, 0.1);
+  vector<point_type_fp> points;
+  for (int i = 0; i < 8; i++) {
+    points.emplace_back(i*10-2, i*10+8.5);
+    points.emplace_back(i*10+8, 71-i*10);
+  }
+  size_t searches = 0;
+  double checksum = 0;
+  const auto start_time = std::chrono::steady_clock::now();
+  for (int repeat = 0; repeat < 10; repeat++) {
+    for (const auto& start : points) {
+      for (const auto& goal : points) {
+        auto ret = surface.find_path(start, goal, infinity, boost::make_optional(size_t(100000)));
+        searches++;
+        if (ret) {
+          checksum += bg::length(*ret) + ret->size();
+        }
+      }
+    }
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+  std::cout << searches << " searches in " << elapsed.count() << " seconds, "
+            << searches / elapsed.count() << " searches per second, checksum "
+            << std::setprecision(17) << checksum << std::endl;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,10 +1,14 @@
 #include <vector>
 #include <map>
+#include <set>
+#include <thread>
+#include <cmath>
 
 #include "geometry_int.hpp"
 #include "geometry.hpp"
 #include "bg_operators.hpp"
 #include "merge_near_points.hpp"
+#include "task_graph.hpp"
 #include <boost/polygon/isotropy.hpp>
 #include <boost/polygon/segment_concept.hpp>
 #include <boost/polygon/segment_utils.hpp>
@@ -16,6 +20,9 @@ using std::pair;
 using std::make_pair;
 using std::sort;
 using std::unique;
+using std::set;
+using std::max;
+using std::min;
 
 // For use when we have to convert from float to long and back.
 const double SCALE = 1000000.0;
@@ -54,6 +61,100 @@ vector<pair<linestring_type_fp, bool>> unique(const vector<pair<linestring_type_
   return {ret.cbegin(), ret.cend()};
 }
 
+typedef boost::polygon::line_intersection<coordinate_type> line_intersection;
+typedef boost::polygon::scanline_base<coordinate_type>::half_edge half_edge;
+typedef boost::polygon::scanline_base<coordinate_type>::Point scanline_point;
+
+// With more than one job, the segments are split into tiles with
+// about this many segments in each.
+const size_t SEGMENTS_PER_TILE = 1000;
+
+// The same as boost::polygon::intersect_segments but done on a grid of
+// tiles in parallel.  Each segment is put in every tile that its
+// bounding box touches.  All the points where a segment is split are
+// in its bounding box and in the bounding boxes of the segments that
+// made them, so every tile has all the segments needed to find the
+// points in it.  The points found for each segment in all the tiles
+// are merged and then the segments are split just as
+// intersect_segments would do it so the result is identical.
+static void intersect_segments_tiled(
+    vector<pair<size_t, segment_type_p>>& result,
+    const vector<segment_type_p>& all_segments,
+    size_t tiles_per_side, unsigned int jobs) {
+  vector<pair<half_edge, int>> half_edges;
+  half_edges.reserve(all_segments.size());
+  for (size_t i = 0; i < all_segments.size(); i++) {
+    half_edges.push_back(make_pair(half_edge(all_segments[i].low(), all_segments[i].high()), int(i)));
+  }
+  auto min_x = all_segments.front().low().x();
+  auto max_x = min_x;
+  auto min_y = all_segments.front().low().y();
+  auto max_y = min_y;
+  for (const auto& segment : all_segments) {
+    for (const auto& p : {segment.low(), segment.high()}) {
+      min_x = min(min_x, p.x());
+      max_x = max(max_x, p.x());
+      min_y = min(min_y, p.y());
+      max_y = max(max_y, p.y());
+    }
+  }
+  // The tile of each coordinate must not decrease as the coordinate
+  // increases so that a point in a bounding box is in one of the tiles
+  // that the bounding box touches.
+  const double tile_width = double(max_x - min_x) / tiles_per_side;
+  const double tile_height = double(max_y - min_y) / tiles_per_side;
+  auto tile = [&](coordinate_type c, coordinate_type min_c, double size) {
+    if (size <= 0) {
+      return size_t(0);
+    }
+    return min(size_t((c - min_c) / size), tiles_per_side - 1);
+  };
+  vector<vector<pair<half_edge, int>>> tiles(tiles_per_side * tiles_per_side);
+  vector<vector<size_t>> tile_ids(tiles.size());
+  for (size_t i = 0; i < all_segments.size(); i++) {
+    const auto& low = all_segments[i].low();
+    const auto& high = all_segments[i].high();
+    const auto x0 = tile(min(low.x(), high.x()), min_x, tile_width);
+    const auto x1 = tile(max(low.x(), high.x()), min_x, tile_width);
+    const auto y0 = tile(min(low.y(), high.y()), min_y, tile_height);
+    const auto y1 = tile(max(low.y(), high.y()), min_y, tile_height);
+    for (size_t x = x0; x <= x1; x++) {
+      for (size_t y = y0; y <= y1; y++) {
+        auto& t = tiles[x * tiles_per_side + y];
+        t.push_back(make_pair(half_edges[i].first, int(t.size())));
+        tile_ids[x * tiles_per_side + y].push_back(i);
+      }
+    }
+  }
+  vector<vector<set<scanline_point>>> tile_points(tiles.size());
+  TaskGraph tasks;
+  for (size_t i = 0; i < tiles.size(); i++) {
+    if (tiles[i].size() == 0) {
+      continue;
+    }
+    tasks.add([&, i]() {
+      tile_points[i].resize(tiles[i].size());
+      line_intersection::validate_scan_divide_and_conquer(tile_points[i], tiles[i].begin(), tiles[i].end());
+    });
+  }
+  tasks.run(jobs);
+  vector<set<scanline_point>> intersection_points(all_segments.size());
+  for (size_t i = 0; i < tiles.size(); i++) {
+    for (size_t j = 0; j < tile_points[i].size(); j++) {
+      intersection_points[tile_ids[i][j]].insert(tile_points[i][j].cbegin(), tile_points[i][j].cend());
+    }
+  }
+  vector<pair<half_edge, int>> half_edges_out;
+  half_edges_out.reserve(half_edges.size());
+  line_intersection::segment_intersections(half_edges_out, intersection_points,
+                                           half_edges.begin(), half_edges.end());
+  result.reserve(result.size() + half_edges_out.size());
+  for (const auto& half_edge_out : half_edges_out) {
+    result.push_back(make_pair(size_t(half_edge_out.second),
+                               segment_type_p(half_edge_out.first.first, half_edge_out.first.second)));
+  }
+}
+
 /* Given a multi_linestring, return a new multiline_string where there
  * are no segments that cross any other segments.  Nor are there any T
  * shapes where the end of a linestring butts up against the center of
@@ -64,9 +165,19 @@ vector<pair<linestring_type_fp, bool>> unique(const vector<pair<linestring_type_
  */
 static inline vector<pair<segment_type_p, bool>> segmentize(
     const vector<segment_type_p>& all_segments,
-    const vector<bool>& allow_reversals) {
+    const vector<bool>& allow_reversals,
+    unsigned int jobs) {
   vector<pair<size_t, segment_type_p>> intersected_segment_pairs;
-  boost::polygon::intersect_segments(intersected_segment_pairs, all_segments.cbegin(), all_segments.cend());
+  if (jobs == 0) {
+    jobs = max(std::thread::hardware_concurrency(), 1U);
+  }
+  // A few tiles for each job, unless the tiles would be tiny.
+  const size_t tiles_per_side = std::sqrt(min(size_t(jobs) * 4, all_segments.size() / SEGMENTS_PER_TILE));
+  if (jobs == 1 || tiles_per_side < 2) {
+    boost::polygon::intersect_segments(intersected_segment_pairs, all_segments.cbegin(), all_segments.cend());
+  } else {
+    intersect_segments_tiled(intersected_segment_pairs, all_segments, tiles_per_side, jobs);
+  }
   vector<pair<segment_type_p, bool>> intersected_segments;
   for (const auto& p : intersected_segment_pairs) {
     const auto index_in_input = p.first;
@@ -97,10 +208,10 @@ static inline vector<pair<segment_type_p, bool>> segmentize(
 // into a linestrings that have just two points, the start and the
 // end.  Directionality is maintained on each one along with whether
 // or not it is reversible.
-vector<pair<linestring_type_fp, bool>> segmentize_paths(const vector<pair<linestring_type_fp, bool>>& toolpaths) {
+vector<pair<linestring_type_fp, bool>> segmentize_paths(vector<pair<linestring_type_fp, bool>> merged_toolpaths,
+                                                        unsigned int jobs) {
   // Merge points that are very close to each other because it makes
   // us more likely to find intersections that was can use.
-  auto merged_toolpaths = toolpaths;
   merge_near_points(merged_toolpaths, 0.00001);
 
   // First we need to split all paths so that they don't cross.  We need to
@@ -117,7 +228,7 @@ vector<pair<linestring_type_fp, bool>> segmentize_paths(const vector<pair<linest
       allow_reversals.push_back(toolpath_and_allow_reversal.second);
     }
   }
-  vector<pair<segment_type_p, bool>> split_segments = segmentize(all_segments, allow_reversals);
+  vector<pair<segment_type_p, bool>> split_segments = segmentize(all_segments, allow_reversals, jobs);
 
   // Only allow reversing the direction of travel if mill_feed_direction is
   // ANY.  We need to scale them back down.
@@ -130,7 +241,7 @@ vector<pair<linestring_type_fp, bool>> segmentize_paths(const vector<pair<linest
     const auto& allow_reversal = segment_and_allow_reversal.second;
     ls.push_back(point_type_fp(segment.low().x() / SCALE, segment.low().y() / SCALE));
     ls.push_back(point_type_fp(segment.high().x() / SCALE, segment.high().y() / SCALE));
-    segments_as_linestrings.push_back(make_pair(ls, allow_reversal));
+    segments_as_linestrings.push_back(make_pair(std::move(ls), allow_reversal));
   }
   return segments_as_linestrings;
 }
@@ -19,9 +19,14 @@ std::vector<std::pair<linestring_type_fp, bool>> unique(
  * into a linestrings that have just two points, the start and the
  * end.  Directionality is maintained on each one along with whether
  * or not it is reversible.
+ *
+ * With more than one job, large inputs are split into tiles that are
+ * intersected on that many threads, 0 for one per core.  The result
+ * is the same for any number of jobs.
  */
 std::vector<std::pair<linestring_type_fp, bool>> segmentize_paths(
-    const std::vector<std::pair<linestring_type_fp, bool>>& toolpaths);
+    std::vector<std::pair<linestring_type_fp, bool>> toolpaths,
+    unsigned int jobs = 1);
 
 } //namespace segmentize
 #endif //SEGMENTIZE_H
@@ -4,6 +4,7 @@
 #include <ostream>
 #include "segmentize.hpp"
 #include "bg_operators.hpp"
+#include "allocation_counter.hpp"
 
 using namespace std;
 
@@ -84,4 +85,46 @@ BOOST_AUTO_TEST_CASE(sort_segments) {
   //print_result(result);
 }
 
+BOOST_AUTO_TEST_CASE(moved_input_is_not_copied) {
+  vector<pair<linestring_type_fp, bool>> ms;
+  for (int i = 0; i < 10; i++) {
+    ms.push_back({{{double(i), 0}, {double(i), 10}, {double(i+1), 10}}, true});
+  }
+  auto ms_copy = ms;
+  const size_t before_copy = allocation_counter::allocations();
+  const auto copied_result = segmentize::segmentize_paths(ms);
+  const size_t copied = allocation_counter::allocations() - before_copy;
+  const size_t before_move = allocation_counter::allocations();
+  const auto moved_result = segmentize::segmentize_paths(std::move(ms_copy));
+  const size_t moved = allocation_counter::allocations() - before_move;
+  BOOST_CHECK(copied_result == moved_result);
+  // Copying is one allocation for the vector and one per linestring.
+  BOOST_CHECK_EQUAL(copied - moved, ms.size() + 1);
+}
+
+// Enough crossing lines to be split into tiles.
+BOOST_AUTO_TEST_CASE(same_for_any_jobs) {
+  vector<pair<linestring_type_fp, bool>> ms;
+  for (int i = 0; i < 40; i++) {
+    linestring_type_fp horizontal;
+    linestring_type_fp vertical;
+    linestring_type_fp diagonal;
+    for (int j = 0; j <= 100; j++) {
+      horizontal.push_back({j * 0.1, i * 0.25 + (j % 2) * 0.01});
+      vertical.push_back({i * 0.25 + (j % 3) * 0.01, j * 0.1});
+      diagonal.push_back({j * 0.1, j * 0.1 - i * 0.2});
+    }
+    ms.push_back({horizontal, i % 2 == 0});
+    ms.push_back({vertical, i % 3 == 0});
+    ms.push_back({diagonal, true});
+  }
+  const auto expected = segmentize::segmentize_paths(ms, 1);
+  BOOST_CHECK_GT(expected.size(), 3 * 40 * 100UL);
+  for (unsigned int jobs : {2, 4, 8, 0}) {
+    BOOST_TEST_CONTEXT("jobs = " << jobs) {
+      BOOST_CHECK(segmentize::segmentize_paths(ms, jobs) == expected);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,319 @@
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <queue>
+#include <tuple>
+#include <cmath>
+#include <functional>
+#include <iterator>
+
+#include <boost/geometry/index/rtree.hpp>
+
+#include "geometry.hpp"
+
+#include "simplify.hpp"
+
+namespace simplify {
+
+using std::vector;
+using std::pair;
+using std::make_pair;
+using std::tuple;
+using std::get;
+using std::min;
+using std::max;
+using std::greater;
+using std::priority_queue;
+
+namespace bgi = boost::geometry::index;
+
+namespace {
+
+// Twice the signed area of the triangle abc, positive if abc turns left.
+coordinate_type_fp cross(const point_type_fp& a, const point_type_fp& b, const point_type_fp& c) {
+  return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+}
+
+int sign(coordinate_type_fp x) {
+  return (x > 0) - (x < 0);
+}
+
+// p is on the line through a and b, is it between them?
+bool in_box(const point_type_fp& p, const point_type_fp& a, const point_type_fp& b) {
+  return min(a.x(), b.x()) <= p.x() && p.x() <= max(a.x(), b.x()) &&
+         min(a.y(), b.y()) <= p.y() && p.y() <= max(a.y(), b.y());
+}
+
+// True if the closed segments pq and ab have any point in common.
+bool segments_intersect(const point_type_fp& p, const point_type_fp& q,
+                        const point_type_fp& a, const point_type_fp& b) {
+  const int d1 = sign(cross(a, b, p));
+  const int d2 = sign(cross(a, b, q));
+  const int d3 = sign(cross(p, q, a));
+  const int d4 = sign(cross(p, q, b));
+  if (d1 * d2 < 0 && d3 * d4 < 0) {
+    return true;
+  }
+  return (d1 == 0 && in_box(p, a, b)) ||
+         (d2 == 0 && in_box(q, a, b)) ||
+         (d3 == 0 && in_box(a, p, q)) ||
+         (d4 == 0 && in_box(b, p, q));
+}
+
+// True if the closed segment pq has any point in common with the closed
+// triangle abc, which has orientation o.
+bool touches_triangle(const point_type_fp& p, const point_type_fp& q,
+                      const point_type_fp& a, const point_type_fp& b, const point_type_fp& c,
+                      int o) {
+  if (segments_intersect(p, q, a, b) ||
+      segments_intersect(p, q, b, c) ||
+      segments_intersect(p, q, c, a)) {
+    return true;
+  }
+  // Otherwise the segment is either all inside or all outside.
+  return o != 0 &&
+         sign(cross(a, b, p)) * o >= 0 &&
+         sign(cross(b, c, p)) * o >= 0 &&
+         sign(cross(c, a, p)) * o >= 0;
+}
+
+// An edge that starts at the apex of a triangle with orientation o goes
+// into the triangle if its direction d is between the two sides of the
+// triangle at the apex.
+bool in_corner(const point_type_fp& apex, const point_type_fp& first, const point_type_fp& second,
+               const point_type_fp& d, int o) {
+  return sign(cross(apex, first, d)) * o >= 0 && sign(cross(apex, d, second)) * o >= 0;
+}
+
+coordinate_type_fp distance_to_segment(const point_type_fp& p,
+                                       const point_type_fp& a, const point_type_fp& b) {
+  const coordinate_type_fp dx = b.x() - a.x();
+  const coordinate_type_fp dy = b.y() - a.y();
+  const coordinate_type_fp length2 = dx * dx + dy * dy;
+  coordinate_type_fp t = 0;
+  if (length2 > 0) {
+    t = max(0.0, min(1.0, ((p.x() - a.x()) * dx + (p.y() - a.y()) * dy) / length2));
+  }
+  return std::hypot(p.x() - (a.x() + t * dx), p.y() - (a.y() + t * dy));
+}
+
+class Simplifier {
+ public:
+  Simplifier(const multi_polygon_type_fp& input, coordinate_type_fp tolerance) :
+      input(input), tolerance(tolerance) {
+    for (const auto& poly : input) {
+      add_ring(poly.outer());
+      for (const auto& inner : poly.inners()) {
+        add_ring(inner);
+      }
+    }
+    removed.assign(points.size(), false);
+    version.assign(points.size(), 0);
+    vector<segment_value> values;
+    values.reserve(points.size());
+    for (size_t v = 0; v < points.size(); v++) {
+      values.push_back(make_segment(v));
+    }
+    segments = segment_index(values.cbegin(), values.cend());
+    for (size_t v = 0; v < points.size(); v++) {
+      push(v);
+    }
+  }
+
+  multi_polygon_type_fp run() {
+    while (!queue.empty()) {
+      const size_t b = get<1>(queue.top());
+      const unsigned int queued_version = get<2>(queue.top());
+      queue.pop();
+      // A vertex that isn't removed now is tried again when one of its
+      // neighbors changes.
+      if (!removed[b] && queued_version == version[b] && can_remove(b)) {
+        remove(b);
+      }
+    }
+    multi_polygon_type_fp output;
+    output.reserve(input.size());
+    size_t ring_index = 0;
+    for (const auto& poly : input) {
+      output.emplace_back();
+      output.back().outer() = make_ring(ring_index++);
+      output.back().inners().reserve(poly.inners().size());
+      for (size_t i = 0; i < poly.inners().size(); i++) {
+        output.back().inners().push_back(make_ring(ring_index++));
+      }
+    }
+    return output;
+  }
+
+ private:
+  struct Ring {
+    size_t start;
+    size_t size;
+    size_t live; // Vertices that weren't removed.
+    coordinate_type_fp original_area;
+    coordinate_type_fp area; // Twice the signed area of the live vertices.
+  };
+  // The bounding box of the edge that starts at each vertex.
+  typedef pair<box_type_fp, size_t> segment_value;
+  typedef bgi::rtree<segment_value, bgi::quadratic<16>> segment_index;
+  // Area of the triangle, vertex, version when queued.
+  typedef tuple<coordinate_type_fp, size_t, unsigned int> queue_entry;
+
+  void add_ring(const ring_type_fp& ring) {
+    Ring r;
+    r.start = points.size();
+    r.size = ring.size();
+    if (r.size > 1 && bg::equals(ring.front(), ring.back())) {
+      r.size--; // Without the closing point.
+    }
+    r.live = r.size;
+    r.area = 0;
+    for (size_t i = 0; i < r.size; i++) {
+      points.push_back(ring[i]);
+      ring_of.push_back(rings.size());
+      prev.push_back(r.start + (i + r.size - 1) % r.size);
+      next.push_back(r.start + (i + 1) % r.size);
+      const auto& p = ring[i];
+      const auto& q = ring[(i + 1) % r.size];
+      r.area += p.x() * q.y() - q.x() * p.y();
+    }
+    r.original_area = r.area;
+    rings.push_back(r);
+  }
+
+  segment_value make_segment(size_t v) const {
+    const auto& p = points[v];
+    const auto& q = points[next[v]];
+    return make_pair(box_type_fp(point_type_fp(min(p.x(), q.x()), min(p.y(), q.y())),
+                                 point_type_fp(max(p.x(), q.x()), max(p.y(), q.y()))),
+                     v);
+  }
+
+  // The next vertex in the input, whether or not it was removed.
+  size_t original_next(size_t v) const {
+    const Ring& ring = rings[ring_of[v]];
+    return ring.start + (v - ring.start + 1) % ring.size;
+  }
+
+  void push(size_t v) {
+    if (rings[ring_of[v]].live <= 3) {
+      return;
+    }
+    const auto& a = points[prev[v]];
+    const auto& c = points[next[v]];
+    // It would fail the check in can_remove anyway.
+    if (distance_to_segment(points[v], a, c) > tolerance) {
+      return;
+    }
+    queue.emplace(std::abs(cross(a, points[v], c)) / 2, v, version[v]);
+  }
+
+  bool can_remove(size_t b) const {
+    const Ring& ring = rings[ring_of[b]];
+    if (ring.live <= 3) {
+      return false;
+    }
+    const size_t a = prev[b];
+    const size_t c = next[b];
+    const auto& pa = points[a];
+    const auto& pb = points[b];
+    const auto& pc = points[c];
+    const auto triangle = cross(pa, pb, pc);
+    const auto new_area = ring.area - triangle;
+    if (new_area == 0 || sign(new_area) != sign(ring.original_area)) {
+      return false;
+    }
+    // All the vertices that the new edge replaces must be near it.
+    for (size_t i = original_next(a); i != c; i = original_next(i)) {
+      if (distance_to_segment(points[i], pa, pc) > tolerance) {
+        return false;
+      }
+    }
+    // No other edge may touch the triangle that is cut off or added.
+    const int o = sign(triangle);
+    const box_type_fp box(point_type_fp(min({pa.x(), pb.x(), pc.x()}), min({pa.y(), pb.y(), pc.y()})),
+                          point_type_fp(max({pa.x(), pb.x(), pc.x()}), max({pa.y(), pb.y(), pc.y()})));
+    found.clear();
+    segments.query(bgi::intersects(box), std::back_inserter(found));
+    for (const auto& segment : found) {
+      const size_t s = segment.second;
+      const size_t t = next[s];
+      if (s == a || s == b) {
+        continue; // The edges that are replaced.
+      }
+      if (t == a) {
+        // The edge before, which touches the triangle at a.
+        if (o != 0 && in_corner(pa, pb, pc, points[s], o)) {
+          return false;
+        }
+        continue;
+      }
+      if (s == c) {
+        // The edge after, which touches the triangle at c.
+        if (o != 0 && in_corner(pc, pa, pb, points[t], o)) {
+          return false;
+        }
+        continue;
+      }
+      if (touches_triangle(points[s], points[t], pa, pb, pc, o)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void remove(size_t b) {
+    const size_t a = prev[b];
+    const size_t c = next[b];
+    Ring& ring = rings[ring_of[b]];
+    ring.area -= cross(points[a], points[b], points[c]);
+    ring.live--;
+    segments.remove(make_segment(a));
+    segments.remove(make_segment(b));
+    removed[b] = true;
+    next[a] = c;
+    prev[c] = a;
+    segments.insert(make_segment(a));
+    version[a]++;
+    version[c]++;
+    push(a);
+    push(c);
+  }
+
+  ring_type_fp make_ring(size_t ring_index) const {
+    const Ring& ring = rings[ring_index];
+    ring_type_fp output;
+    if (ring.size == 0) {
+      return output;
+    }
+    output.reserve(ring.live + 1);
+    for (size_t v = ring.start; v < ring.start + ring.size; v++) {
+      if (!removed[v]) {
+        output.push_back(points[v]);
+      }
+    }
+    output.push_back(output.front());
+    return output;
+  }
+
+  const multi_polygon_type_fp& input;
+  const coordinate_type_fp tolerance;
+  vector<point_type_fp> points;
+  vector<size_t> ring_of;
+  vector<size_t> prev;
+  vector<size_t> next;
+  vector<Ring> rings;
+  vector<bool> removed;
+  vector<unsigned int> version;
+  segment_index segments;
+  mutable vector<segment_value> found; // For can_remove, to save allocations.
+  priority_queue<queue_entry, vector<queue_entry>, greater<queue_entry>> queue;
+};
+
+} // namespace
+
+multi_polygon_type_fp simplify(const multi_polygon_type_fp& input, coordinate_type_fp tolerance) {
+  return Simplifier(input, tolerance).run();
+}
+
+} // namespace simplify
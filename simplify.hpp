@@ -0,0 +1,20 @@
+#ifndef SIMPLIFY_HPP
+#define SIMPLIFY_HPP
+
+#include "geometry.hpp"
+
+namespace simplify {
+
+// Remove vertices from the rings of the input, smallest triangle first
+// like Visvalingam-Whyatt, so long as every removed vertex stays within
+// tolerance of the new edge that replaces it.  Unlike bg::simplify, the
+// topology is kept: a vertex isn't removed if that would make an edge
+// touch another edge, move a ring across another one, flip a ring or
+// leave it with fewer than 3 vertices.  So the output has the same
+// number of polygons and holes as the input and is valid if the input
+// is.
+multi_polygon_type_fp simplify(const multi_polygon_type_fp& input, coordinate_type_fp tolerance);
+
+} // namespace simplify
+
+#endif //SIMPLIFY_HPP
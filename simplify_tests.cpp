@@ -0,0 +1,160 @@
+#define BOOST_TEST_MODULE simplify tests
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <iostream>
+
+#include "geometry.hpp"
+
+#include "simplify.hpp"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(simplify_tests)
+
+// A circle of radius r at x, y with n points, clockwise like Boost
+// Geometry wants.
+ring_type_fp make_circle(double x, double y, double r, size_t n) {
+  ring_type_fp ring;
+  for (size_t i = 0; i < n; i++) {
+    const double angle = -2 * M_PI * i / n;
+    ring.push_back(point_type_fp(x + r * cos(angle), y + r * sin(angle)));
+  }
+  ring.push_back(ring.front());
+  return ring;
+}
+
+size_t count_points(const multi_polygon_type_fp& mp) {
+  size_t count = 0;
+  for (const auto& poly : mp) {
+    count += poly.outer().size();
+    for (const auto& inner : poly.inners()) {
+      count += inner.size();
+    }
+  }
+  return count;
+}
+
+// Every point of the input is within tolerance of the output.
+void check_near(const multi_polygon_type_fp& input, const multi_polygon_type_fp& output, double tolerance) {
+  BOOST_REQUIRE_EQUAL(input.size(), output.size());
+  for (size_t i = 0; i < input.size(); i++) {
+    BOOST_REQUIRE_EQUAL(input[i].inners().size(), output[i].inners().size());
+    const linestring_type_fp outer(output[i].outer().cbegin(), output[i].outer().cend());
+    for (const auto& point : input[i].outer()) {
+      BOOST_CHECK_LE(bg::distance(point, outer), tolerance * (1 + 1e-9));
+    }
+    for (size_t j = 0; j < input[i].inners().size(); j++) {
+      const linestring_type_fp inner(output[i].inners()[j].cbegin(), output[i].inners()[j].cend());
+      for (const auto& point : input[i].inners()[j]) {
+        BOOST_CHECK_LE(bg::distance(point, inner), tolerance * (1 + 1e-9));
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(empty) {
+  BOOST_CHECK_EQUAL(simplify::simplify(multi_polygon_type_fp(), 1).size(), 0UL);
+}
+
+BOOST_AUTO_TEST_CASE(collinear) {
+  multi_polygon_type_fp mp;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 1,0 2,1 2,2 2,2 1,2 0,1 0,0 0)))", mp);
+  multi_polygon_type_fp expected;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 2,2 2,2 0,0 0)))", expected);
+  const auto result = simplify::simplify(mp, 0);
+  BOOST_CHECK(bg::equals(result, expected));
+  BOOST_CHECK_EQUAL(result[0].outer().size(), 5UL);
+}
+
+BOOST_AUTO_TEST_CASE(circle) {
+  multi_polygon_type_fp mp{polygon_type_fp{make_circle(0, 0, 1, 360)}};
+  mp[0].inners().push_back(make_circle(0, 0, 0.5, 360));
+  bg::reverse(mp[0].inners()[0]);
+  BOOST_REQUIRE(bg::is_valid(mp));
+  const auto result = simplify::simplify(mp, 0.001);
+  BOOST_CHECK(bg::is_valid(result));
+  check_near(mp, result, 0.001);
+  BOOST_CHECK_LT(count_points(result), count_points(mp) / 4);
+  BOOST_CHECK_GT(count_points(result), 20UL);
+}
+
+BOOST_AUTO_TEST_CASE(rings_stay) {
+  // A tiny square is much smaller than the tolerance but it isn't
+  // removed, it just becomes a triangle.
+  multi_polygon_type_fp mp;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 0.01,0.01 0.01,0.01 0,0 0)),((1 1,1 1.01,1.01 1.01,1.01 1,1 1)))", mp);
+  const auto result = simplify::simplify(mp, 1);
+  BOOST_REQUIRE_EQUAL(result.size(), 2UL);
+  BOOST_CHECK_EQUAL(count_points(result), 8UL);
+  BOOST_CHECK(bg::is_valid(result));
+  BOOST_CHECK_CLOSE(bg::area(result), 0.0001, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(no_crossing) {
+  // A notch in the big square has a small square in it.  Removing the
+  // notch would be within the tolerance but would cover the small
+  // square, so it stays.
+  multi_polygon_type_fp mp;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 10,4.9 10,5 9.5,5.1 10,10 10,10 0,0 0)),"
+               "((4.995 9.8,4.995 9.9,5.005 9.9,5.005 9.8,4.995 9.8)))", mp);
+  BOOST_REQUIRE(bg::is_valid(mp));
+  const auto result = simplify::simplify(mp, 1);
+  BOOST_CHECK(bg::is_valid(result));
+  BOOST_CHECK(!bg::intersects(result[0], result[1]));
+  BOOST_CHECK(bg::covered_by(point_type_fp(5, 9.5), result[0]));
+  // Without the small square, the notch goes.
+  mp.pop_back();
+  const auto alone = simplify::simplify(mp, 1);
+  BOOST_CHECK(!bg::covered_by(point_type_fp(5, 9.99), mp[0]));
+  BOOST_CHECK(bg::covered_by(point_type_fp(5, 9.99), alone[0]));
+}
+
+BOOST_AUTO_TEST_CASE(hole_stays_inside) {
+  // The hole is close to the outer ring so simplifying either one
+  // without looking at the other would make them cross.
+  multi_polygon_type_fp mp{polygon_type_fp{make_circle(0, 0, 1, 100)}};
+  mp[0].inners().push_back(make_circle(0, 0, 0.99, 100));
+  bg::reverse(mp[0].inners()[0]);
+  BOOST_REQUIRE(bg::is_valid(mp));
+  const auto result = simplify::simplify(mp, 0.05);
+  BOOST_CHECK(bg::is_valid(result));
+  check_near(mp, result, 0.05);
+}
+
+BOOST_AUTO_TEST_CASE(many_circles) {
+  // Random circles that don't overlap.
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> position(0, 100);
+  multi_polygon_type_fp mp;
+  while (mp.size() < 200) {
+    polygon_type_fp circle{make_circle(position(gen), position(gen), 1, 64)};
+    if (!bg::intersects(circle, mp)) {
+      mp.push_back(circle);
+    }
+  }
+  BOOST_REQUIRE(bg::is_valid(mp));
+  for (const double tolerance : {0.001, 0.01, 0.1, 10.0}) {
+    const auto result = simplify::simplify(mp, tolerance);
+    BOOST_CHECK(bg::is_valid(result));
+    check_near(mp, result, tolerance);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(benchmark, *boost::unit_test::disabled()) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> position(0, 1000);
+  multi_polygon_type_fp mp;
+  for (size_t i = 0; i < 10000; i++) {
+    mp.push_back(polygon_type_fp{make_circle(position(gen), position(gen), 1, 360)});
+  }
+  const auto start = chrono::steady_clock::now();
+  const auto result = simplify::simplify(mp, 0.001);
+  const auto end = chrono::steady_clock::now();
+  cout << "Simplified " << count_points(mp) << " points to " << count_points(result) << " in "
+       << chrono::duration<double>(end - start).count() << " seconds" << endl;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -73,19 +73,20 @@ using boost::make_optional;
 #include "trim_paths.hpp"
 #include "svg_writer.hpp"
 #include "disjoint_set.hpp"
+#include "voronoi_cache.hpp"
+#include "simplify.hpp"
 
 using std::max;
 using std::max_element;
 using std::next;
 using std::dynamic_pointer_cast;
 
-unsigned int Surface_vectorial::debug_image_index = 0;
-
 Surface_vectorial::Surface_vectorial(unsigned int points_per_circle,
                                      const box_type_fp& bounding_box,
                                      string name, string outputdir,
                                      bool tsp_2opt, MillFeedDirection::MillFeedDirection mill_feed_direction,
-                                     bool invert_gerbers, bool render_paths_to_shapes) :
+                                     bool invert_gerbers, bool render_paths_to_shapes,
+                                     coordinate_type_fp svg_resolution) :
     points_per_circle(points_per_circle),
     bounding_box(bounding_box),
     name(name),
@@ -94,10 +95,13 @@ Surface_vectorial::Surface_vectorial(unsigned int points_per_circle,
     fill(false),
     mill_feed_direction(mill_feed_direction),
     invert_gerbers(invert_gerbers),
-    render_paths_to_shapes(render_paths_to_shapes) {}
+    render_paths_to_shapes(render_paths_to_shapes),
+    svg_resolution(svg_resolution) {}
 
-void Surface_vectorial::render(shared_ptr<GerberImporter> importer, double tolerance) {
+void Surface_vectorial::render(shared_ptr<GerberImporter> importer, double tolerance,
+                               double simplify_tolerance) {
   auto vectorial_surface_not_simplified = importer->render(fill, render_paths_to_shapes, points_per_circle);
+  point_counts.push_back(make_pair("imported", bg::num_points(vectorial_surface_not_simplified.first)));
 
   if (bg::intersects(vectorial_surface_not_simplified.first)) {
     cerr << "\nWarning: Geometry of layer '" << name << "' is"
@@ -108,7 +112,13 @@ void Surface_vectorial::render(shared_ptr<GerberImporter> importer, double toler
 
   vectorial_surface = make_shared<
       pair<multi_polygon_type_fp, map<coordinate_type_fp, multi_linestring_type_fp>>>();
-  if (tolerance > 0) {
+  if (simplify_tolerance > 0) {
+    // Unlike bg::simplify, this keeps shapes that are close from
+    // touching.  The paths below are just lines so they are simplified
+    // to the same tolerance with bg::simplify.
+    vectorial_surface->first = simplify::simplify(vectorial_surface_not_simplified.first, simplify_tolerance);
+    tolerance = simplify_tolerance;
+  } else if (tolerance > 0) {
     //With a very small loss of precision we can reduce memory usage and processing time
     bg::simplify(vectorial_surface_not_simplified.first, vectorial_surface->first, tolerance);
   } else {
@@ -124,6 +134,7 @@ void Surface_vectorial::render(shared_ptr<GerberImporter> importer, double toler
       vectorial_surface->second[diameter_and_path.first].swap(diameter_and_path.second);
     }
   }
+  point_counts.push_back(make_pair("simplified", bg::num_points(vectorial_surface->first)));
 }
 
 // If the direction is ccw, return cw and vice versa.  If any, return any.
@@ -137,21 +148,20 @@ MillFeedDirection::MillFeedDirection invert(const MillFeedDirection::MillFeedDir
   }
 }
 
-multi_linestring_type_fp mirror_toolpath(const multi_linestring_type_fp& mls, bool mirror, bool ymirror) {
-  multi_linestring_type_fp result;
-  for (const auto& ls : mls) {
-    linestring_type_fp new_ls;
-    for (const auto& point : ls) {
-      new_ls.push_back(
-        point_type_fp(
-          (mirror && !ymirror ? -point.x() : point.x()),
-          (mirror &&  ymirror ? -point.y() : point.y())
-        )
-      );
+multi_linestring_type_fp mirror_toolpath(multi_linestring_type_fp mls, bool mirror, bool ymirror) {
+  if (!mirror) {
+    return mls;
+  }
+  for (auto& ls : mls) {
+    for (auto& point : ls) {
+      if (ymirror) {
+        point.y(-point.y());
+      } else {
+        point.x(-point.x());
+      }
     }
-    result.push_back(new_ls);
   }
-  return result;
+  return mls;
 }
 
 // Find all potential thermal reliefs.  Those are usually holes in traces.
@@ -193,18 +203,18 @@ void Surface_vectorial::write_svgs(const string& tool_suffix, coordinate_type_fp
                                    const vector<vector<pair<linestring_type_fp, bool>>>& new_trace_toolpaths,
                                    coordinate_type_fp tolerance, bool find_contentions) const {
   // Now set up the debug images, one per tool.
-  svg_writer debug_image(build_filename(outputdir, "processed_" + name + tool_suffix + ".svg"), bounding_box);
-  svg_writer traced_debug_image(build_filename(outputdir, "traced_" + name + tool_suffix + ".svg"), bounding_box);
+  svg_writer debug_image(build_filename(outputdir, "processed_" + name + tool_suffix + ".svg"), bounding_box, svg_resolution);
+  svg_writer traced_debug_image(build_filename(outputdir, "traced_" + name + tool_suffix + ".svg"), bounding_box, svg_resolution);
   optional<svg_writer> contentions_image;
-  srand(1);
+  svg_writer::seed_colors(1);
   debug_image.add(voronoi, 0.2, false);
-  srand(1);
+  svg_writer::seed_colors(1);
   const auto trace_count = new_trace_toolpaths.size();
   for (size_t trace_index = 0; trace_index < trace_count; trace_index++) {
     const auto& new_trace_toolpath = new_trace_toolpaths[trace_index];
-    const unsigned int r = rand() % 256;
-    const unsigned int g = rand() % 256;
-    const unsigned int b = rand() % 256;
+    const unsigned int r = svg_writer::random_color();
+    const unsigned int g = svg_writer::random_color();
+    const unsigned int b = svg_writer::random_color();
     for (const auto& ls_and_allow_reversal : new_trace_toolpath) {
       debug_image.add(ls_and_allow_reversal.first, tool_diameter, r, g, b);
       traced_debug_image.add(ls_and_allow_reversal.first, tool_diameter, r, g, b);
@@ -223,7 +233,7 @@ void Surface_vectorial::write_svgs(const string& tool_suffix, coordinate_type_fp
           if (!contentions_image) {
             contentions_image.emplace(build_filename(outputdir, "contentions_" + name + tool_suffix + ".svg"), bounding_box);
           }
-          contentions_image->add(temp2, tool_diameter, 255, 0, 0);
+          contentions_image->add(std::move(temp2), tool_diameter, 255, 0, 0);
         }
       }
     }
@@ -233,7 +243,7 @@ void Surface_vectorial::write_svgs(const string& tool_suffix, coordinate_type_fp
         " clearance requirements.  Check the contentions output"
         " and consider using a smaller milling bit.\n";
   }
-  srand(1);
+  svg_writer::seed_colors(1);
   debug_image.add(vectorial_surface->first, 1, true);
   for (const auto& diameter_and_path : vectorial_surface->second) {
     debug_image.add(diameter_and_path.second, diameter_and_path.first, true);
@@ -242,11 +252,16 @@ void Surface_vectorial::write_svgs(const string& tool_suffix, coordinate_type_fp
 
 vector<pair<linestring_type_fp, bool>> full_eulerian_paths(
     const std::shared_ptr<RoutingMill>& mill,
-    const vector<pair<linestring_type_fp, bool>>& toolpath) {
-  auto toolpath1 = toolpath;
-  toolpath1 = segmentize::segmentize_paths(toolpath1);
+    vector<pair<linestring_type_fp, bool>> toolpath1) {
+  toolpath1 = segmentize::segmentize_paths(std::move(toolpath1), mill->jobs);
   toolpath1 = segmentize::unique(toolpath1);
 
+  vector<bool> reversible;
+  reversible.reserve(toolpath1.size());
+  for (const auto& p : toolpath1) {
+    reversible.push_back(p.second);
+  }
+  vector<size_t> backtrack_sources;
   vector<pair<linestring_type_fp, bool>> paths_to_add;
   paths_to_add = backtrack::backtrack(
       toolpath1,
@@ -254,14 +269,16 @@ vector<pair<linestring_type_fp, bool>> full_eulerian_paths(
       (mill->zsafe - mill->zwork) / mill->g0_vertical_speed,
       mill->g0_vertical_speed,
       (mill->zsafe - mill->zwork) / mill->vertfeed,
-      mill->backtrack);
-  for (const auto& p : paths_to_add) {
-    toolpath1.push_back(p);
-  }
+      mill->backtrack,
+      mill->jobs,
+      &backtrack_sources);
+  toolpath1.insert(toolpath1.cend(), paths_to_add.cbegin(), paths_to_add.cend());
+  vector<vector<size_t>> segment_sources;
   toolpath1 = eulerian_paths::get_eulerian_paths<
     point_type_fp,
-    linestring_type_fp>(toolpath1);
-  trim_paths::trim_paths(toolpath1, paths_to_add);
+    linestring_type_fp>(toolpath1, &segment_sources);
+  trim_paths::trim_paths(toolpath1, segment_sources, reversible,
+                         paths_to_add, backtrack_sources);
   return toolpath1;
 }
 
@@ -271,23 +288,26 @@ vector<pair<linestring_type_fp, bool>> full_eulerian_paths(
 multi_linestring_type_fp Surface_vectorial::post_process_toolpath(
     const std::shared_ptr<RoutingMill>& mill,
     const boost::optional<const path_finding::PathFindingSurface*>& path_finding_surface,
-    vector<pair<linestring_type_fp, bool>> toolpath1) const {
+    vector<pair<linestring_type_fp, bool>> toolpath1,
+    const boost::optional<path_finding::SearchBudget*>& budget) const {
   if (mill->eulerian_paths) {
-    toolpath1 = full_eulerian_paths(mill, toolpath1);
+    toolpath1 = full_eulerian_paths(mill, std::move(toolpath1));
   }
   if (path_finding_surface) {
-    const auto extra_paths = final_path_finder(mill, **path_finding_surface, toolpath1);
+    auto extra_paths = final_path_finder(mill, **path_finding_surface, toolpath1, budget);
     if (extra_paths.size() > 0) {
-      toolpath1.insert(toolpath1.cend(), extra_paths.cbegin(), extra_paths.cend());
+      toolpath1.insert(toolpath1.cend(),
+                       std::make_move_iterator(extra_paths.begin()),
+                       std::make_move_iterator(extra_paths.end()));
       if (mill->eulerian_paths) {
-        toolpath1 = full_eulerian_paths(mill, toolpath1);
+        toolpath1 = full_eulerian_paths(mill, std::move(toolpath1));
       }
     }
   }
   multi_linestring_type_fp combined_toolpath;
   combined_toolpath.reserve(toolpath1.size());
-  for (const auto& ls_and_allow_reversal : toolpath1) {
-    combined_toolpath.push_back(ls_and_allow_reversal.first);
+  for (auto& ls_and_allow_reversal : toolpath1) {
+    combined_toolpath.push_back(std::move(ls_and_allow_reversal.first));
   }
   shared_ptr<Isolator> isolator = dynamic_pointer_cast<Isolator>(mill);
   if (isolator != nullptr) {
@@ -309,7 +329,7 @@ multi_linestring_type_fp Surface_vectorial::post_process_toolpath(
   if (mill->optimise) {
     multi_linestring_type_fp temp_mls;
     bg::simplify(combined_toolpath, temp_mls, mill->optimise);
-    combined_toolpath = temp_mls;
+    combined_toolpath.swap(temp_mls);
   }
   return combined_toolpath;
 }
@@ -731,7 +751,8 @@ Surface_vectorial::PathFinderRingIndices Surface_vectorial::make_path_finder_rin
     shared_ptr<RoutingMill> mill,
     const path_finding::PathFindingSurface& path_finding_surface) const {
   return [mill, &path_finding_surface](const point_type_fp& a, const point_type_fp& b,
-                                       path_finding::SearchKey search_key) {
+                                       path_finding::SearchKey search_key,
+                                       const boost::optional<path_finding::Deadline>& deadline) {
            // Solve for distance:
            // risetime at G0 + horizontal distance G0 + plunge G1 ==
            // travel time at G1
@@ -749,7 +770,7 @@ Surface_vectorial::PathFinderRingIndices Surface_vectorial::make_path_finder_rin
            const double max_g1_distance = std::isinf(mill->backtrack) ?
                g0_time * horizontalG1speed :
                mill->backtrack*g0_time / (1 + mill->backtrack/horizontalG1speed);
-           return path_finding_surface.find_path(a, b, max_g1_distance, mill->path_finding_limit, search_key);
+           return path_finding_surface.find_path(a, b, max_g1_distance, mill->path_finding_limit, search_key, deadline);
          };
 }
 
@@ -880,7 +901,8 @@ vector<pair<linestring_type_fp, bool>> Surface_vectorial::get_single_toolpath(
 vector<pair<linestring_type_fp, bool>> Surface_vectorial::final_path_finder(
     const std::shared_ptr<RoutingMill>& mill,
     const path_finding::PathFindingSurface& path_finding_surface,
-    const vector<pair<linestring_type_fp, bool>>& paths) const {
+    const vector<pair<linestring_type_fp, bool>>& paths,
+    const boost::optional<path_finding::SearchBudget*>& budget) const {
   // Find all the connectable endpoints.  A connection can only be
   // made if the direction suits it.  connections is the list of
   // possible connections to make.  It is a tuple of (distance between
@@ -927,7 +949,7 @@ vector<pair<linestring_type_fp, bool>> Surface_vectorial::final_path_finder(
 
   vector<pair<linestring_type_fp, bool>> new_paths;
   PathFinderRingIndices path_finder = make_path_finder_ring_indices(mill, path_finding_surface);
-  DisjointSet<size_t> joined_paths;
+  DenseDisjointSet joined_paths(paths.size());
   for (const auto& start_end : connections) {
     const point_type_fp& start = get<1>(start_end);
     const point_type_fp& end = get<2>(start_end);
@@ -943,7 +965,18 @@ vector<pair<linestring_type_fp, bool>> Surface_vectorial::final_path_finder(
     if (joined_paths.find(start_path) == joined_paths.find(end_path)) {
       continue; // The two paths were already connected.
     }
-    boost::optional<linestring_type_fp> new_path = path_finder(start, end, *start_ring_indices);
+    boost::optional<path_finding::Deadline> deadline;
+    if (budget) {
+      deadline = (*budget)->start_search();
+      if (!deadline) {
+        (*budget)->skip();
+        continue; // Out of time, so this one isn't searched.
+      }
+    }
+    boost::optional<linestring_type_fp> new_path = path_finder(start, end, *start_ring_indices, deadline);
+    if (budget) {
+      (*budget)->end_search(path_finding_surface.timed_out());
+    }
     if (new_path) {
       new_paths.push_back({*new_path, true});
       joined_paths.join(start_path, end_path);
@@ -952,9 +985,8 @@ vector<pair<linestring_type_fp, bool>> Surface_vectorial::final_path_finder(
   return new_paths;
 }
 
-// A bunch of pairs.  Each pair is the tool diameter followed by a vector of paths to mill.
-vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::get_toolpath(
-    shared_ptr<RoutingMill> mill, bool mirror, bool ymirror) {
+void Surface_vectorial::get_toolpath(shared_ptr<RoutingMill> mill, bool mirror, bool ymirror,
+                                     const ToolpathDone& done) {
   bg::unique(vectorial_surface->first);
   for (auto& diameter_and_path : vectorial_surface->second) {
     bg::unique(diameter_and_path.second);
@@ -963,19 +995,32 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
     vectorial_surface->first = bounding_box - vectorial_surface->first;
   }
   const auto tolerance = mill->tolerance;
-  // Get the voronoi region for each trace.
-  voronoi = Voronoi::build_voronoi(vectorial_surface->first, bounding_box, tolerance);
-
+  // Get the voronoi region for each trace.  They are needed even
+  // without --voronoi because each trace's milling is kept inside its
+  // region.
   auto isolator = dynamic_pointer_cast<Isolator>(mill);
+  voronoi = voronoi_cache::build_voronoi(mill->cache_dir, vectorial_surface->first, bounding_box,
+                                         tolerance, mill->jobs,
+                                         isolator ? isolator->voronoi_tile_size : 0);
+  point_counts.push_back(make_pair("voronoi", bg::num_points(voronoi)));
+
   if (isolator) {
     if (isolator->preserve_thermal_reliefs && isolator->voronoi) {
       thermal_holes = find_thermal_reliefs(vectorial_surface->first, tolerance);
     }
     const auto tool_count = isolator->tool_diameters_and_overlap_widths.size();
-    vector<pair<coordinate_type_fp, multi_linestring_type_fp>> results(tool_count);
+    // The lines that need drawing are milled after, each with its own tool.
+    const auto all_tool_count = tool_count + vectorial_surface->second.size();
     const auto trace_count = vectorial_surface->first.size() + thermal_holes.size(); // Includes thermal holes.
     // One for each trace or thermal hole, including all prior tools.
     vector<multi_polygon_type_fp> already_milled(trace_count);
+    // All the tools together, for reporting.
+    size_t toolpath_points = 0;
+    // The time limit is for all the path finding in this layer.
+    boost::optional<path_finding::SearchBudget> path_finding_budget;
+    if (!std::isinf(isolator->path_finding_time_limit)) {
+      path_finding_budget.emplace(isolator->path_finding_time_limit);
+    }
     for (size_t tool_index = 0; tool_index < tool_count; tool_index++) {
       const auto& tool = isolator->tool_diameters_and_overlap_widths[tool_index];
       const auto tool_diameter = tool.first;
@@ -1010,20 +1055,20 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
           for (const auto& ls_and_allow_reversal : new_trace_toolpath) {
             multi_linestring_type_fp temp_mls;
             temp_mls = ls_and_allow_reversal.first & shrunk_bounding_box;
-            for (const auto& ls : temp_mls) {
-              temp.push_back(make_pair(ls, ls_and_allow_reversal.second));
+            for (auto& ls : temp_mls) {
+              temp.push_back(make_pair(std::move(ls), ls_and_allow_reversal.second));
             }
           }
           new_trace_toolpath.swap(temp);
         }
-        new_trace_toolpaths[trace_index] = new_trace_toolpath;
+        new_trace_toolpaths[trace_index] = std::move(new_trace_toolpath);
         if (tool_index + 1 == tool_count) {
           // No point in updating the already_milled.
           continue;
         }
         multi_linestring_type_fp combined_trace_toolpath;
-        combined_trace_toolpath.reserve(new_trace_toolpath.size());
-        for (const auto& ls_and_allow_reversal : new_trace_toolpath) {
+        combined_trace_toolpath.reserve(new_trace_toolpaths[trace_index].size());
+        for (const auto& ls_and_allow_reversal : new_trace_toolpaths[trace_index]) {
           combined_trace_toolpath.push_back(ls_and_allow_reversal.first);
         }
         multi_polygon_type_fp new_trace_toolpath_bufferred =
@@ -1033,10 +1078,17 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
 
       const string tool_suffix = tool_count > 1 ? "_" + std::to_string(tool_index) : "";
       write_svgs(tool_suffix, tool_diameter, new_trace_toolpaths, isolator->tolerance, tool_index == tool_count - 1);
-      auto new_toolpath = flatten(new_trace_toolpaths);
-      multi_linestring_type_fp combined_toolpath = post_process_toolpath(mill, boost::make_optional(&path_finding_surface), new_toolpath);
+      multi_linestring_type_fp combined_toolpath = post_process_toolpath(
+          mill, boost::make_optional(&path_finding_surface), flatten(std::move(new_trace_toolpaths)),
+          path_finding_budget ? boost::make_optional(&*path_finding_budget) : boost::none);
       write_svgs("_final" + tool_suffix, tool_diameter, combined_toolpath, isolator->tolerance, tool_index == tool_count - 1);
-      results[tool_index] = make_pair(tool_diameter, mirror_toolpath(combined_toolpath, mirror, ymirror));
+      toolpath_points += bg::num_points(combined_toolpath);
+      done(all_tool_count, tool_diameter, mirror_toolpath(std::move(combined_toolpath), mirror, ymirror));
+    }
+    if (path_finding_budget && path_finding_budget->cut_short() + path_finding_budget->skipped() > 0) {
+      cerr << "\nWarning: path-finding-time-limit was reached in layer '" << name
+           << "': " << path_finding_budget->cut_short() << " searches were cut short and "
+           << path_finding_budget->skipped() << " connections weren't searched.\n";
     }
     // Now process any lines that need drawing.
     for (const auto& diameter_and_paths : vectorial_surface->second) {
@@ -1054,10 +1106,12 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
       }
       const string tool_suffix = "_lines_" + std::to_string(tool_diameter);
       write_svgs(tool_suffix, tool_diameter, {new_trace_toolpath}, mill->tolerance, false);
-      multi_linestring_type_fp combined_toolpath = post_process_toolpath(isolator, boost::none, new_trace_toolpath);
-      results.push_back(make_pair(tool_diameter, mirror_toolpath(combined_toolpath, mirror, ymirror)));
+      multi_linestring_type_fp combined_toolpath = post_process_toolpath(isolator, boost::none, std::move(new_trace_toolpath));
+      toolpath_points += bg::num_points(combined_toolpath);
+      done(all_tool_count, tool_diameter, mirror_toolpath(std::move(combined_toolpath), mirror, ymirror));
     }
-    return results;
+    point_counts.push_back(make_pair("toolpath", toolpath_points));
+    return;
   }
   auto cutter = dynamic_pointer_cast<Cutter>(mill);
   if (cutter) {
@@ -1066,29 +1120,27 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
     vector<vector<pair<linestring_type_fp, bool>>> new_trace_toolpaths(trace_count);
 
     for (size_t trace_index = 0; trace_index < trace_count; trace_index++) {
-      const auto new_trace_toolpath = get_single_toolpath(cutter, trace_index, mirror, cutter->tool_diameter, 0, multi_polygon_type_fp(), path_finding_surface);
-      new_trace_toolpaths[trace_index] = new_trace_toolpath;
+      new_trace_toolpaths[trace_index] = get_single_toolpath(cutter, trace_index, mirror, cutter->tool_diameter, 0, multi_polygon_type_fp(), path_finding_surface);
     }
     write_svgs("", cutter->tool_diameter, new_trace_toolpaths, mill->tolerance, false);
-    auto new_toolpath = flatten(new_trace_toolpaths);
-    multi_linestring_type_fp combined_toolpath = post_process_toolpath(cutter, boost::none, new_toolpath);
-    return {make_pair(cutter->tool_diameter, mirror_toolpath(combined_toolpath, mirror, ymirror))};
+    multi_linestring_type_fp combined_toolpath = post_process_toolpath(cutter, boost::none, flatten(std::move(new_trace_toolpaths)));
+    point_counts.push_back(make_pair("toolpath", bg::num_points(combined_toolpath)));
+    done(1, cutter->tool_diameter, mirror_toolpath(std::move(combined_toolpath), mirror, ymirror));
+    return;
   }
   throw std::logic_error("Can't mill with something other than a Cutter or an Isolator.");
 }
 
-void Surface_vectorial::save_debug_image(string message)
+void Surface_vectorial::save_debug_image(string message, unsigned int index) const
 {
-    const string filename = (boost::format("outp%d_%s.svg") % debug_image_index % message).str();
-    svg_writer debug_image(build_filename(outputdir, filename), bounding_box);
+    const string filename = (boost::format("outp%d_%s.svg") % index % message).str();
+    svg_writer debug_image(build_filename(outputdir, filename), bounding_box, svg_resolution);
 
-    srand(1);
+    svg_writer::seed_colors(1);
     debug_image.add(vectorial_surface->first, 1, true);
     for (const auto& diameter_and_path : vectorial_surface->second) {
       debug_image.add(diameter_and_path.second, diameter_and_path.first, true);
     }
-
-    ++debug_image_index;
 }
 
 void Surface_vectorial::enable_filling() {
@@ -1101,6 +1153,7 @@ void Surface_vectorial::add_mask(shared_ptr<Surface_vectorial> surface) {
   for (auto& diameter_and_path : vectorial_surface->second) {
     diameter_and_path.second = diameter_and_path.second & mask->vectorial_surface->first;
   }
+  point_counts.push_back(make_pair("masked", bg::num_points(vectorial_surface->first)));
 }
 
 // The input is the trace which we want to isolate.  It might have
@@ -50,23 +50,40 @@ class Surface_vectorial: private boost::noncopyable {
   typedef std::function<boost::optional<linestring_type_fp>(const point_type_fp& start, const point_type_fp& end)> PathFinder;
   typedef std::function<boost::optional<linestring_type_fp>(const point_type_fp& start,
                                                             const point_type_fp& end,
-                                                            path_finding::SearchKey search_key)> PathFinderRingIndices;
+                                                            path_finding::SearchKey search_key,
+                                                            const boost::optional<path_finding::Deadline>& deadline)> PathFinderRingIndices;
 
   Surface_vectorial(unsigned int points_per_circle,
                     const box_type_fp& bounding_box,
                     std::string name, std::string outputdir, bool tsp_2opt,
                     MillFeedDirection::MillFeedDirection mill_feed_direction,
-                    bool invert_gerbers, bool render_paths_to_shapes);
-
-  std::vector<std::pair<coordinate_type_fp, multi_linestring_type_fp>> get_toolpath(
-      std::shared_ptr<RoutingMill> mill, bool mirror, bool ymirror);
-  void save_debug_image(std::string message);
+                    bool invert_gerbers, bool render_paths_to_shapes,
+                    coordinate_type_fp svg_resolution = 0);
+
+  // Called with each tool's diameter and paths to mill, in order, as
+  // soon as they are found.  tool_count is the number of tools in all.
+  typedef std::function<void(size_t tool_count, coordinate_type_fp tool_diameter,
+                             multi_linestring_type_fp toolpaths)> ToolpathDone;
+
+  void get_toolpath(std::shared_ptr<RoutingMill> mill, bool mirror, bool ymirror,
+                    const ToolpathDone& done);
+  // The index is the number in the filename, so that the images sort
+  // in the order that they were made.
+  void save_debug_image(std::string message, unsigned int index) const;
   void enable_filling();
   void add_mask(std::shared_ptr<Surface_vectorial> surface);
   // The importer provides the path.  The tolerance is used for
   // removing some of the finer detail in the path, to save time on
-  // processing.
-  void render(std::shared_ptr<GerberImporter> importer, double tolerance);
+  // processing.  If simplify_tolerance is more than 0, the shapes are
+  // instead simplified with simplify::simplify, which keeps traces from
+  // touching or swallowing each other.
+  void render(std::shared_ptr<GerberImporter> importer, double tolerance,
+              double simplify_tolerance = 0);
+  // The number of points in the shapes after each step so far, for
+  // reporting.
+  const std::vector<std::pair<std::string, size_t>>& get_point_counts() const {
+    return point_counts;
+  }
 
   inline coordinate_type_fp get_width_in() {
     return bounding_box.max_corner().x() - bounding_box.min_corner().x();
@@ -82,18 +99,20 @@ protected:
   const std::string name;
   const std::string outputdir;
   const bool tsp_2opt;
-  static unsigned int debug_image_index;
 
   bool fill;
   const MillFeedDirection::MillFeedDirection mill_feed_direction;
   const bool invert_gerbers;
   const bool render_paths_to_shapes;
+  // For simplifying the shapes in the debug images, 0 for none.
+  const coordinate_type_fp svg_resolution;
 
   std::shared_ptr<std::pair<multi_polygon_type_fp,
                       std::map<coordinate_type_fp, multi_linestring_type_fp>>>
       vectorial_surface;
   multi_polygon_type_fp voronoi;
   std::vector<polygon_type_fp> thermal_holes;
+  std::vector<std::pair<std::string, size_t>> point_counts;
 
 
   std::shared_ptr<Surface_vectorial> mask;
@@ -112,7 +131,8 @@ protected:
   std::vector<std::pair<linestring_type_fp, bool>> final_path_finder(
       const std::shared_ptr<RoutingMill>& mill,
       const path_finding::PathFindingSurface& path_finding_surface,
-      const std::vector<std::pair<linestring_type_fp, bool>>& paths) const;
+      const std::vector<std::pair<linestring_type_fp, bool>>& paths,
+      const boost::optional<path_finding::SearchBudget*>& budget) const;
   std::vector<multi_polygon_type_fp> offset_polygon(
       const boost::optional<polygon_type_fp>& input,
       const polygon_type_fp& voronoi,
@@ -123,7 +143,8 @@ protected:
   multi_linestring_type_fp post_process_toolpath(
       const std::shared_ptr<RoutingMill>& mill,
       const boost::optional<const path_finding::PathFindingSurface*>& path_finding_surface,
-      std::vector<std::pair<linestring_type_fp, bool>> toolpath) const;
+      std::vector<std::pair<linestring_type_fp, bool>> toolpath,
+      const boost::optional<path_finding::SearchBudget*>& budget = boost::none) const;
   void write_svgs(const std::string& tool_suffix, coordinate_type_fp tool_diameter,
                   const std::vector<std::vector<std::pair<linestring_type_fp, bool>>>& new_trace_toolpaths,
                   coordinate_type_fp tolerance, bool find_contentions) const;
@@ -1,6 +1,14 @@
 #include <string>
 #include <boost/format.hpp>
 #include <memory>
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
 #include "geometry.hpp"
 #include "bg_operators.hpp"
 #include "svg_writer.hpp"
@@ -8,11 +16,157 @@
 using std::string;
 using std::unique_ptr;
 using std::make_unique;
+using std::vector;
 
-svg_writer::svg_writer(string filename, box_type_fp bounding_box) :
-    output_file(filename),
-    bounding_box(bounding_box)
-{
+// The same sequence as glibc's rand() after srand(seed), so that the
+// colors don't change from what they have always been.
+class ColorGenerator {
+ public:
+  ColorGenerator() {
+    seed(1);
+  }
+  void seed(uint32_t seed) {
+    int32_t word = seed == 0 ? 1 : seed;
+    state[0] = word;
+    for (size_t i = 1; i < state_size; i++) {
+      const int32_t hi = word / 127773;
+      const int32_t lo = word % 127773;
+      word = 16807 * lo - 2836 * hi;
+      if (word < 0) {
+        word += 2147483647;
+      }
+      state[i] = word;
+    }
+    front = 3;
+    rear = 0;
+    for (size_t i = 0; i < state_size * 10; i++) {
+      next();
+    }
+  }
+  uint32_t next() {
+    const uint32_t value = state[front] + state[rear];
+    state[front] = value;
+    front = (front + 1) % state_size;
+    rear = (rear + 1) % state_size;
+    return value >> 1;
+  }
+
+ private:
+  static constexpr size_t state_size = 31;
+  uint32_t state[state_size];
+  size_t front;
+  size_t rear;
+};
+
+static ColorGenerator& color_generator() {
+  static thread_local ColorGenerator generator;
+  return generator;
+}
+
+void svg_writer::seed_colors(unsigned int seed) {
+  color_generator().seed(seed);
+}
+
+unsigned int svg_writer::random_color() {
+  return color_generator().next() % 256;
+}
+
+// Runs the jobs that write the images, in the order that they were
+// pushed.  There is a limit on how many can wait so that the shapes
+// in them don't use up too much memory.
+class ImageThread {
+ public:
+  static ImageThread& instance() {
+    static ImageThread image_thread;
+    return image_thread;
+  }
+  void push(std::function<void()> job) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return jobs.size() < max_jobs; });
+    jobs.push_back(std::move(job));
+    changed.notify_all();
+  }
+  void flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return jobs.empty() && !busy; });
+    if (exception) {
+      std::exception_ptr e = exception;
+      exception = nullptr;
+      std::rethrow_exception(e);
+    }
+  }
+  ~ImageThread() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      changed.notify_all();
+    }
+    worker.join();
+  }
+
+ private:
+  ImageThread() :
+      busy(false),
+      stopping(false),
+      worker(&ImageThread::run, this) {}
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      changed.wait(lock, [this]() { return !jobs.empty() || stopping; });
+      if (jobs.empty()) {
+        return; // Stopping and nothing left to write.
+      }
+      std::function<void()> job = std::move(jobs.front());
+      jobs.pop_front();
+      busy = true;
+      changed.notify_all(); // There's room for another job.
+      lock.unlock();
+      std::exception_ptr job_exception;
+      try {
+        job();
+      } catch (...) {
+        job_exception = std::current_exception();
+      }
+      job = nullptr; // Free the shapes before reporting that we're done.
+      lock.lock();
+      if (job_exception && !exception) {
+        exception = job_exception;
+      }
+      busy = false;
+      changed.notify_all();
+    }
+  }
+
+  static constexpr size_t max_jobs = 64;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::function<void()>> jobs;
+  bool busy;
+  bool stopping;
+  std::exception_ptr exception;
+  std::thread worker; // Last so that it starts after the rest is ready.
+};
+
+struct svg_writer::Image {
+  Image(const box_type_fp& bounding_box, coordinate_type_fp resolution) :
+      bounding_box(bounding_box),
+      resolution(resolution) {}
+  void open(const string& filename);
+  template <typename multi_polygon_type_t>
+  void add(multi_polygon_type_t& geometry, double opacity, bool stroke,
+           const vector<unsigned int>& colors);
+  void add(const linestring_type_fp& path, coordinate_type_fp width, unsigned int r, unsigned int g, unsigned int b);
+  void add(const vector<point_type_fp>& centers, coordinate_type_fp radius);
+  void close();
+
+  std::ofstream output_file;
+  const box_type_fp bounding_box;
+  const coordinate_type_fp resolution;
+  std::unique_ptr<bg::svg_mapper<point_type_fp> > mapper;
+};
+
+void svg_writer::Image::open(const string& filename) {
+    output_file.open(filename);
     const coordinate_type_fp width =
         (bounding_box.max_corner().x() - bounding_box.min_corner().x()) * SVG_PIX_PER_IN;
     const coordinate_type_fp height =
@@ -31,6 +185,26 @@ svg_writer::svg_writer(string filename, box_type_fp bounding_box) :
     mapper->add(bounding_box);
 }
 
+void svg_writer::Image::close() {
+  mapper.reset(); // This writes the end of the svg.
+  output_file.close();
+}
+
+svg_writer::svg_writer(string filename, box_type_fp bounding_box, coordinate_type_fp resolution) :
+    image(std::make_shared<Image>(bounding_box, resolution)) {
+  auto image = this->image;
+  ImageThread::instance().push([image, filename]() { image->open(filename); });
+}
+
+svg_writer::~svg_writer() {
+  auto image = this->image;
+  ImageThread::instance().push([image]() { image->close(); });
+}
+
+void svg_writer::flush() {
+  ImageThread::instance().flush();
+}
+
 void normalize(ring_type_fp& ring) {
   // Subtract 1 because the first and last of a ring are the same point.
   auto min = std::min_element(ring.begin(), ring.end()-1,
@@ -61,57 +235,104 @@ void normalize(multi_linestring_type_fp& mls) {
   std::sort(mls.begin(), mls.end());
 }
 
+template <typename geometry_t>
+geometry_t simplify(const geometry_t& geometry, coordinate_type_fp resolution) {
+  geometry_t simplified;
+  bg::simplify(geometry, simplified, resolution);
+  return simplified;
+}
+
 template <typename multi_polygon_type_t>
-void svg_writer::add(multi_polygon_type_t geometry, double opacity, bool stroke) {
+void svg_writer::Image::add(multi_polygon_type_t& geometry, double opacity, bool stroke,
+                            const vector<unsigned int>& colors) {
   // Sort the geometry so that we'll have fewer diffs.
   normalize(geometry);
   string stroke_str = stroke ? "stroke:rgb(0,0,0);stroke-width:2" : "";
 
-  for (const auto& poly : geometry) {
-    const unsigned int r = rand() % 256;
-    const unsigned int g = rand() % 256;
-    const unsigned int b = rand() % 256;
-
-    multi_polygon_type_t new_bounding_box;
-    bg::convert(bounding_box, new_bounding_box);
-
+  multi_polygon_type_t new_bounding_box;
+  bg::convert(bounding_box, new_bounding_box);
+  for (size_t i = 0; i < geometry.size(); i++) {
+    const auto& poly = resolution > 0 ? simplify(geometry[i], resolution) : geometry[i];
     mapper->map(poly & new_bounding_box,
                 str(boost::format("fill-opacity:%f;fill:rgb(%u,%u,%u);" + stroke_str) %
-                    opacity % r % g % b));
+                    opacity % colors[i*3] % colors[i*3+1] % colors[i*3+2]));
   }
 }
 
-template void svg_writer::add<multi_polygon_type_fp>(multi_polygon_type_fp, double, bool);
-
-void svg_writer::add(multi_linestring_type_fp mls, coordinate_type_fp width, bool stroke) {
-  // Sort the geometry so that we'll have fewer diffs.
-  normalize(mls);
-  string stroke_str = stroke ? "stroke:rgb(0,0,0);stroke-width:2" : "";
-
-  for (const auto& ls : mls) {
-    const unsigned int r = rand() % 256;
-    const unsigned int g = rand() % 256;
-    const unsigned int b = rand() % 256;
-
-    add(ls, width, r, g, b);
-  }
-}
-
-void svg_writer::add(const linestring_type_fp& path, coordinate_type_fp width, unsigned int r, unsigned int g, unsigned int b) {
+void svg_writer::Image::add(const linestring_type_fp& path, coordinate_type_fp width, unsigned int r, unsigned int g, unsigned int b) {
+  const auto& simplified_path = resolution > 0 ? simplify(path, resolution) : path;
   // Stroke the width of the path.
-  mapper->map(path,
+  mapper->map(simplified_path,
               str(boost::format("stroke:rgb(%u,%u,%u);stroke-width:%f;fill:none;"
                                 "stroke-opacity:0.5;stroke-linecap:round;stroke-linejoin:round;") % r % g % b % (width * SVG_DOTS_PER_IN)));
   // Stroke the center of the path.
-  mapper->map(path,
+  mapper->map(simplified_path,
               "stroke:rgb(0,0,0);stroke-width:1px;fill:none;"
               "stroke-opacity:1;stroke-linecap:round;stroke-linejoin:round;");
 }
 
-void svg_writer::add(multi_linestring_type_fp path, coordinate_type_fp width, unsigned int r, unsigned int g, unsigned int b) {
-  // Sort the geometry so that we'll have fewer diffs.
-  normalize(path);
-  for (const auto& p : path) {
-    add(p, width, r, g, b);
+void svg_writer::Image::add(const vector<point_type_fp>& centers, coordinate_type_fp radius) {
+  for (const auto& center : centers) {
+    mapper->map(center, "", radius * SVG_DOTS_PER_IN);
+  }
+}
+
+// The colors are picked here, on the caller's thread, so that they
+// come out the same no matter when the image is written.
+template <typename multi_polygon_type_t>
+void svg_writer::add(multi_polygon_type_t geometry, double opacity, bool stroke) {
+  vector<unsigned int> colors;
+  colors.reserve(geometry.size() * 3);
+  for (size_t i = 0; i < geometry.size() * 3; i++) {
+    colors.push_back(random_color());
   }
+  auto image = this->image;
+  ImageThread::instance().push(
+      [image, geometry = std::move(geometry), opacity, stroke, colors = std::move(colors)]() mutable {
+        image->add(geometry, opacity, stroke, colors);
+      });
+}
+
+template void svg_writer::add<multi_polygon_type_fp>(multi_polygon_type_fp, double, bool);
+
+void svg_writer::add(multi_linestring_type_fp mls, coordinate_type_fp width, bool) {
+  vector<unsigned int> colors;
+  colors.reserve(mls.size() * 3);
+  for (size_t i = 0; i < mls.size() * 3; i++) {
+    colors.push_back(random_color());
+  }
+  auto image = this->image;
+  ImageThread::instance().push(
+      [image, mls = std::move(mls), width, colors = std::move(colors)]() mutable {
+        // Sort the geometry so that we'll have fewer diffs.
+        normalize(mls);
+        for (size_t i = 0; i < mls.size(); i++) {
+          image->add(mls[i], width, colors[i*3], colors[i*3+1], colors[i*3+2]);
+        }
+      });
+}
+
+void svg_writer::add(linestring_type_fp path, coordinate_type_fp width, unsigned int r, unsigned int g, unsigned int b) {
+  auto image = this->image;
+  ImageThread::instance().push([image, path = std::move(path), width, r, g, b]() {
+      image->add(path, width, r, g, b);
+    });
+}
+
+void svg_writer::add(multi_linestring_type_fp paths, coordinate_type_fp width, unsigned int r, unsigned int g, unsigned int b) {
+  auto image = this->image;
+  ImageThread::instance().push([image, paths = std::move(paths), width, r, g, b]() mutable {
+      // Sort the geometry so that we'll have fewer diffs.
+      normalize(paths);
+      for (const auto& p : paths) {
+        image->add(p, width, r, g, b);
+      }
+    });
+}
+
+void svg_writer::add(vector<point_type_fp> centers, coordinate_type_fp radius) {
+  auto image = this->image;
+  ImageThread::instance().push([image, centers = std::move(centers), radius]() {
+      image->add(centers, radius);
+    });
 }
@@ -2,20 +2,42 @@
 #define SVG_WRITER_HPP
 
 #include <fstream>
+#include <memory>
+#include <vector>
 
+// The images are written by a background thread so that making them
+// doesn't slow down the processing.  The shapes are handed to that
+// thread when they are added and the file is complete after the
+// svg_writer is destroyed and flush() is called.
 class svg_writer {
  public:
-  svg_writer(std::string filename, box_type_fp bounding_box);
+  // If resolution is more than 0, the shapes are simplified to that
+  // resolution, which makes the images smaller and faster to write.
+  svg_writer(std::string filename, box_type_fp bounding_box, coordinate_type_fp resolution = 0);
+  svg_writer(const svg_writer&) = delete;
+  svg_writer& operator=(const svg_writer&) = delete;
+  ~svg_writer();
   template <typename multi_polygon_type_t>
   void add(multi_polygon_type_t geometry, double opacity, bool stroke);
   void add(multi_linestring_type_fp mls, coordinate_type_fp width, bool stroke);
-  void add(const linestring_type_fp& path, coordinate_type_fp width, unsigned int r, unsigned int g, unsigned int b);
+  void add(linestring_type_fp path, coordinate_type_fp width, unsigned int r, unsigned int g, unsigned int b);
   void add(multi_linestring_type_fp paths, coordinate_type_fp width, unsigned int r, unsigned int g, unsigned int b);
+  // Black circles of the given radius.
+  void add(std::vector<point_type_fp> centers, coordinate_type_fp radius);
+
+  // The colors of the shapes are random but they must be the same on
+  // every run, even when images are made on many threads at once.
+  // These work like srand and rand() % 256, with state per thread.
+  static void seed_colors(unsigned int seed);
+  static unsigned int random_color();
+
+  // Wait for all the images so far to be written.  If writing one of
+  // them threw an exception, it is rethrown here.
+  static void flush();
 
  protected:
-  std::ofstream output_file;
-  const box_type_fp bounding_box;
-  std::unique_ptr<bg::svg_mapper<point_type_fp> > mapper;
+  struct Image;
+  std::shared_ptr<Image> image;
 };
 
 #endif //SVG_WRITER_HPP
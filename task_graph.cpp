@@ -0,0 +1,141 @@
+#include <algorithm>
+using std::max;
+using std::min;
+
+#include <condition_variable>
+using std::condition_variable;
+
+#include <functional>
+using std::function;
+
+#include <mutex>
+using std::mutex;
+using std::unique_lock;
+
+#include <queue>
+using std::priority_queue;
+
+#include <stdexcept>
+
+#include <thread>
+using std::thread;
+
+#include <vector>
+using std::vector;
+
+#include "task_graph.hpp"
+
+TaskGraph::TaskId TaskGraph::add(function<void()> function,
+                                 const vector<TaskId>& dependencies) {
+  const TaskId task_id = tasks.size();
+  for (const auto& dependency : dependencies) {
+    if (dependency >= task_id) {
+      throw std::logic_error("A task can only depend on tasks that were added before it.");
+    }
+  }
+  tasks.push_back({function, {}, dependencies.size(), false, nullptr});
+  for (const auto& dependency : dependencies) {
+    tasks[dependency].dependents.push_back(task_id);
+  }
+  return task_id;
+}
+
+void TaskGraph::run(unsigned int threads) {
+  if (threads == 0) {
+    threads = max(thread::hardware_concurrency(), 1U);
+  }
+  if (threads == 1 || tasks.size() < 2) {
+    run_serial();
+  } else {
+    run_parallel(min(size_t(threads), tasks.size()));
+  }
+  std::exception_ptr first_exception;
+  for (const auto& task : tasks) {
+    if (task.exception) {
+      first_exception = task.exception;
+      break;
+    }
+  }
+  tasks.clear();
+  if (first_exception) {
+    std::rethrow_exception(first_exception);
+  }
+}
+
+void TaskGraph::execute(TaskId task_id) {
+  auto& task = tasks[task_id];
+  if (task.skip) {
+    return;
+  }
+  try {
+    task.function();
+  } catch (...) {
+    task.exception = std::current_exception();
+  }
+}
+
+void TaskGraph::run_serial() {
+  // Dependencies are always added before their dependents so this
+  // order is always valid.
+  for (TaskId task_id = 0; task_id < tasks.size(); task_id++) {
+    execute(task_id);
+    const auto& task = tasks[task_id];
+    if (task.skip || task.exception) {
+      for (const auto& dependent : task.dependents) {
+        tasks[dependent].skip = true;
+      }
+    }
+  }
+}
+
+void TaskGraph::run_parallel(unsigned int threads) {
+  mutex tasks_mutex;
+  condition_variable tasks_changed;
+  // Among the tasks that are ready, the earliest added runs first.
+  priority_queue<TaskId, vector<TaskId>, std::greater<TaskId>> ready;
+  vector<size_t> remaining_dependencies(tasks.size());
+  for (TaskId task_id = 0; task_id < tasks.size(); task_id++) {
+    remaining_dependencies[task_id] = tasks[task_id].dependency_count;
+    if (remaining_dependencies[task_id] == 0) {
+      ready.push(task_id);
+    }
+  }
+  size_t unfinished = tasks.size();
+
+  auto worker = [&]() {
+    unique_lock<mutex> lock(tasks_mutex);
+    while (true) {
+      tasks_changed.wait(lock, [&]() { return !ready.empty() || unfinished == 0; });
+      if (unfinished == 0) {
+        return;
+      }
+      const TaskId task_id = ready.top();
+      ready.pop();
+      lock.unlock();
+      execute(task_id);
+      lock.lock();
+      const auto& task = tasks[task_id];
+      for (const auto& dependent : task.dependents) {
+        if (task.skip || task.exception) {
+          tasks[dependent].skip = true;
+        }
+        remaining_dependencies[dependent]--;
+        if (remaining_dependencies[dependent] == 0) {
+          ready.push(dependent);
+        }
+      }
+      unfinished--;
+      tasks_changed.notify_all();
+    }
+  };
+
+  // The calling thread is one of the workers.
+  vector<thread> workers;
+  for (unsigned int i = 1; i < threads; i++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& w : workers) {
+    w.join();
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef TASK_GRAPH_HPP
+#define TASK_GRAPH_HPP
+
+#include <exception>
+#include <functional>
+#include <vector>
+
+// A list of tasks, each of which may depend on tasks added before it.
+// When run, each task starts only after all the tasks that it depends
+// on are done.  Tasks that don't depend on one another may run at the
+// same time on different threads.
+class TaskGraph {
+ public:
+  typedef size_t TaskId;
+
+  // Add a task that will run after all of the dependencies.  The
+  // dependencies must be tasks that were already added.
+  TaskId add(std::function<void()> function,
+             const std::vector<TaskId>& dependencies = {});
+  // Run all the tasks on up to threads threads and wait for them to
+  // finish.  0 threads means one per CPU core.  With 1 thread, the
+  // tasks run in the order in which they were added.  If a task
+  // throws, the tasks that depend on it are skipped and, once all the
+  // others are done, the exception of the earliest added task that
+  // threw is rethrown.  The tasks are cleared afterwards.
+  void run(unsigned int threads);
+  size_t size() const { return tasks.size(); }
+
+ private:
+  struct Task {
+    std::function<void()> function;
+    std::vector<TaskId> dependents;
+    size_t dependency_count;
+    bool skip;
+    std::exception_ptr exception;
+  };
+  // Run the task unless it is skipped and store any exception.
+  void execute(TaskId task_id);
+  void run_serial();
+  void run_parallel(unsigned int threads);
+
+  std::vector<Task> tasks;
+};
+
+#endif //TASK_GRAPH_HPP
@@ -0,0 +1,96 @@
+#define BOOST_TEST_MODULE task graph tests
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "task_graph.hpp"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(task_graph_tests)
+
+BOOST_AUTO_TEST_CASE(serial_order) {
+  TaskGraph tasks;
+  vector<int> order;
+  auto a = tasks.add([&]() { order.push_back(0); });
+  tasks.add([&]() { order.push_back(1); });
+  tasks.add([&]() { order.push_back(2); }, {a});
+  tasks.add([&]() { order.push_back(3); });
+  BOOST_CHECK_EQUAL(tasks.size(), 4UL);
+  tasks.run(1);
+  BOOST_CHECK(order == vector<int>({0, 1, 2, 3}));
+  BOOST_CHECK_EQUAL(tasks.size(), 0UL);
+}
+
+BOOST_AUTO_TEST_CASE(dependencies) {
+  for (unsigned int threads = 0; threads < 5; threads++) {
+    TaskGraph tasks;
+    mutex order_mutex;
+    vector<int> order;
+    auto log = [&](int x) {
+      return [&, x]() {
+        lock_guard<mutex> lock(order_mutex);
+        order.push_back(x);
+      };
+    };
+    // A diamond followed by a chain.
+    auto top = tasks.add(log(0));
+    auto left = tasks.add(log(1), {top});
+    auto right = tasks.add(log(2), {top});
+    auto bottom = tasks.add(log(3), {left, right});
+    auto next = tasks.add(log(4), {bottom});
+    tasks.add(log(5), {next});
+    tasks.run(threads);
+    BOOST_REQUIRE_EQUAL(order.size(), 6UL);
+    BOOST_CHECK_EQUAL(order[0], 0);
+    BOOST_CHECK((order[1] == 1 && order[2] == 2) || (order[1] == 2 && order[2] == 1));
+    BOOST_CHECK_EQUAL(order[3], 3);
+    BOOST_CHECK_EQUAL(order[4], 4);
+    BOOST_CHECK_EQUAL(order[5], 5);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(many_tasks) {
+  TaskGraph tasks;
+  atomic<int> sum(0);
+  vector<TaskGraph::TaskId> ids;
+  for (int i = 0; i < 1000; i++) {
+    if (i < 10) {
+      ids.push_back(tasks.add([&sum, i]() { sum += i; }));
+    } else {
+      ids.push_back(tasks.add([&sum, i]() { sum += i; }, {ids[i-10], ids[i/2]}));
+    }
+  }
+  tasks.run(4);
+  BOOST_CHECK_EQUAL(sum, 999*1000/2);
+}
+
+BOOST_AUTO_TEST_CASE(exceptions) {
+  for (unsigned int threads = 1; threads < 4; threads++) {
+    TaskGraph tasks;
+    atomic<int> ran(0);
+    auto a = tasks.add([]() { throw std::runtime_error("first"); });
+    auto b = tasks.add([&]() { ran++; }, {a});
+    tasks.add([&]() { ran++; }, {b});
+    tasks.add([&]() { ran++; });
+    tasks.add([]() { throw std::runtime_error("second"); });
+    try {
+      tasks.run(threads);
+      BOOST_FAIL("Expected an exception");
+    } catch (const std::runtime_error& e) {
+      BOOST_CHECK_EQUAL(e.what(), "first");
+    }
+    // Only the independent task ran.
+    BOOST_CHECK_EQUAL(ran, 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(bad_dependency) {
+  TaskGraph tasks;
+  BOOST_CHECK_THROW(tasks.add([]() {}, {0}), std::logic_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -19,6 +19,7 @@
  
 #include "tile.hpp"
 
+#include <cmath>
 #include <iostream>
 
 #include <boost/format.hpp>
@@ -27,7 +28,7 @@ using boost::format;
 #include "units.hpp"
 
 Tiling::Tiling( TileInfo tileInfo, double cfactor, int tileVar ) :
-    tileInfo( tileInfo ), cfactor( cfactor ), tileVar(tileVar) {}
+    tileInfo( tileInfo ), cfactor( cfactor ), tileVar(tileVar), byColumns( false ) {}
 
 void Tiling::header( std::ofstream &of )
 {
@@ -84,22 +85,67 @@ void Tiling::tileSequence( std::ofstream &of )
     const char *setX0[] = { "G92 X[#5420-[%1$f]]", "G00 X%1$f\nG92 X0", "G00 X%1$f\nG92 X0" };
     const char *setY0[] = { "G92 Y[#5421-[%1$f]]", "G00 Y%1$f\nG92 Y0", "G00 Y%1$f\nG92 Y0" };
 
-    for( unsigned int i = 0; i < tileInfo.tileY; i++ )
+    // The same serpentine for rows and columns, with X and Y swapped.
+    const char **setStep = byColumns ? setY0 : setX0;
+    const char **setLine = byColumns ? setX0 : setY0;
+    const double stepLength = byColumns ? tileInfo.boardHeight : tileInfo.boardWidth;
+    const double lineLength = byColumns ? tileInfo.boardWidth : tileInfo.boardHeight;
+    const unsigned int stepNum = byColumns ? tileInfo.tileY : tileInfo.tileX;
+    const unsigned int lineNum = byColumns ? tileInfo.tileX : tileInfo.tileY;
+
+    for( unsigned int i = 0; i < lineNum; i++ )
     {
         of << ( format( callSub[tileInfo.software] ) % tileVar ) << "\n";
-        for( unsigned int j = 0; j < tileInfo.tileX - 1; j++ )
+        for( unsigned int j = 0; j < stepNum - 1; j++ )
         {
-            of << ( format( setX0[tileInfo.software] ) %
-                  ( i % 2 == 0 ? tileInfo.boardWidth * cfactor : -tileInfo.boardWidth * cfactor ) ) << "\n";
+            of << ( format( setStep[tileInfo.software] ) %
+                  ( i % 2 == 0 ? stepLength * cfactor : -stepLength * cfactor ) ) << "\n";
             of << ( format( callSub[tileInfo.software] ) % tileVar ) << "\n";
         }
-        if( i < tileInfo.tileY - 1 )
-           of << str( format( setY0[tileInfo.software] ) % ( tileInfo.boardHeight * cfactor ) ) << "\n";
+        if( i < lineNum - 1 )
+           of << str( format( setLine[tileInfo.software] ) % ( lineLength * cfactor ) ) << "\n";
     }
 
-    of << ( format( setY0[tileInfo.software] ) % ( -tileInfo.boardHeight * cfactor * ( tileInfo.tileY - 1 ) ) ) << "\n";
-    if( tileInfo.tileY % 2 )
-        of << ( format( setX0[tileInfo.software] ) % ( -tileInfo.boardWidth * cfactor * ( tileInfo.tileX - 1 ) ) ) << "\n";
+    of << ( format( setLine[tileInfo.software] ) % ( -lineLength * cfactor * ( lineNum - 1 ) ) ) << "\n";
+    if( lineNum % 2 )
+        of << ( format( setStep[tileInfo.software] ) % ( -stepLength * cfactor * ( stepNum - 1 ) ) ) << "\n";
+}
+
+std::pair<unsigned int, unsigned int> Tiling::tile( unsigned int i, unsigned int j ) const
+{
+    const unsigned int step = i % 2 ? steps() - j - 1 : j;
+    return byColumns ? std::make_pair( i, step ) : std::make_pair( step, i );
+}
+
+double Tiling::rapidsLength( bool columns, const point_type_fp& start, const point_type_fp& end ) const
+{
+    // From the end of one tile to the start of the next one, which is
+    // moved by one tile along the line or to the next line.
+    const auto rapid = [&]( double dx, double dy ) {
+        return std::hypot( start.x() + dx - end.x(), start.y() + dy - end.y() );
+    };
+    const double stepX = columns ? 0 : tileInfo.boardWidth;
+    const double stepY = columns ? tileInfo.boardHeight : 0;
+    const double lineX = columns ? tileInfo.boardWidth : 0;
+    const double lineY = columns ? 0 : tileInfo.boardHeight;
+    const unsigned int stepNum = columns ? tileInfo.tileY : tileInfo.tileX;
+    const unsigned int lineNum = columns ? tileInfo.tileX : tileInfo.tileY;
+
+    double length = 0;
+    for( unsigned int i = 0; i < lineNum; i++ )
+    {
+        const double sign = i % 2 ? -1 : 1;
+        length += ( stepNum - 1 ) * rapid( sign * stepX, sign * stepY );
+        if( i < lineNum - 1 )
+            length += rapid( lineX, lineY );
+    }
+    return length;
+}
+
+void Tiling::optimiseOrder( const point_type_fp& start, const point_type_fp& end )
+{
+    if( tileInfo.enabled && tileInfo.optimiseOrder )
+        byColumns = rapidsLength( true, start, end ) < rapidsLength( false, start, end );
 }
 
 Tiling::TileInfo Tiling::generateTileInfo( const boost::program_options::variables_map& options,
@@ -112,6 +158,7 @@ Tiling::TileInfo Tiling::generateTileInfo( const boost::program_options::variabl
     tileInfo.tileY = options["tile-y"].as<int>();
     tileInfo.boardHeight = boardHeight;
     tileInfo.boardWidth = boardWidth;
+    tileInfo.optimiseOrder = options["optimise-tile-order"].as<bool>();
 
     if( !options.count("software") ) {
         tileInfo.software = Software::CUSTOM;
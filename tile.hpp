@@ -21,6 +21,7 @@
 #define TILE_H
 
 #include <fstream>
+#include <utility>
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string.hpp>
 
@@ -41,6 +42,7 @@ public:
         coordinate_type_fp boardHeight;
         unsigned int forXNum;
         unsigned int forYNum;
+        bool optimiseOrder;
     };
 
     Tiling( TileInfo tileInfo, double cfactor, int tilevar );
@@ -59,13 +61,37 @@ public:
         return gCodeEnd;
     }
 
+    // The tiles are milled in a serpentine, line by line: a line is a row
+    // of tiles unless the order was changed to columns.  These are the
+    // number of lines and the number of tiles in each line that the
+    // exporter writes out itself, which is all of them only for custom.
+    inline unsigned int lines() const
+    {
+        return byColumns ? tileInfo.forXNum : tileInfo.forYNum;
+    }
+
+    inline unsigned int steps() const
+    {
+        return byColumns ? tileInfo.forYNum : tileInfo.forXNum;
+    }
+
+    // The [column, row] of the tile at step j of line i.
+    std::pair<unsigned int, unsigned int> tile( unsigned int i, unsigned int j ) const;
+
+    // If optimiseOrder is set, choose to go row by row or column by column,
+    // whichever has the shorter rapid moves between the tiles.  start and
+    // end are where the milling of the first tile starts and ends.
+    void optimiseOrder( const point_type_fp& start, const point_type_fp& end );
+
     const TileInfo tileInfo;
     const double cfactor;
     const int tileVar;
 private:
     void tileSequence( std::ofstream &of );
+    double rapidsLength( bool columns, const point_type_fp& start, const point_type_fp& end ) const;
     
     std::string gCodeEnd;
+    bool byColumns;
 };
 
 #endif // TILE_H
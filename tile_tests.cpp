@@ -0,0 +1,120 @@
+#define BOOST_TEST_MODULE tile tests
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "geometry.hpp"
+#include "tile.hpp"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(tile_tests)
+
+Tiling::TileInfo tile_info(Software::Software software, unsigned int tileX, unsigned int tileY,
+                           double boardWidth, double boardHeight, bool optimiseOrder) {
+  const bool custom = software == Software::CUSTOM;
+  return Tiling::TileInfo{software, true, tileX, tileY, boardWidth, boardHeight,
+                          custom ? tileX : 1, custom ? tileY : 1, optimiseOrder};
+}
+
+vector<pair<unsigned int, unsigned int>> order(const Tiling& tiling) {
+  vector<pair<unsigned int, unsigned int>> tiles;
+  for (unsigned int i = 0; i < tiling.lines(); i++) {
+    for (unsigned int j = 0; j < tiling.steps(); j++) {
+      tiles.push_back(tiling.tile(i, j));
+    }
+  }
+  return tiles;
+}
+
+// What header and footer write around the milling.
+string header_and_footer(Tiling& tiling) {
+  const string filename = "tile_tests.ngc";
+  {
+    ofstream of(filename);
+    tiling.header(of);
+    of << "( tile )\n";
+    tiling.footer(of);
+  }
+  ifstream in(filename);
+  stringstream text;
+  text << in.rdbuf();
+  in.close();
+  remove(filename.c_str());
+  return text.str();
+}
+
+BOOST_AUTO_TEST_CASE(rows) {
+  Tiling tiling(tile_info(Software::CUSTOM, 3, 2, 10, 1, false), 1, 0);
+  // Even if the columns would be shorter, optimiseOrder is off.
+  tiling.optimiseOrder(point_type_fp(0, 0), point_type_fp(0, 0));
+  const vector<pair<unsigned int, unsigned int>> expected{{0, 0}, {1, 0}, {2, 0}, {2, 1}, {1, 1}, {0, 1}};
+  BOOST_CHECK(order(tiling) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(columns) {
+  // Wide and short boards in 2 columns of 5 are faster column by column.
+  Tiling tiling(tile_info(Software::CUSTOM, 2, 5, 10, 1, true), 1, 0);
+  tiling.optimiseOrder(point_type_fp(0, 0), point_type_fp(0, 0));
+  const vector<pair<unsigned int, unsigned int>> expected{
+    {0, 0}, {0, 1}, {0, 2}, {0, 3}, {0, 4}, {1, 4}, {1, 3}, {1, 2}, {1, 1}, {1, 0}};
+  BOOST_CHECK(order(tiling) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(start_and_end) {
+  // Tall boards are faster by rows unless the milling ends at the top of
+  // each tile, next to the start of the tile above.
+  Tiling tiling(tile_info(Software::CUSTOM, 3, 3, 1, 10, true), 1, 0);
+  tiling.optimiseOrder(point_type_fp(0, 0), point_type_fp(0, 0));
+  BOOST_CHECK_EQUAL(tiling.lines(), 3U);
+  BOOST_CHECK(tiling.tile(0, 1) == make_pair(1U, 0U));
+  tiling.optimiseOrder(point_type_fp(0.5, 0), point_type_fp(0.5, 10));
+  BOOST_CHECK(tiling.tile(0, 1) == make_pair(0U, 1U));
+}
+
+BOOST_AUTO_TEST_CASE(linuxcnc_rows) {
+  Tiling tiling(tile_info(Software::LINUXCNC, 2, 2, 10, 1, false), 1, 7);
+  BOOST_CHECK_EQUAL(tiling.lines(), 1U);
+  BOOST_CHECK_EQUAL(tiling.steps(), 1U);
+  BOOST_CHECK_EQUAL(header_and_footer(tiling),
+                    "\no7 sub ( Main subroutine )\n\n"
+                    "( tile )\n"
+                    "\no7 endsub\n\n"
+                    "o7 call\n"
+                    "G92 X[#5420-[10.000000]]\n"
+                    "o7 call\n"
+                    "G92 Y[#5421-[1.000000]]\n"
+                    "o7 call\n"
+                    "G92 X[#5420-[-10.000000]]\n"
+                    "o7 call\n"
+                    "G92 Y[#5421-[-1.000000]]\n");
+}
+
+BOOST_AUTO_TEST_CASE(mach3_columns) {
+  Tiling tiling(tile_info(Software::MACH3, 3, 2, 10, 1, true), 1, 7);
+  tiling.optimiseOrder(point_type_fp(0, 0), point_type_fp(0, 0));
+  BOOST_CHECK_EQUAL(header_and_footer(tiling),
+                    "M98 P7\n"
+                    "G00 Y1.000000\nG92 Y0\n"
+                    "M98 P7\n"
+                    "G00 X10.000000\nG92 X0\n"
+                    "M98 P7\n"
+                    "G00 Y-1.000000\nG92 Y0\n"
+                    "M98 P7\n"
+                    "G00 X10.000000\nG92 X0\n"
+                    "M98 P7\n"
+                    "G00 Y1.000000\nG92 Y0\n"
+                    "M98 P7\n"
+                    "G00 X-20.000000\nG92 X0\n"
+                    "G00 Y-1.000000\nG92 Y0\n"
+                    "\nO7 ( Main subroutine )\n\n"
+                    "( tile )\n"
+                    "\nM99\n\n");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
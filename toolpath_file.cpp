@@ -0,0 +1,200 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include "toolpath_file.hpp"
+
+using std::string;
+
+namespace toolpath_file {
+
+namespace {
+
+// Change the version when the file format changes so that old files
+// aren't used.
+const char MAGIC[32] = "pcb2gcode toolpaths";
+const uint32_t VERSION = 2;
+const uint32_t ENDIANNESS_CHECK = 0x01020304;
+
+template <typename T>
+void write(string& out, const T& value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void write(string& out, const string& text) {
+  write(out, uint64_t(text.size()));
+  out.append(text);
+  out.append((8 - text.size() % 8) % 8, '\0');
+}
+
+void write(string& out, const linestring_type_fp& path) {
+  write(out, uint64_t(path.size()));
+  for (const auto& point : path) {
+    write(out, point.x());
+    write(out, point.y());
+  }
+}
+
+void write(string& out, const LayerToolpaths& layer) {
+  write(out, layer.name);
+  write(out, uint64_t(layer.backside));
+  write(out, uint64_t(layer.tool_diameters.size()));
+  for (const auto& diameter : layer.tool_diameters) {
+    write(out, diameter);
+  }
+  write(out, uint64_t(layer.toolpaths.size()));
+  for (const auto& tool : layer.toolpaths) {
+    write(out, tool.first);
+    write(out, uint64_t(tool.second.size()));
+    for (const auto& path : tool.second) {
+      write(out, path);
+    }
+  }
+  write(out, uint64_t(layer.bridges.size()));
+  for (const auto& bridges : layer.bridges) {
+    write(out, uint64_t(bridges.size()));
+    for (const auto& bridge : bridges) {
+      write(out, uint64_t(bridge));
+    }
+  }
+}
+
+// Reads values written by write() and throws if there aren't enough
+// bytes for them.
+class Reader {
+ public:
+  Reader(const string& in, const string& filename, size_t position) :
+      in(in), filename(filename), position(position) {}
+  template <typename T>
+  T read() {
+    T value;
+    if (in.size() - position < sizeof(value)) {
+      damaged();
+    }
+    std::memcpy(&value, in.data() + position, sizeof(value));
+    position += sizeof(value);
+    return value;
+  }
+  // A count of items that are each at least item_size bytes, so that a
+  // damaged file can't make a huge allocation.
+  size_t read_count(size_t item_size) {
+    const uint64_t count = read<uint64_t>();
+    if (count > (in.size() - position) / item_size) {
+      damaged();
+    }
+    return count;
+  }
+  void read(string& text) {
+    const size_t size = read_count(1);
+    const size_t padded = size + (8 - size % 8) % 8;
+    if (in.size() - position < padded) {
+      damaged();
+    }
+    text.assign(in, position, size);
+    position += padded;
+  }
+  void read(linestring_type_fp& path) {
+    path.resize(read_count(2 * sizeof(coordinate_type_fp)));
+    for (auto& point : path) {
+      const auto x = read<coordinate_type_fp>();
+      const auto y = read<coordinate_type_fp>();
+      point = point_type_fp(x, y);
+    }
+  }
+  void read(LayerToolpaths& layer) {
+    read(layer.name);
+    layer.backside = read<uint64_t>() != 0;
+    layer.tool_diameters.resize(read_count(sizeof(coordinate_type_fp)));
+    for (auto& diameter : layer.tool_diameters) {
+      diameter = read<coordinate_type_fp>();
+    }
+    layer.toolpaths.resize(read_count(sizeof(coordinate_type_fp) + sizeof(uint64_t)));
+    for (auto& tool : layer.toolpaths) {
+      tool.first = read<coordinate_type_fp>();
+      tool.second.resize(read_count(sizeof(uint64_t)));
+      for (auto& path : tool.second) {
+        read(path);
+      }
+    }
+    layer.bridges.resize(read_count(sizeof(uint64_t)));
+    for (auto& bridges : layer.bridges) {
+      bridges.resize(read_count(sizeof(uint64_t)));
+      for (auto& bridge : bridges) {
+        bridge = read<uint64_t>();
+      }
+    }
+  }
+  void done() {
+    if (position != in.size()) {
+      damaged();
+    }
+  }
+  [[noreturn]] void damaged() const {
+    throw std::invalid_argument("The toolpaths file is damaged: " + filename);
+  }
+
+ private:
+  const string& in;
+  const string& filename;
+  size_t position;
+};
+
+} // namespace
+
+void save(const string& filename, const Toolpaths& toolpaths) {
+  string contents(MAGIC, sizeof(MAGIC));
+  write(contents, VERSION);
+  write(contents, ENDIANNESS_CHECK);
+  write(contents, toolpaths.bounding_box.min_corner().x());
+  write(contents, toolpaths.bounding_box.min_corner().y());
+  write(contents, toolpaths.bounding_box.max_corner().x());
+  write(contents, toolpaths.bounding_box.max_corner().y());
+  write(contents, toolpaths.mirror_axis);
+  write(contents, uint32_t(toolpaths.mirror_yaxis));
+  write(contents, uint32_t(toolpaths.mirror_absolute));
+  write(contents, uint64_t(toolpaths.layers.size()));
+  for (const auto& layer : toolpaths.layers) {
+    write(contents, layer);
+  }
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  file.write(contents.data(), contents.size());
+  if (!file) {
+    throw std::invalid_argument("Can't write the toolpaths file: " + filename);
+  }
+}
+
+Toolpaths load(const string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    throw std::invalid_argument("Can't read the toolpaths file: " + filename);
+  }
+  const string contents{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  if (contents.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::invalid_argument("Not a toolpaths file: " + filename);
+  }
+  Reader reader(contents, filename, sizeof(MAGIC));
+  if (reader.read<uint32_t>() != VERSION || reader.read<uint32_t>() != ENDIANNESS_CHECK) {
+    throw std::invalid_argument("The toolpaths file is from a different version of pcb2gcode "
+                                "or a different kind of machine: " + filename);
+  }
+  Toolpaths toolpaths;
+  const auto min_x = reader.read<coordinate_type_fp>();
+  const auto min_y = reader.read<coordinate_type_fp>();
+  const auto max_x = reader.read<coordinate_type_fp>();
+  const auto max_y = reader.read<coordinate_type_fp>();
+  toolpaths.bounding_box = box_type_fp(point_type_fp(min_x, min_y), point_type_fp(max_x, max_y));
+  toolpaths.mirror_axis = reader.read<coordinate_type_fp>();
+  toolpaths.mirror_yaxis = reader.read<uint32_t>() != 0;
+  toolpaths.mirror_absolute = reader.read<uint32_t>() != 0;
+  toolpaths.layers.resize(reader.read_count(5 * sizeof(uint64_t)));
+  for (auto& layer : toolpaths.layers) {
+    reader.read(layer);
+  }
+  reader.done();
+  return toolpaths;
+}
+
+} // namespace toolpath_file
@@ -0,0 +1,68 @@
+#ifndef TOOLPATH_FILE_HPP
+#define TOOLPATH_FILE_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "geometry.hpp"
+
+// The toolpaths of each layer, saved to a file so that a later run can
+// write the G-code again with different feeds, heights or offsets
+// without importing the gerbers and finding the toolpaths.
+//
+// The file is a header followed by the layers.  Everything is 8 bytes
+// or padded to 8 bytes, in the byte order of the machine that wrote it,
+// so a file can be used in place if it is mapped into memory:
+//
+//   char[32]  "pcb2gcode toolpaths", zero padded
+//   uint32    version, uint32 0x01020304 to check the byte order
+//   double[4] the board's bounding box: min x, min y, max x, max y
+//   double    the mirror axis
+//   uint32    1 if mirrored about the y axis, uint32 1 if mirror absolute
+//   uint64    number of layers, then for each layer:
+//     uint64 name length, the name, zero padded
+//     uint64 1 if the layer is mirrored, as for the back side
+//     uint64 number of tool diameters, then each diameter as a double
+//     uint64 number of tools, then for each tool:
+//       double diameter, uint64 number of paths, then for each path:
+//         uint64 number of points, then x and y of each point as doubles
+//     uint64 number of paths with bridges, then for each path:
+//       uint64 number of bridges, then the index of each as a uint64
+namespace toolpath_file {
+
+struct LayerToolpaths {
+  std::string name;
+  // Whether the layer was mirrored, which is true for the back side.
+  bool backside;
+  // The diameters of the tools that the layer was to be milled with,
+  // in inches.  There might be fewer toolpaths if some aren't needed.
+  std::vector<coordinate_type_fp> tool_diameters;
+  // For each tool, its diameter and the paths milled with it.
+  std::vector<std::pair<coordinate_type_fp, multi_linestring_type_fp>> toolpaths;
+  // The bridges of each path of the first tool, as returned by
+  // Layer::get_bridges, and empty if the layer has no bridges.
+  std::vector<std::vector<size_t>> bridges;
+};
+
+struct Toolpaths {
+  box_type_fp bounding_box;
+  // The --mirror-axis in inches, --mirror-yaxis and --mirror-absolute
+  // that the toolpaths were made with.
+  coordinate_type_fp mirror_axis;
+  bool mirror_yaxis;
+  bool mirror_absolute;
+  std::vector<LayerToolpaths> layers;
+};
+
+// Throws std::invalid_argument if the file can't be written.
+void save(const std::string& filename, const Toolpaths& toolpaths);
+
+// Throws std::invalid_argument if the file can't be read, is damaged or
+// was written by a different version or on a machine with a different
+// byte order.
+Toolpaths load(const std::string& filename);
+
+} // namespace toolpath_file
+
+#endif //TOOLPATH_FILE_HPP
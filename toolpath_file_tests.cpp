@@ -0,0 +1,116 @@
+#define BOOST_TEST_MODULE toolpath file tests
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "toolpath_file.hpp"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(toolpath_file_tests)
+
+toolpath_file::Toolpaths make_toolpaths() {
+  toolpath_file::Toolpaths toolpaths;
+  toolpaths.bounding_box = box_type_fp(point_type_fp(-1, -2), point_type_fp(3.25, 4.125));
+  toolpaths.mirror_axis = 1.5;
+  toolpaths.mirror_yaxis = true;
+  toolpaths.mirror_absolute = true;
+  multi_linestring_type_fp front1;
+  bg::read_wkt("MULTILINESTRING((0 0,1 1,2 0.1),(3 3,3 4))", front1);
+  multi_linestring_type_fp front2;
+  bg::read_wkt("MULTILINESTRING((0.5 0.5,1.5 1.5))", front2);
+  multi_linestring_type_fp outline;
+  bg::read_wkt("MULTILINESTRING((0 0,0 1,1 1,1 0,0 0),(2 2,2 3))", outline);
+  toolpaths.layers.push_back({"front", false, {0.01, 0.1, 0.2, 0.3}, {{0.01, front1}, {0.1, front2}, {0.2, {}}}, {}});
+  // A name that isn't a multiple of 8 long, to check the padding.
+  toolpaths.layers.push_back({"outline", true, {0.125}, {{0.125, outline}}, {{0, 2}, {}}});
+  return toolpaths;
+}
+
+string to_string(const toolpath_file::Toolpaths& toolpaths) {
+  ostringstream out;
+  out << std::setprecision(17) << bg::wkt(toolpaths.bounding_box) << "\n";
+  out << toolpaths.mirror_axis << " " << toolpaths.mirror_yaxis << " " << toolpaths.mirror_absolute << "\n";
+  for (const auto& layer : toolpaths.layers) {
+    out << layer.name << " " << layer.backside << "\n";
+    for (const auto& diameter : layer.tool_diameters) {
+      out << diameter << " ";
+    }
+    out << "\n";
+    for (const auto& tool : layer.toolpaths) {
+      out << tool.first << " " << bg::wkt(tool.second) << "\n";
+    }
+    for (const auto& bridges : layer.bridges) {
+      for (const auto& bridge : bridges) {
+        out << bridge << " ";
+      }
+      out << "\n";
+    }
+  }
+  return out.str();
+}
+
+string read_file(const string& name) {
+  ifstream file(name, ios::binary);
+  return string{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+}
+
+void write_file(const string& name, const string& contents) {
+  ofstream file(name, ios::binary | ios::trunc);
+  file.write(contents.data(), contents.size());
+}
+
+BOOST_AUTO_TEST_CASE(round_trip) {
+  const string name = "toolpath_file_tests.bin";
+  const auto toolpaths = make_toolpaths();
+  toolpath_file::save(name, toolpaths);
+  BOOST_CHECK_EQUAL(read_file(name).size() % 8, 0UL);
+  BOOST_CHECK_EQUAL(to_string(toolpath_file::load(name)), to_string(toolpaths));
+  remove(name.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(empty) {
+  const string name = "toolpath_file_tests.bin";
+  toolpath_file::Toolpaths toolpaths;
+  toolpaths.bounding_box = box_type_fp(point_type_fp(0, 0), point_type_fp(1, 1));
+  toolpaths.mirror_axis = 0;
+  toolpaths.mirror_yaxis = false;
+  toolpaths.mirror_absolute = true;
+  toolpath_file::save(name, toolpaths);
+  BOOST_CHECK_EQUAL(toolpath_file::load(name).layers.size(), 0UL);
+  remove(name.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(damaged) {
+  const string name = "toolpath_file_tests.bin";
+  toolpath_file::save(name, make_toolpaths());
+  const string contents = read_file(name);
+  // Cut short anywhere.
+  for (size_t size = 0; size < contents.size(); size += 4) {
+    write_file(name, contents.substr(0, size));
+    BOOST_CHECK_THROW(toolpath_file::load(name), std::invalid_argument);
+  }
+  // Extra at the end.
+  write_file(name, contents + string(8, '\0'));
+  BOOST_CHECK_THROW(toolpath_file::load(name), std::invalid_argument);
+  // A different version.
+  string version = contents;
+  version[32]++;
+  write_file(name, version);
+  BOOST_CHECK_THROW(toolpath_file::load(name), std::invalid_argument);
+  // A huge count.
+  string count = contents;
+  count[91] = '\x7f';
+  write_file(name, count);
+  BOOST_CHECK_THROW(toolpath_file::load(name), std::invalid_argument);
+  remove(name.c_str());
+  BOOST_CHECK_THROW(toolpath_file::load(name), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+#include <stdexcept>
+
+#include "toolpath_queue.hpp"
+
+ToolpathQueue::ToolpathQueue() :
+    closed(false), failed(false), reading(false), abandoned(false) {}
+
+void ToolpathQueue::push(size_t tool_count, Tool tool) {
+  std::unique_lock<std::mutex> lock(mutex);
+  count = tool_count;
+  changed.notify_all();
+  changed.wait(lock, [this]() { return !reading || tools.empty() || abandoned; });
+  if (abandoned) {
+    return; // No one will write it.
+  }
+  tools.push_back(std::move(tool));
+  changed.notify_all();
+}
+
+void ToolpathQueue::close() {
+  std::lock_guard<std::mutex> lock(mutex);
+  closed = true;
+  changed.notify_all();
+}
+
+void ToolpathQueue::fail() {
+  std::lock_guard<std::mutex> lock(mutex);
+  failed = true;
+  changed.notify_all();
+}
+
+size_t ToolpathQueue::tool_count() {
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [this]() { return count || closed || failed; });
+  check_failed();
+  return count ? *count : 0;
+}
+
+const std::deque<ToolpathQueue::Tool>& ToolpathQueue::wait_all() {
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [this]() { return closed || failed; });
+  check_failed();
+  return tools;
+}
+
+ToolpathQueue::Tool ToolpathQueue::pop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  reading = true;
+  changed.wait(lock, [this]() { return !tools.empty() || closed || failed; });
+  check_failed();
+  if (tools.empty()) {
+    throw std::logic_error("There are no more tools in the layer.");
+  }
+  Tool tool = std::move(tools.front());
+  tools.pop_front();
+  changed.notify_all(); // There's room for the next one.
+  return tool;
+}
+
+void ToolpathQueue::abandon() {
+  std::lock_guard<std::mutex> lock(mutex);
+  abandoned = true;
+  tools.clear();
+  changed.notify_all();
+}
+
+void ToolpathQueue::check_failed() const {
+  if (failed) {
+    throw std::runtime_error("The toolpaths of the layer couldn't be found.");
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef TOOLPATH_QUEUE_HPP
+#define TOOLPATH_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "geometry.hpp"
+
+// Hands the toolpaths of a layer, one tool at a time, from the task
+// that finds them to the thread that writes them, so that a tool can
+// be written while the next one is being found.  Once the writer has
+// started on the layer, only one tool waits in the queue so that the
+// rest of them aren't all in memory at once.
+class ToolpathQueue {
+ public:
+  struct Tool {
+    coordinate_type_fp diameter;
+    multi_linestring_type_fp paths;
+    // For a cutter, the bridges of each path.
+    std::vector<std::vector<size_t>> bridges;
+  };
+
+  ToolpathQueue();
+
+  // For the finder.  tool_count is the number of tools in the layer.
+  // If the writer is taking the tools already, this waits until it has
+  // taken the one before.
+  void push(size_t tool_count, Tool tool);
+  // All the tools were pushed.
+  void close();
+  // The tools couldn't be found so the writer should stop.
+  void fail();
+
+  // For the writer, which must stop if these throw because the finder
+  // failed.  The number of tools in the layer, 0 if there are none.
+  size_t tool_count();
+  // Waits for all the tools, for when they are all needed before the
+  // first one is written.  They can still be taken with pop after.
+  const std::deque<Tool>& wait_all();
+  // Waits for the next tool.
+  Tool pop();
+  // The writer stopped so push shouldn't wait for it anymore.
+  void abandon();
+
+ private:
+  void check_failed() const;
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<Tool> tools;
+  boost::optional<size_t> count;
+  bool closed;
+  bool failed;
+  bool reading;
+  bool abandoned;
+};
+
+#endif //TOOLPATH_QUEUE_HPP
@@ -0,0 +1,99 @@
+#define BOOST_TEST_MODULE toolpath queue tests
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "toolpath_queue.hpp"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(toolpath_queue_tests)
+
+ToolpathQueue::Tool make_tool(coordinate_type_fp diameter) {
+  return ToolpathQueue::Tool{diameter, {{{0, 0}, {diameter, 1}}}, {}};
+}
+
+BOOST_AUTO_TEST_CASE(in_order) {
+  ToolpathQueue queue;
+  thread finder([&]() {
+      for (int i = 1; i <= 5; i++) {
+        queue.push(5, make_tool(i));
+      }
+      queue.close();
+    });
+  BOOST_CHECK_EQUAL(queue.tool_count(), 5UL);
+  for (int i = 1; i <= 5; i++) {
+    const auto tool = queue.pop();
+    BOOST_CHECK_EQUAL(tool.diameter, i);
+    BOOST_CHECK_EQUAL(tool.paths.front().back().x(), i);
+  }
+  finder.join();
+  BOOST_CHECK_THROW(queue.pop(), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE(before_reading) {
+  // Until the writer starts on the layer, the tools don't wait.
+  ToolpathQueue queue;
+  for (int i = 1; i <= 3; i++) {
+    queue.push(3, make_tool(i));
+  }
+  queue.close();
+  BOOST_CHECK_EQUAL(queue.wait_all().size(), 3UL);
+  BOOST_CHECK_EQUAL(queue.pop().diameter, 1);
+  BOOST_CHECK_EQUAL(queue.pop().diameter, 2);
+  BOOST_CHECK_EQUAL(queue.pop().diameter, 3);
+}
+
+BOOST_AUTO_TEST_CASE(one_waiting) {
+  ToolpathQueue queue;
+  queue.push(3, make_tool(1));
+  BOOST_CHECK_EQUAL(queue.pop().diameter, 1);
+  atomic<int> pushed(0);
+  thread finder([&]() {
+      queue.push(3, make_tool(2));
+      pushed++;
+      queue.push(3, make_tool(3));
+      pushed++;
+      queue.close();
+    });
+  // The third waits until the second is taken.
+  this_thread::sleep_for(chrono::milliseconds(50));
+  BOOST_CHECK_EQUAL(pushed, 1);
+  BOOST_CHECK_EQUAL(queue.pop().diameter, 2);
+  BOOST_CHECK_EQUAL(queue.pop().diameter, 3);
+  finder.join();
+  BOOST_CHECK_EQUAL(pushed, 2);
+}
+
+BOOST_AUTO_TEST_CASE(no_tools) {
+  ToolpathQueue queue;
+  queue.close();
+  BOOST_CHECK_EQUAL(queue.tool_count(), 0UL);
+}
+
+BOOST_AUTO_TEST_CASE(failed) {
+  ToolpathQueue queue;
+  thread finder([&]() {
+      queue.push(2, make_tool(1));
+      queue.fail();
+    });
+  finder.join();
+  BOOST_CHECK_THROW(queue.tool_count(), std::runtime_error);
+  BOOST_CHECK_THROW(queue.pop(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(abandoned) {
+  ToolpathQueue queue;
+  queue.push(3, make_tool(1));
+  queue.pop();
+  queue.push(3, make_tool(2));
+  queue.abandon();
+  // Doesn't wait for the writer anymore.
+  queue.push(3, make_tool(3));
+  queue.close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
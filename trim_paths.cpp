@@ -1,7 +1,10 @@
-#include <unordered_set>
+#include <array>
+#include <limits>
+#include <map>
 
 #include "geometry.hpp"
 #include "bg_operators.hpp"
+#include "eulerian_paths.hpp"
 
 #include "trim_paths.hpp"
 
@@ -9,91 +12,141 @@ namespace trim_paths {
 
 using std::pair;
 using std::vector;
-using std::unordered_multiset;
-using std::reverse;
+using std::array;
+using std::map;
+using std::min;
+using std::make_pair;
 using std::remove_if;
 
-// Returns true if the segment described by the two points is in the
-// haystack.  Finds reversed segments if the segment is reversible.
-// Prefers directional, however.  Removes the found element or returns
-// false.
-bool segment_in_path(const point_type_fp& start, const point_type_fp& end, unordered_multiset<pair<linestring_type_fp, bool>>& haystack) {
-  auto to_delete = haystack.find({{start, end}, false});
-  if (to_delete != haystack.cend()) {
-    haystack.erase(to_delete);
-    return true;
+static const size_t no_key = std::numeric_limits<size_t>::max();
+
+// The backtracks that could remove a segment of a toolpath.  Each
+// backtrack has a key and many backtracks may have the same key.
+// forward is for a directional backtrack in the direction of the
+// toolpath, backward is for one in the other direction, and either is
+// for a reversible backtrack.  Any of them can be no_key.
+struct SegmentKeys {
+  size_t forward;
+  size_t backward;
+  size_t either;
+};
+
+// The number of backtracks left for each key.  A trim can try using
+// backtracks and then either forget what it tried or remove them for
+// good.
+class Backtracks {
+ public:
+  Backtracks(vector<size_t> counts) :
+    counts(std::move(counts)),
+    used(this->counts.size(), 0) {}
+
+  // Returns true if there is a backtrack that matches the segment,
+  // preferring directional, and marks it as used.  Otherwise returns
+  // false.
+  bool use(const SegmentKeys& keys, bool reversed) {
+    for (const auto& key : {reversed ? keys.backward : keys.forward, keys.either}) {
+      if (key != no_key && counts[key] > used[key]) {
+        if (used[key]++ == 0) {
+          touched.push_back(key);
+        }
+        return true;
+      }
+    }
+    return false;
   }
-  to_delete = haystack.find({{start, end}, true});
-  if (to_delete != haystack.cend()) {
-    haystack.erase(to_delete);
-    return true;
+
+  // Forget all the used backtracks.
+  void clear() {
+    for (const auto& key : touched) {
+      used[key] = 0;
+    }
+    touched.clear();
   }
-  to_delete = haystack.find({{end, start}, true});
-  if (to_delete != haystack.cend()) {
-    haystack.erase(to_delete);
-    return true;
+
+  // Remove a backtrack that matches the segment for good, if there is
+  // one.
+  void remove(const SegmentKeys& keys, bool reversed) {
+    for (const auto& key : {reversed ? keys.backward : keys.forward, keys.either}) {
+      if (key != no_key && counts[key] > 0) {
+        counts[key]--;
+        return;
+      }
+    }
   }
-  return false;
-}
 
-void trim_path(pair<linestring_type_fp, bool>& ls,
-               unordered_multiset<pair<linestring_type_fp, bool>>& backtracks) {
-  if (ls.first.size() < 2) {
+ private:
+  vector<size_t> counts;
+  vector<size_t> used;
+  vector<size_t> touched;
+};
+
+// Remove backtracks from the start and end of the path or, if it's a
+// loop, from the middle, whichever is longer.  keys has the keys of
+// the segments of ls and is updated to match.  If reversed is true,
+// the path is trimmed as if it were reversed, without reversing it.
+void trim_path(linestring_type_fp& ls, vector<SegmentKeys>& keys, bool reversed,
+               Backtracks& backtracks) {
+  const size_t n = ls.size();
+  if (n < 2) {
     return; // Nothing to remove.
   }
-  // backtracks not yet seen.
-  unordered_multiset<pair<linestring_type_fp, bool>> backtracks_multiset;
-  for (const auto& p : backtracks) {
-    backtracks_multiset.insert(p);
-  }
+  // Everything below is in the order of the trim, so the points and
+  // segments are counted from the other end if reversed.
+  auto point = [&](size_t i) -> const point_type_fp& {
+    return ls[reversed ? n - 1 - i : i];
+  };
+  auto segment_keys = [&](size_t i) -> const SegmentKeys& {
+    return keys[reversed ? n - 2 - i : i];
+  };
+  auto segment_in_path = [&](size_t i) {
+    return backtracks.use(segment_keys(i), reversed);
+  };
+  backtracks.clear();
   // First check for how much can be removed from the start.
   // This needs to point to one beyond the end of the points to
   // remove.
-  auto remove_from_start = ls.first.cbegin();
+  size_t remove_from_start = 0;
   double length_from_start = 0;
-  for (auto current = ls.first.cbegin(); current+1 != ls.first.cend(); current++) {
-    if (segment_in_path(*current, *(current+1), backtracks_multiset)) {
+  for (size_t current = 0; current + 1 != n; current++) {
+    if (segment_in_path(current)) {
       remove_from_start = current + 1;
-      length_from_start += bg::distance(*current, *(current+1));
+      length_from_start += bg::distance(point(current), point(current + 1));
     } else {
       break;
     }
   }
   // Now check for how much can be removed from the end.  This
   // needs to point to the first vertex to remove.
-  auto remove_from_end = ls.first.cend();
+  size_t remove_from_end = n;
   double length_from_end = 0;
-  for (auto current = remove_from_end - 1; current != ls.first.begin(); current--) {
-    if (segment_in_path(*(current-1), *current, backtracks_multiset)) {
+  for (size_t current = n - 1; current != 0; current--) {
+    if (segment_in_path(current - 1)) {
       remove_from_end = current;
-      length_from_end += bg::distance(*(current-1), *current);
+      length_from_end += bg::distance(point(current - 1), point(current));
     } else {
       break;
     }
   }
 
   double longest_so_far = 0;
-  auto longest_start = ls.first.cbegin();
-  auto longest_end = ls.first.cbegin();
-  if (ls.first.front() == ls.first.back()) {
+  size_t longest_start = 0;
+  size_t longest_end = 0;
+  if (point(0) == point(n - 1)) {
     // For loops, see if we can do better by removing parts of the middle.
-    for (auto current = ls.first.cbegin(); current+1 != ls.first.cend();) {
-      backtracks_multiset.clear();
-      for (const auto& p : backtracks) {
-        backtracks_multiset.insert(p);
-      }
-      while (current + 1 != ls.first.cend() && !segment_in_path(*current, *(current+1), backtracks_multiset)) {
+    for (size_t current = 0; current + 1 != n;) {
+      backtracks.clear();
+      while (current + 1 != n && !segment_in_path(current)) {
         current++;
       }
-      if (current + 1 == ls.first.cend()) {
+      if (current + 1 == n) {
         break;
       }
-      double current_length = bg::distance(*current, *(current + 1));
-      auto current_start = current; // First vertex in backtrack.
-      auto current_end = current + 1; // Last vertex in backtrack.
-      for (current++; current + 1 != ls.first.cend() && segment_in_path(*current, *(current+1), backtracks_multiset); current++) {
+      double current_length = bg::distance(point(current), point(current + 1));
+      size_t current_start = current; // First vertex in backtrack.
+      size_t current_end = current + 1; // Last vertex in backtrack.
+      for (current++; current + 1 != n && segment_in_path(current); current++) {
         current_end = current + 1;
-        current_length += bg::distance(*current, *(current + 1));
+        current_length += bg::distance(point(current), point(current + 1));
       }
       // How long did we find?
       if (current_length > longest_so_far) {
@@ -103,31 +156,81 @@ void trim_path(pair<linestring_type_fp, bool>& ls,
       }
     }
   }
+  backtracks.clear();
   // Delete that longest bit,
   if (length_from_start + length_from_end > longest_so_far) {
     // Update the caller's backtracks.
-    for (auto current = remove_from_end - 1; current + 1 != ls.first.cend(); current++) {
-      segment_in_path(*current, *(current+1), backtracks);
+    for (size_t current = remove_from_end - 1; current + 1 != n; current++) {
+      backtracks.remove(segment_keys(current), reversed);
     }
-    for (auto current = ls.first.cbegin(); current != remove_from_start; current++) {
-      segment_in_path(*current, *(current+1), backtracks);
+    for (size_t current = 0; current != remove_from_start; current++) {
+      backtracks.remove(segment_keys(current), reversed);
     }
     // Just delete from the start and from the end.
-    ls.first.erase(remove_from_end, ls.first.cend());
-    ls.first.erase(ls.first.cbegin(), remove_from_start);
+    if (remove_from_start >= remove_from_end) {
+      // Nothing is left.
+      ls.clear();
+      keys.clear();
+    } else if (!reversed) {
+      ls.erase(ls.cbegin() + remove_from_end, ls.cend());
+      ls.erase(ls.cbegin(), ls.cbegin() + remove_from_start);
+      keys.erase(keys.cbegin() + remove_from_end - 1, keys.cend());
+      keys.erase(keys.cbegin(), keys.cbegin() + remove_from_start);
+    } else {
+      ls.erase(ls.cend() - remove_from_start, ls.cend());
+      ls.erase(ls.cbegin(), ls.cbegin() + (n - remove_from_end));
+      keys.erase(keys.cend() - remove_from_start, keys.cend());
+      keys.erase(keys.cbegin(), keys.cbegin() + (n - remove_from_end));
+    }
   } else {
     // Update the caller's backtracks.
-    for (auto current = longest_start; current != longest_end; current++) {
-      segment_in_path(*current, *(current+1), backtracks);
+    for (size_t current = longest_start; current != longest_end; current++) {
+      backtracks.remove(segment_keys(current), reversed);
     }
-    // This is loop and we found a middle section to remove.
+    // This is loop and we found a middle section to remove.  The new
+    // loop starts where the removed section ended and goes around to
+    // where it started.
     linestring_type_fp new_ls;
-    new_ls.insert(new_ls.cend(), longest_end, ls.first.cend());
-    new_ls.insert(new_ls.cend(), ls.first.cbegin() + 1, longest_start+1);
-    ls.first = new_ls;
+    vector<SegmentKeys> new_keys;
+    new_ls.reserve(n - (longest_end - longest_start));
+    new_keys.reserve(n - 1 - (longest_end - longest_start));
+    if (!reversed) {
+      new_ls.insert(new_ls.cend(), ls.cbegin() + longest_end, ls.cend());
+      new_ls.insert(new_ls.cend(), ls.cbegin() + 1, ls.cbegin() + longest_start + 1);
+      new_keys.insert(new_keys.cend(), keys.cbegin() + longest_end, keys.cend());
+      new_keys.insert(new_keys.cend(), keys.cbegin(), keys.cbegin() + longest_start);
+    } else {
+      new_ls.insert(new_ls.cend(), ls.cbegin() + (n - 1 - longest_start), ls.cend() - 1);
+      new_ls.insert(new_ls.cend(), ls.cbegin(), ls.cbegin() + (n - longest_end));
+      new_keys.insert(new_keys.cend(), keys.cbegin() + (n - 1 - longest_start), keys.cend());
+      new_keys.insert(new_keys.cend(), keys.cbegin(), keys.cbegin() + (n - 1 - longest_end));
+    }
+    ls = std::move(new_ls);
+    keys = std::move(new_keys);
   }
 }
 
+// Trim all the toolpaths, reversible ones in both directions, and
+// remove the ones that are left with nothing.
+static void trim_all(vector<pair<linestring_type_fp, bool>>& toolpaths,
+                     vector<vector<SegmentKeys>>& keys,
+                     Backtracks& backtracks) {
+  for (size_t i = 0; i < toolpaths.size(); i++) {
+    trim_path(toolpaths[i].first, keys[i], false, backtracks);
+    if (toolpaths[i].second) {
+      trim_path(toolpaths[i].first, keys[i], true, backtracks);
+    }
+  }
+  toolpaths.erase(
+      remove_if(
+          toolpaths.begin(),
+          toolpaths.end(),
+          [](pair<linestring_type_fp, bool> const& p) {
+            return p.first.size() < 2;
+          }),
+      toolpaths.cend());
+}
+
 // Given toolpaths and backtracks, look for segments in toolspaths
 // that match backtracks and remove them.  This makes the toolpaths
 // smaller.  The backtracks are expected to be stright segments with
@@ -139,26 +242,106 @@ void trim_paths(vector<pair<linestring_type_fp, bool>>& toolpaths,
   }
   // backtrack adds enough paths to make a eulerian circuit but we
   // just need a eulerian path, so find the longest stretch of
-  // backtracks and remove those.
-  unordered_multiset<pair<linestring_type_fp, bool>> bt{backtracks.cbegin(), backtracks.cend()};
-  for (auto& ls : toolpaths) {
-    trim_path(ls, bt);
-    if (ls.second) {
-      auto reverse_ls = ls;
-      reverse(reverse_ls.first.begin(), reverse_ls.first.end());
-      trim_path(reverse_ls, bt);
-      reverse(reverse_ls.first.begin(), reverse_ls.first.end());
-      ls = reverse_ls;
+  // backtracks and remove those.  Each different backtrack gets a key,
+  // reversible ones without regard to direction.
+  map<pair<point_type_fp, point_type_fp>, size_t> directional_keys;
+  map<pair<point_type_fp, point_type_fp>, size_t> reversible_keys;
+  vector<size_t> counts;
+  auto reversible_key = [](const point_type_fp& a, const point_type_fp& b) {
+    return b < a ? make_pair(b, a) : make_pair(a, b);
+  };
+  for (const auto& backtrack : backtracks) {
+    const auto& start = backtrack.first.front();
+    const auto& end = backtrack.first.back();
+    auto& keys = backtrack.second ? reversible_keys : directional_keys;
+    auto inserted = keys.emplace(backtrack.second ? reversible_key(start, end) : make_pair(start, end),
+                                 counts.size());
+    if (inserted.second) {
+      counts.push_back(0);
     }
+    counts[inserted.first->second]++;
   }
-  toolpaths.erase(
-      remove_if(
-          toolpaths.begin(),
-          toolpaths.end(),
-          [](pair<linestring_type_fp, bool> const& p) {
-            return p.first.size() < 2;
-          }),
-      toolpaths.cend());
+  auto find_key = [](const map<pair<point_type_fp, point_type_fp>, size_t>& keys,
+                     const pair<point_type_fp, point_type_fp>& segment) {
+    const auto found = keys.find(segment);
+    return found == keys.cend() ? no_key : found->second;
+  };
+  vector<vector<SegmentKeys>> keys(toolpaths.size());
+  for (size_t i = 0; i < toolpaths.size(); i++) {
+    const auto& ls = toolpaths[i].first;
+    for (size_t j = 0; j + 1 < ls.size(); j++) {
+      keys[i].push_back({find_key(directional_keys, make_pair(ls[j], ls[j+1])),
+                         find_key(directional_keys, make_pair(ls[j+1], ls[j])),
+                         find_key(reversible_keys, reversible_key(ls[j], ls[j+1]))});
+    }
+  }
+  Backtracks remaining(std::move(counts));
+  trim_all(toolpaths, keys, remaining);
+}
+
+// The same for toolpaths that know which segment each of their
+// segments came from, so most segments need no geometry compared.
+void trim_paths(vector<pair<linestring_type_fp, bool>>& toolpaths,
+                const vector<vector<size_t>>& segment_sources,
+                const vector<bool>& reversible,
+                const vector<pair<linestring_type_fp, bool>>& backtracks,
+                const vector<size_t>& backtrack_sources) {
+  if (backtracks.size() == 0) {
+    return;
+  }
+  // The key of each backtrack is the segment that it copies.
+  vector<size_t> counts(reversible.size(), 0);
+  for (const auto& source : backtrack_sources) {
+    counts[source]++;
+  }
+  // A segment with no source was made where get_eulerian_paths joined
+  // two paths that didn't meet.  It could still look like a backtrack
+  // so those are compared by their ends.
+  map<pair<point_type_fp, point_type_fp>, size_t> directional_keys;
+  map<pair<point_type_fp, point_type_fp>, size_t> reversible_keys;
+  auto reversible_key = [](const point_type_fp& a, const point_type_fp& b) {
+    return b < a ? make_pair(b, a) : make_pair(a, b);
+  };
+  auto find_key = [](const map<pair<point_type_fp, point_type_fp>, size_t>& keys,
+                     const pair<point_type_fp, point_type_fp>& segment) {
+    const auto found = keys.find(segment);
+    return found == keys.cend() ? no_key : found->second;
+  };
+  vector<vector<SegmentKeys>> keys(toolpaths.size());
+  for (size_t i = 0; i < toolpaths.size(); i++) {
+    const auto& ls = toolpaths[i].first;
+    keys[i].reserve(segment_sources[i].size());
+    for (size_t j = 0; j < segment_sources[i].size(); j++) {
+      auto source = segment_sources[i][j];
+      if (source == eulerian_paths::no_source) {
+        if (directional_keys.empty() && reversible_keys.empty()) {
+          for (size_t k = 0; k < backtracks.size(); k++) {
+            const auto& start = backtracks[k].first.front();
+            const auto& end = backtracks[k].first.back();
+            if (backtracks[k].second) {
+              reversible_keys.emplace(reversible_key(start, end), backtrack_sources[k]);
+            } else {
+              directional_keys.emplace(make_pair(start, end), backtrack_sources[k]);
+            }
+          }
+        }
+        keys[i].push_back({find_key(directional_keys, make_pair(ls[j], ls[j+1])),
+                           find_key(directional_keys, make_pair(ls[j+1], ls[j])),
+                           find_key(reversible_keys, reversible_key(ls[j], ls[j+1]))});
+        continue;
+      }
+      if (source >= reversible.size()) {
+        source = backtrack_sources[source - reversible.size()];
+      }
+      if (reversible[source]) {
+        keys[i].push_back({no_key, no_key, source});
+      } else {
+        keys[i].push_back({source, no_key, no_key});
+      }
+    }
+  }
+  Backtracks remaining(std::move(counts));
+  trim_all(toolpaths, keys, remaining);
 }
 
 } // namespace trim_paths
@@ -12,6 +12,20 @@ namespace trim_paths {
 void trim_paths(std::vector<std::pair<linestring_type_fp, bool>>& toolpaths,
                 const std::vector<std::pair<linestring_type_fp, bool>>& backtracks);
 
+// The same for toolpaths made by get_eulerian_paths from segments
+// with copies of some of them, the backtracks, added at the end.
+// segment_sources are the sources from get_eulerian_paths.
+// reversible has an element for each of the segments, without the
+// backtracks, and backtrack_sources is the index of the segment that
+// each of the backtracks copies.  The segments must be unique.
+// Segments are matched by their index, which is faster than comparing
+// them.  Only segments with no_source are compared to the backtracks.
+void trim_paths(std::vector<std::pair<linestring_type_fp, bool>>& toolpaths,
+                const std::vector<std::vector<size_t>>& segment_sources,
+                const std::vector<bool>& reversible,
+                const std::vector<std::pair<linestring_type_fp, bool>>& backtracks,
+                const std::vector<size_t>& backtrack_sources);
+
 } // namespace trim_paths
   
 #endif // TRIM_PATHS_HPP
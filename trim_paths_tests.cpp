@@ -7,6 +7,7 @@
 #include "bg_operators.hpp"
 #include "bg_helpers.hpp"
 
+#include "eulerian_paths.hpp"
 #include "trim_paths.hpp"
 
 using namespace std;
@@ -202,4 +203,37 @@ BOOST_AUTO_TEST_CASE(directed_square_and_diagonal) {
   BOOST_CHECK_EQUAL(paths, expected);
 }
 
+// Trimming by the sources of the segments is the same as trimming by
+// their geometry.
+BOOST_AUTO_TEST_CASE(by_sources) {
+  vector<pair<linestring_type_fp, bool>> segments{
+    {{{0,0}, {0,5}}, false},
+    {{{0,5}, {5,5}}, false},
+    {{{5,5}, {5,0}}, false},
+    {{{5,0}, {0,0}}, false},
+    {{{5,5}, {0,0}}, false},
+    {{{5,5}, {9,9}}, true},
+    {{{9,9}, {9,0}}, true},
+  };
+  vector<bool> reversible;
+  for (const auto& segment : segments) {
+    reversible.push_back(segment.second);
+  }
+  vector<pair<linestring_type_fp, bool>> backtracks{
+    {{{0,0}, {0,5}}, false},
+    {{{0,5}, {5,5}}, false},
+    {{{5,5}, {9,9}}, true},
+  };
+  vector<size_t> backtrack_sources{0, 1, 5};
+  segments.insert(segments.cend(), backtracks.cbegin(), backtracks.cend());
+  vector<vector<size_t>> segment_sources;
+  auto paths = eulerian_paths::get_eulerian_paths<point_type_fp, linestring_type_fp>(
+      segments, &segment_sources);
+  auto expected = paths;
+  trim_paths::trim_paths(expected, backtracks);
+  trim_paths::trim_paths(paths, segment_sources, reversible, backtracks, backtrack_sources);
+  BOOST_CHECK_EQUAL(paths, expected);
+  BOOST_CHECK_CLOSE(length(paths), 29 + sqrt(50) + sqrt(32), 1e-9);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -21,9 +21,12 @@
 
 #include "voronoi.hpp"
 #include "voronoi_visual_utils.hpp"
+#include "task_graph.hpp"
 #include <list>
 #include <map>
 #include <algorithm>
+#include <cmath>
+#include <limits>
 using std::list;
 using std::map;
 
@@ -35,7 +38,8 @@ const double SCALE = 1000000.0;
 
 multi_polygon_type_fp Voronoi::build_voronoi(
     const multi_polygon_type_fp& input,
-    const box_type_fp& mask_bounding_box, coordinate_type_fp max_dist) {
+    const box_type_fp& mask_bounding_box, coordinate_type_fp max_dist,
+    unsigned int jobs, coordinate_type_fp tile_size) {
   // We need to scale all the inputs and call the integer version.
   multi_polygon_type_fp scaled_input;
   bg::transform(input, scaled_input,
@@ -52,7 +56,7 @@ multi_polygon_type_fp Voronoi::build_voronoi(
   box_type voronoi_bounding_box;
   bg::convert(scaled_mask_bounding_box, voronoi_bounding_box);
 
-  const multi_polygon_type_fp scaled_voronoi = build_voronoi(voronoi_input, voronoi_bounding_box, max_dist * SCALE);
+  const multi_polygon_type_fp scaled_voronoi = build_voronoi(voronoi_input, voronoi_bounding_box, max_dist * SCALE, jobs, tile_size * SCALE);
   // Scale the result back down.
   multi_polygon_type_fp voronoi;
   bg::transform(scaled_voronoi, voronoi,
@@ -63,7 +67,8 @@ multi_polygon_type_fp Voronoi::build_voronoi(
 
 multi_polygon_type_fp Voronoi::build_voronoi(
     const multi_polygon_type& input,
-    const box_type& mask_bounding_box, coordinate_type max_dist) {
+    const box_type& mask_bounding_box, coordinate_type max_dist,
+    unsigned int jobs, coordinate_type tile_size) {
     if (input.empty()) {
         return multi_polygon_type_fp();
     }
@@ -72,14 +77,6 @@ multi_polygon_type_fp Voronoi::build_voronoi(
     box_type_fp bounding_box = bg::return_envelope<box_type_fp>(input);
     // Expand that bounding box by the provided bounding_box.
     bg::expand(bounding_box, mask_bounding_box);
-    // Make it large enough so that any voronoi edges between it and
-    // the input will surely line outside mask_bounding_box.
-    const auto bounding_box_width = bounding_box.max_corner().x() - bounding_box.min_corner().x();
-    const auto bounding_box_height = bounding_box.max_corner().y() - bounding_box.min_corner().y();
-    bounding_box.max_corner().x(bounding_box.max_corner().x() + 2*bounding_box_width);
-    bounding_box.min_corner().x(bounding_box.min_corner().x() - 2*bounding_box_width);
-    bounding_box.max_corner().y(bounding_box.max_corner().y() + 2*bounding_box_height);
-    bounding_box.min_corner().y(bounding_box.min_corner().y() - 2*bounding_box_height);
     // Each line segment from all the inputs.
     vector<segment_type_p> segments;
     // From which polygon each segment is sourced.
@@ -91,6 +88,18 @@ multi_polygon_type_fp Voronoi::build_voronoi(
         }
         segments_to_poly.push_back(segments.size());
     }
+    if (tile_size > 0) {
+        return build_voronoi_tiled(segments, segments_to_poly, bounding_box, max_dist, jobs, tile_size);
+    }
+
+    // Make it large enough so that any voronoi edges between it and
+    // the input will surely line outside mask_bounding_box.
+    const auto bounding_box_width = bounding_box.max_corner().x() - bounding_box.min_corner().x();
+    const auto bounding_box_height = bounding_box.max_corner().y() - bounding_box.min_corner().y();
+    bounding_box.max_corner().x(bounding_box.max_corner().x() + 2*bounding_box_width);
+    bounding_box.min_corner().x(bounding_box.min_corner().x() - 2*bounding_box_width);
+    bounding_box.max_corner().y(bounding_box.max_corner().y() + 2*bounding_box_height);
+    bounding_box.min_corner().y(bounding_box.min_corner().y() - 2*bounding_box_height);
 
     // Add the bounding box but without putting it in segments_to_poly
     // so that we won't put voronoi cells from it into the output.
@@ -98,17 +107,40 @@ multi_polygon_type_fp Voronoi::build_voronoi(
     bg::convert(bounding_box, bounding_box_ring);
     copy_ring(bounding_box_ring, segments);
 
-    voronoi_builder_type voronoi_builder;
-    boost::polygon::insert(segments.begin(), segments.end(), &voronoi_builder);
-    voronoi_diagram_type voronoi_diagram;
-    voronoi_builder.construct(&voronoi_diagram);
+    auto poly_rings = find_rings(segments, segments_to_poly, bounding_box, max_dist, jobs);
 
     // The output polygons which are voronoi shapes.  The outputs
     // match the inputs in number and position but the number of inner
     // rings for each output polygon might not match.
     multi_polygon_type_fp output;
-    // Pre-allocate because we are going to add elements out of order.
     output.resize(input.size());
+    for (size_t poly_index = 0; poly_index < input.size(); poly_index++) {
+        for (auto& ring : poly_rings[poly_index]) {
+            if (bg::area(ring) > 0) {
+                // This is the outer ring of the poly.
+                output[poly_index].outer() = std::move(ring);
+            } else {
+                // This has negative area, it must be a hole in the outer.
+                output[poly_index].inners().push_back(std::move(ring));
+            }
+        }
+    }
+    return output;
+}
+
+vector<vector<ring_type_fp>> Voronoi::find_rings(
+    const vector<segment_type_p>& segments, const vector<size_t>& segments_to_poly,
+    const box_type_fp& bounding_box, coordinate_type max_dist, unsigned int jobs,
+    vector<vector<vector<coordinate_type_fp>>>* distances) {
+    voronoi_builder_type voronoi_builder;
+    boost::polygon::insert(segments.begin(), segments.end(), &voronoi_builder);
+    voronoi_diagram_type voronoi_diagram;
+    voronoi_builder.construct(&voronoi_diagram);
+
+    vector<vector<ring_type_fp>> poly_rings(segments_to_poly.size());
+    if (distances != nullptr) {
+        distances->assign(segments_to_poly.size(), {});
+    }
 
     // To keep it simply, we first mark each edge as used if it won't
     // be part of the output.
@@ -121,20 +153,52 @@ multi_polygon_type_fp Voronoi::build_voronoi(
             edge.color(edge.color() | VISITED);
         }
     }
+    // Each ring is made of the edges whose twins are in the cells of
+    // one input polygon, so the rings of each output polygon can be
+    // found on their own.  The edges that might start a ring are kept
+    // in order so that the rings are found in the same order as if all
+    // the edges were searched together.
+    vector<vector<const edge_type*>> poly_edges(segments_to_poly.size());
     for (const edge_type& edge : voronoi_diagram.edges()) {
-        if ((edge.color() & VISITED) == VISITED) {
-            continue;  // Used already.
+        if ((edge.color() & VISITED) != VISITED) {
+            poly_edges[std::distance(segments_to_poly.cbegin(), std::upper_bound(segments_to_poly.cbegin(), segments_to_poly.cend(), edge.twin()->cell()->source_index()))].push_back(&edge);
         }
+    }
+    TaskGraph tasks;
+    for (size_t poly_index = 0; poly_index < segments_to_poly.size(); poly_index++) {
+      if (poly_edges[poly_index].empty()) {
+        continue;
+      }
+      tasks.add([&, poly_index]() {
+        // Reused for sampling each edge.
+        vector<point_type_fp_p> sampled_edge;
+        for (const edge_type* edge : poly_edges[poly_index]) {
+          if ((edge->color() & VISITED) == VISITED) {
+            continue;  // Used already.
+          }
 
-        const edge_type* current_edge = &edge;
-        const edge_type* const start_edge = current_edge;
-        ring_type_fp ring;
-        do {
-            linestring_type_fp discrete_edge = edge_to_linestring(*current_edge, segments, bounding_box, max_dist);
-            // Don't push the last one because we'll put it at the end.
-            for(std::size_t i=0; i<discrete_edge.size()-1; ++i)
-            {
-              bg::append(ring, discrete_edge.at(i));
+          const edge_type* current_edge = edge;
+          const edge_type* const start_edge = current_edge;
+          ring_type_fp ring;
+          vector<coordinate_type_fp> ring_distances;
+          do {
+            // Don't push the last point because we'll put it at the end.
+            const size_t first_point = ring.size();
+            append_edge(*current_edge, segments, bounding_box, max_dist, sampled_edge, ring);
+            if (distances != nullptr) {
+                // The input that the ring surrounds is the source of
+                // the twin's cell.
+                const cell_type& cell = *current_edge->twin()->cell();
+                for (size_t i = first_point; i < ring.size(); i++) {
+                    if (cell.contains_point()) {
+                        const point_type_p p = retrieve_point(cell, segments);
+                        ring_distances.push_back(bg::distance(ring[i], point_type_fp(p.x(), p.y())));
+                    } else {
+                        const segment_type_p& s = retrieve_segment(cell, segments);
+                        ring_distances.push_back(bg::distance(ring[i], bg::model::segment<point_type_fp>(
+                            point_type_fp(s.low().x(), s.low().y()), point_type_fp(s.high().x(), s.high().y()))));
+                    }
+                }
             }
 
             current_edge->color(current_edge->color() | VISITED);  // Mark used
@@ -142,29 +206,264 @@ multi_polygon_type_fp Voronoi::build_voronoi(
 
             // Check that we are still circling the same polygon for
             // our ring, and that we are on edge that is between
-            // different traces, and that it's a primary edge.
+            // different traces, and that it's a primary edge.  The
+            // polygon is checked first because the colors of edges of
+            // other polygons may be changing on other threads.
             while (current_edge != start_edge &&
-                   ((current_edge->color() & VISITED) == VISITED ||
-                    // Still circling the same twin.  We look at twin because we need clockwise outer loops.
-                    !same_poly(*current_edge->twin(), *start_edge->twin(), segments_to_poly))) {
-                current_edge = current_edge->rot_next();
+                   // Still circling the same twin.  We look at twin because we need clockwise outer loops.
+                   (!same_poly(*current_edge->twin(), *start_edge->twin(), segments_to_poly) ||
+                    (current_edge->color() & VISITED) == VISITED)) {
+              current_edge = current_edge->rot_next();
+            }
+          } while (current_edge != start_edge);
+
+          if (!ring.empty()) {
+            ring.push_back(ring.front());  // Close the ring.
+            poly_rings[poly_index].push_back(std::move(ring));
+            if (distances != nullptr) {
+                ring_distances.push_back(ring_distances.front());
+                (*distances)[poly_index].push_back(std::move(ring_distances));
             }
-        } while (current_edge != start_edge);
-
-        if(!ring.empty())
-        {
-          ring.push_back(ring.front());  // Close the ring.
-          size_t poly_index = std::distance(segments_to_poly.cbegin(), std::upper_bound(segments_to_poly.cbegin(), segments_to_poly.cend(), edge.twin()->cell()->source_index()));
-          if (bg::area(ring) > 0) {
-              // This is the outer ring of the poly.
-              output[poly_index].outer().swap(ring);
-          } else {
-              // This has negative area, it must be a hole in the outer.
-              output[poly_index].inners().push_back(ring);
           }
         }
+      });
+    }
+    tasks.run(jobs);
+    return poly_rings;
+}
+
+// Each polygon belongs to the tile with the center of its envelope.
+// The tile makes the diagram of the segments in a window around its
+// polygons and keeps the regions of just its own polygons.  The window
+// is grown until no segment outside it is nearer to any edge of those
+// regions than the inputs on either side of the edge.  The edges are
+// then the same as if all the segments were used, except that curved
+// edges might be sampled at other points, up to max_dist away.
+multi_polygon_type_fp Voronoi::build_voronoi_tiled(
+    const vector<segment_type_p>& segments, const vector<size_t>& segments_to_poly,
+    const box_type_fp& bounding_box, coordinate_type max_dist, unsigned int jobs,
+    coordinate_type tile_size) {
+    multi_polygon_type_fp output;
+    output.resize(segments_to_poly.size());
+    if (segments.empty()) {
+        return output;
+    }
+    const auto& min_corner = bounding_box.min_corner();
+    const size_t tiles_x = std::max(std::ceil((bounding_box.max_corner().x() - min_corner.x()) / tile_size), 1.0);
+    const size_t tiles_y = std::max(std::ceil((bounding_box.max_corner().y() - min_corner.y()) / tile_size), 1.0);
+    auto tile_x = [&](coordinate_type_fp x) {
+        return std::min(size_t(std::max(x - min_corner.x(), 0.0) / double(tile_size)), tiles_x - 1);
+    };
+    auto tile_y = [&](coordinate_type_fp y) {
+        return std::min(size_t(std::max(y - min_corner.y(), 0.0) / double(tile_size)), tiles_y - 1);
+    };
+    auto segment_box = [&](size_t segment) {
+        const auto& s = segments[segment];
+        return box_type_fp(
+            point_type_fp(std::min(s.low().x(), s.high().x()), std::min(s.low().y(), s.high().y())),
+            point_type_fp(std::max(s.low().x(), s.high().x()), std::max(s.low().y(), s.high().y())));
+    };
+    // The segments that touch each tile and the polygons that belong
+    // to each tile.
+    vector<vector<size_t>> tile_segments(tiles_x * tiles_y);
+    vector<vector<size_t>> tile_polys(tiles_x * tiles_y);
+    vector<box_type_fp> poly_boxes(segments_to_poly.size());
+    box_type_fp segments_box;
+    bg::assign_inverse(segments_box);
+    for (size_t poly = 0, segment = 0; poly < segments_to_poly.size(); poly++) {
+        bg::assign_inverse(poly_boxes[poly]);
+        for (; segment < segments_to_poly[poly]; segment++) {
+            const auto box = segment_box(segment);
+            bg::expand(poly_boxes[poly], box);
+            for (size_t x = tile_x(box.min_corner().x()); x <= tile_x(box.max_corner().x()); x++) {
+                for (size_t y = tile_y(box.min_corner().y()); y <= tile_y(box.max_corner().y()); y++) {
+                    tile_segments[x * tiles_y + y].push_back(segment);
+                }
+            }
+        }
+        if (segments_to_poly[poly] > (poly == 0 ? 0 : segments_to_poly[poly - 1])) {
+            const auto center = bg::return_centroid<point_type_fp>(poly_boxes[poly]);
+            tile_polys[tile_x(center.x()) * tiles_y + tile_y(center.y())].push_back(poly);
+            bg::expand(segments_box, poly_boxes[poly]);
+        }
+    }
+
+    // The frame must be farther from every point in the bounding_box
+    // than the nearest input so that it takes none of the regions in
+    // the bounding_box.  A point in a tile is no farther from the
+    // nearest segment than the center of the tile is, plus half the
+    // diagonal of the tile.  The frame is not put farther than needed
+    // because the regions at the edges reach the frame and large
+    // regions need large windows.
+    coordinate_type_fp margin = tile_size;
+    for (size_t x = 0; x < tiles_x; x++) {
+        for (size_t y = 0; y < tiles_y; y++) {
+            const point_type_fp center(min_corner.x() + (x + 0.5) * tile_size,
+                                       min_corner.y() + (y + 0.5) * tile_size);
+            // Segments in tiles that are k tiles away are at least
+            // k-0.5 tiles from the center.
+            coordinate_type_fp nearest = std::numeric_limits<coordinate_type_fp>::infinity();
+            for (size_t k = 0; k < std::max(tiles_x, tiles_y) && (k - 0.5) * tile_size < nearest; k++) {
+                for (size_t nx = x > k ? x - k : 0; nx <= std::min(x + k, tiles_x - 1); nx++) {
+                    for (size_t ny = y > k ? y - k : 0; ny <= std::min(y + k, tiles_y - 1); ny++) {
+                        if (std::max(nx > x ? nx - x : x - nx, ny > y ? ny - y : y - ny) != k) {
+                            continue;  // Searched already.
+                        }
+                        for (const auto segment : tile_segments[nx * tiles_y + ny]) {
+                            const auto& s = segments[segment];
+                            nearest = std::min(nearest, coordinate_type_fp(bg::distance(
+                                center, bg::model::segment<point_type_fp>(
+                                    point_type_fp(s.low().x(), s.low().y()),
+                                    point_type_fp(s.high().x(), s.high().y())))));
+                        }
+                    }
+                }
+            }
+            margin = std::max(margin, nearest + tile_size * std::sqrt(0.5) + 1);
+        }
     }
+    const box_type frame(
+        point_type(std::floor(bounding_box.min_corner().x() - margin),
+                   std::floor(bounding_box.min_corner().y() - margin)),
+        point_type(std::ceil(bounding_box.max_corner().x() + margin),
+                   std::ceil(bounding_box.max_corner().y() + margin)));
+    ring_type frame_ring;
+    bg::convert(frame, frame_ring);
+    box_type_fp frame_fp;
+    bg::convert(frame, frame_fp);
 
+    // The most that a window may grow past the polygons of its tile
+    // while the tiles are made at the same time, so that the memory
+    // for each of the jobs depends on the tile size and not on how far
+    // apart the inputs are.
+    const coordinate_type_fp max_halo = tile_size * 2.0;
+    // Make the regions of the polygons of the tile and return true, or
+    // return false if the window would need to grow past halo_limit.
+    auto build_tile = [&](size_t tile, coordinate_type_fp halo_limit) {
+        box_type_fp owned_box;
+        bg::assign_inverse(owned_box);
+        for (const auto poly : tile_polys[tile]) {
+            bg::expand(owned_box, poly_boxes[poly]);
+        }
+        for (coordinate_type_fp halo = tile_size / 4.0; halo <= halo_limit; halo *= 2) {
+            box_type_fp window;
+            bg::buffer(owned_box, window, halo);
+            vector<size_t> near_segments;
+            for (size_t x = tile_x(window.min_corner().x()); x <= tile_x(window.max_corner().x()); x++) {
+                for (size_t y = tile_y(window.min_corner().y()); y <= tile_y(window.max_corner().y()); y++) {
+                    for (const auto segment : tile_segments[x * tiles_y + y]) {
+                        if (bg::intersects(segment_box(segment), window)) {
+                            near_segments.push_back(segment);
+                        }
+                    }
+                }
+            }
+            std::sort(near_segments.begin(), near_segments.end());
+            near_segments.erase(std::unique(near_segments.begin(), near_segments.end()), near_segments.end());
+
+            // The near segments keep their order so the segments of
+            // each polygon are still together.
+            vector<segment_type_p> local_segments;
+            vector<size_t> local_segments_to_poly;
+            vector<size_t> local_polys;
+            for (const auto segment : near_segments) {
+                const size_t poly = std::distance(segments_to_poly.cbegin(),
+                                                  std::upper_bound(segments_to_poly.cbegin(), segments_to_poly.cend(), segment));
+                if (local_polys.empty() || local_polys.back() != poly) {
+                    if (!local_polys.empty()) {
+                        local_segments_to_poly.push_back(local_segments.size());
+                    }
+                    local_polys.push_back(poly);
+                }
+                local_segments.push_back(segments[segment]);
+            }
+            local_segments_to_poly.push_back(local_segments.size());
+            copy_ring(frame_ring, local_segments);
+
+            vector<vector<vector<coordinate_type_fp>>> distances;
+            auto poly_rings = find_rings(local_segments, local_segments_to_poly, frame_fp, max_dist, 1, &distances);
+            // Each pair of points in a ring is on one edge of the
+            // diagram, between the same two inputs.  Along the straight
+            // line between them, the distance to the input that the
+            // ring surrounds is no more than at the farther of the two,
+            // and the edge is at most max_dist from that line.  If
+            // some of segments_box outside the window is that near to
+            // the line, there might be a nearer segment that was left
+            // out so the window must grow.
+            const box_type_fp outside[] = {
+                // Left and right.
+                box_type_fp(segments_box.min_corner(),
+                            point_type_fp(window.min_corner().x(), segments_box.max_corner().y())),
+                box_type_fp(point_type_fp(window.max_corner().x(), segments_box.min_corner().y()),
+                            segments_box.max_corner()),
+                // Below and above.
+                box_type_fp(point_type_fp(std::max(window.min_corner().x(), segments_box.min_corner().x()),
+                                          segments_box.min_corner().y()),
+                            point_type_fp(std::min(window.max_corner().x(), segments_box.max_corner().x()),
+                                          window.min_corner().y())),
+                box_type_fp(point_type_fp(std::max(window.min_corner().x(), segments_box.min_corner().x()),
+                                          window.max_corner().y()),
+                            point_type_fp(std::min(window.max_corner().x(), segments_box.max_corner().x()),
+                                          segments_box.max_corner().y())),
+            };
+            bool grow = false;
+            for (size_t i = 0; i < local_polys.size() && !grow; i++) {
+                if (!std::binary_search(tile_polys[tile].cbegin(), tile_polys[tile].cend(), local_polys[i])) {
+                    continue;
+                }
+                for (size_t r = 0; r < poly_rings[i].size() && !grow; r++) {
+                    const auto& ring = poly_rings[i][r];
+                    for (size_t p = 0; p + 1 < ring.size() && !grow; p++) {
+                        const bg::model::segment<point_type_fp> line(ring[p], ring[p + 1]);
+                        const auto distance = std::max(distances[i][r][p], distances[i][r][p + 1]);
+                        for (const auto& box : outside) {
+                            if (box.min_corner().x() < box.max_corner().x() &&
+                                box.min_corner().y() < box.max_corner().y() &&
+                                bg::distance(line, box) < distance + 2 * max_dist + 1) {
+                                grow = true;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            if (grow) {
+                continue;
+            }
+            for (size_t i = 0; i < local_polys.size(); i++) {
+                if (!std::binary_search(tile_polys[tile].cbegin(), tile_polys[tile].cend(), local_polys[i])) {
+                    continue;
+                }
+                for (auto& ring : poly_rings[i]) {
+                    if (bg::area(ring) > 0) {
+                        output[local_polys[i]].outer() = std::move(ring);
+                    } else {
+                        output[local_polys[i]].inners().push_back(std::move(ring));
+                    }
+                }
+            }
+            return true;
+        }
+        return false;
+    };
+    vector<char> oversized(tile_polys.size(), false);
+    TaskGraph tasks;
+    for (size_t tile = 0; tile < tile_polys.size(); tile++) {
+      if (tile_polys[tile].empty()) {
+        continue;
+      }
+      tasks.add([&, tile]() {
+        oversized[tile] = !build_tile(tile, max_halo);
+      });
+    }
+    tasks.run(jobs);
+    // The tiles whose windows were too big to make many at once are
+    // made one at a time, each with as big a window as it needs.
+    for (size_t tile = 0; tile < tile_polys.size(); tile++) {
+        if (oversized[tile]) {
+            build_tile(tile, std::numeric_limits<coordinate_type_fp>::infinity());
+        }
+    }
     return output;
 }
 
@@ -173,22 +472,18 @@ bool Voronoi::same_poly(const edge_type& edge0, const edge_type& edge1, const st
             std::upper_bound(segments_to_poly.cbegin(), segments_to_poly.cend(), edge1.cell()->source_index()));
 }
 
-linestring_type_fp Voronoi::edge_to_linestring(const edge_type& edge, const vector<segment_type_p>& segments, const box_type_fp& bounding_box, coordinate_type max_dist) {
-    linestring_type_fp new_voronoi_edge;
+// Append all the points of the edge but the last to the ring.
+// sampled_edge is scratch space.
+void Voronoi::append_edge(const edge_type& edge, const vector<segment_type_p>& segments, const box_type_fp& bounding_box, coordinate_type max_dist,
+                          vector<point_type_fp_p>& sampled_edge, ring_type_fp& ring) {
+    sampled_edge.clear();
     if (edge.is_finite()) {
         if (edge.is_linear()) {
-            new_voronoi_edge.push_back(point_type_fp(edge.vertex0()->x(),
-                                                     edge.vertex0()->y()));
-            new_voronoi_edge.push_back(point_type_fp(edge.vertex1()->x(),
-                                                     edge.vertex1()->y()));
-        } else {
-            // It's a curve, it needs sampling.
-            vector<point_type_fp_p> sampled_edge;
-            sample_curved_edge(&edge, segments, sampled_edge, max_dist);
-            for (const auto& point : sampled_edge) {
-                new_voronoi_edge.push_back(point_type_fp(point.x(), point.y()));
-            }
+            ring.push_back(point_type_fp(edge.vertex0()->x(), edge.vertex0()->y()));
+            return;
         }
+        // It's a curve, it needs sampling.
+        sample_curved_edge(&edge, segments, sampled_edge, max_dist);
     } else {
         // Infinite edge, only make it if it is inside the bounding_box.
         if ((edge.vertex0() == NULL ||
@@ -197,15 +492,13 @@ linestring_type_fp Voronoi::edge_to_linestring(const edge_type& edge, const vect
             (edge.vertex1() == NULL ||
              bg::covered_by(point_type(edge.vertex1()->x(), edge.vertex1()->y()),
                             bounding_box))) {
-            vector<point_type_fp_p> clipped_edge;
             clip_infinite_edge(
-                edge, segments, &clipped_edge, bounding_box);
-            for (const auto& point : clipped_edge) {
-                new_voronoi_edge.push_back(point_type_fp(point.x(), point.y()));
-            }
+                edge, segments, &sampled_edge, bounding_box);
         }
     }
-    return new_voronoi_edge;
+    for (size_t i = 0; i + 1 < sampled_edge.size(); i++) {
+        ring.push_back(point_type_fp(sampled_edge[i].x(), sampled_edge[i].y()));
+    }
 }
 
 // Make segments from the ring and put them in segments.
@@ -69,17 +69,46 @@ public:
      * same as the order and number of inputs but the number of inner rings on
      * each output might not match those of the corresponding input.  max_dist
      * is the maximum error for interpolating parabolic curves into discrete
-     * linestrings.  Smaller means more accurate and more points.
+     * linestrings.  Smaller means more accurate and more points.  Once
+     * the diagram is made, the outputs are made on up to jobs threads, 0
+     * for one per core.
+     *
+     * If tile_size is more than 0, the polygons are split into square
+     * tiles of that size and the diagram for each tile is made from
+     * just the inputs near it, on up to jobs threads, so that the memory
+     * used depends on the size of the tiles instead of the size of the
+     * whole input.  Inside the bounding_box, the regions have the same
+     * edges as without tiles but curved edges might be sampled at
+     * other points, up to max_dist away.  The regions don't reach as far
+     * outside the bounding_box.  Tiles whose inputs are far apart
+     * compared to the tiles need most of the input and are made one at
+     * a time afterwards, which is slower.
      */
   static multi_polygon_type_fp build_voronoi(
       const multi_polygon_type& input,
-      const box_type& bounding_box, coordinate_type max_dist);
+      const box_type& bounding_box, coordinate_type max_dist,
+      unsigned int jobs = 1, coordinate_type tile_size = 0);
   static multi_polygon_type_fp build_voronoi(
       const multi_polygon_type_fp& input,
-      const box_type_fp& bounding_box, coordinate_type_fp max_dist);
+      const box_type_fp& bounding_box, coordinate_type_fp max_dist,
+      unsigned int jobs = 1, coordinate_type_fp tile_size = 0);
 
 protected:
-    static linestring_type_fp edge_to_linestring(const edge_type& edge, const std::vector<segment_type_p>& segments, const box_type_fp& bounding_box, coordinate_type max_dist);
+    // The rings of the voronoi regions of each polygon.  segments_to_poly
+    // has, for each polygon, the index after its last segment.  The
+    // segments after the last polygon are a frame around the others.
+    // If distances is provided, it gets how far each point of each ring
+    // is from the input that the ring surrounds.
+    static std::vector<std::vector<ring_type_fp>> find_rings(
+        const std::vector<segment_type_p>& segments, const std::vector<size_t>& segments_to_poly,
+        const box_type_fp& bounding_box, coordinate_type max_dist, unsigned int jobs,
+        std::vector<std::vector<std::vector<coordinate_type_fp>>>* distances = nullptr);
+    static multi_polygon_type_fp build_voronoi_tiled(
+        const std::vector<segment_type_p>& segments, const std::vector<size_t>& segments_to_poly,
+        const box_type_fp& bounding_box, coordinate_type max_dist, unsigned int jobs,
+        coordinate_type tile_size);
+    static void append_edge(const edge_type& edge, const std::vector<segment_type_p>& segments, const box_type_fp& bounding_box, coordinate_type max_dist,
+                            std::vector<point_type_fp_p>& sampled_edge, ring_type_fp& ring);
     static void copy_ring(const ring_type& ring, std::vector<segment_type_p> &segments);
     static point_type_p retrieve_point(const cell_type& cell, const std::vector<segment_type_p> &segments);
     static const segment_type_p& retrieve_segment(const cell_type& cell, const std::vector<segment_type_p> &segments);
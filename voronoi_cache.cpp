@@ -0,0 +1,224 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include <boost/format.hpp>
+
+#include "common.hpp"
+#include "voronoi.hpp"
+#include "voronoi_cache.hpp"
+
+using std::string;
+
+namespace voronoi_cache {
+
+namespace {
+
+// Change the version when the file format or the regions that
+// build_voronoi makes change so that old files aren't used.
+const char MAGIC[] = "pcb2gcode voronoi regions";
+const uint32_t VERSION = 1;
+// Files from a machine with a different byte order won't match.
+const uint32_t ENDIANNESS_CHECK = 0x01020304;
+
+template <typename T>
+void write(string& out, const T& value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void write(string& out, const ring_type_fp& ring) {
+  write(out, uint64_t(ring.size()));
+  for (const auto& point : ring) {
+    write(out, point.x());
+    write(out, point.y());
+  }
+}
+
+void write(string& out, const multi_polygon_type_fp& mpoly) {
+  write(out, uint64_t(mpoly.size()));
+  for (const auto& poly : mpoly) {
+    write(out, poly.outer());
+    write(out, uint64_t(poly.inners().size()));
+    for (const auto& inner : poly.inners()) {
+      write(out, inner);
+    }
+  }
+}
+
+// Reads values written by write() and remembers if there weren't
+// enough bytes for them.
+class Reader {
+ public:
+  Reader(const string& in, size_t position) : in(in), position(position), ok(true) {}
+  template <typename T>
+  T read() {
+    T value{};
+    if (!ok || in.size() - position < sizeof(value)) {
+      ok = false;
+      return value;
+    }
+    std::memcpy(&value, in.data() + position, sizeof(value));
+    position += sizeof(value);
+    return value;
+  }
+  // A count of items that are each at least item_size bytes, so that a
+  // damaged file can't make a huge allocation.
+  size_t read_count(size_t item_size) {
+    const uint64_t count = read<uint64_t>();
+    if (!ok || count > (in.size() - position) / item_size) {
+      ok = false;
+      return 0;
+    }
+    return count;
+  }
+  void read(ring_type_fp& ring) {
+    const size_t count = read_count(2 * sizeof(coordinate_type_fp));
+    ring.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      const auto x = read<coordinate_type_fp>();
+      const auto y = read<coordinate_type_fp>();
+      ring.push_back(point_type_fp(x, y));
+    }
+  }
+  void read(multi_polygon_type_fp& mpoly) {
+    mpoly.resize(read_count(2 * sizeof(uint64_t)));
+    for (auto& poly : mpoly) {
+      read(poly.outer());
+      poly.inners().resize(read_count(sizeof(uint64_t)));
+      for (auto& inner : poly.inners()) {
+        read(inner);
+      }
+    }
+  }
+  // True if all the reads had enough bytes and all the bytes were read.
+  bool done() const {
+    return ok && position == in.size();
+  }
+
+ private:
+  const string& in;
+  size_t position;
+  bool ok;
+};
+
+// The start of the file, which must match exactly for the file to be
+// used.
+string make_key(const multi_polygon_type_fp& input, const box_type_fp& bounding_box,
+                coordinate_type_fp max_dist, coordinate_type_fp tile_size) {
+  string key(MAGIC, sizeof(MAGIC));
+  write(key, VERSION);
+  write(key, ENDIANNESS_CHECK);
+  write(key, bounding_box.min_corner().x());
+  write(key, bounding_box.min_corner().y());
+  write(key, bounding_box.max_corner().x());
+  write(key, bounding_box.max_corner().y());
+  write(key, max_dist);
+  write(key, tile_size);
+  write(key, input);
+  return key;
+}
+
+// 64-bit FNV-1a, which is the same on every platform and run.
+uint64_t hash(const string& bytes) {
+  uint64_t result = 14695981039346656037ULL;
+  for (const unsigned char c : bytes) {
+    result ^= c;
+    result *= 1099511628211ULL;
+  }
+  return result;
+}
+
+string make_filename(const string& directory, const string& key) {
+  return build_filename(directory, str(boost::format("voronoi_%016x.bin") % hash(key)));
+}
+
+boost::optional<multi_polygon_type_fp> load_key(const string& filename, const string& key) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    return boost::none;
+  }
+  const string contents{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  if (contents.compare(0, key.size(), key) != 0) {
+    return boost::none;
+  }
+  Reader reader(contents, key.size());
+  multi_polygon_type_fp regions;
+  reader.read(regions);
+  if (!reader.done()) {
+    return boost::none;
+  }
+  return regions;
+}
+
+bool save_key(const string& filename, const string& key, const multi_polygon_type_fp& regions) {
+  string contents = key;
+  write(contents, regions);
+  // Layers are made at the same time so write to a file of our own and
+  // then move it into place.
+  const string temp_filename = filename + "." +
+      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+  {
+    std::ofstream file(temp_filename, std::ios::binary | std::ios::trunc);
+    file.write(contents.data(), contents.size());
+    if (!file) {
+      file.close();
+      std::remove(temp_filename.c_str());
+      return false;
+    }
+  }
+  if (std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+    std::remove(temp_filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+string filename(const string& directory,
+                const multi_polygon_type_fp& input, const box_type_fp& bounding_box,
+                coordinate_type_fp max_dist, coordinate_type_fp tile_size) {
+  return make_filename(directory, make_key(input, bounding_box, max_dist, tile_size));
+}
+
+boost::optional<multi_polygon_type_fp> load(
+    const string& filename,
+    const multi_polygon_type_fp& input, const box_type_fp& bounding_box,
+    coordinate_type_fp max_dist, coordinate_type_fp tile_size) {
+  return load_key(filename, make_key(input, bounding_box, max_dist, tile_size));
+}
+
+bool save(const string& filename,
+          const multi_polygon_type_fp& input, const box_type_fp& bounding_box,
+          coordinate_type_fp max_dist, coordinate_type_fp tile_size,
+          const multi_polygon_type_fp& regions) {
+  return save_key(filename, make_key(input, bounding_box, max_dist, tile_size), regions);
+}
+
+multi_polygon_type_fp build_voronoi(
+    const string& directory,
+    const multi_polygon_type_fp& input, const box_type_fp& bounding_box,
+    coordinate_type_fp max_dist, unsigned int jobs, coordinate_type_fp tile_size) {
+  if (directory.empty()) {
+    return Voronoi::build_voronoi(input, bounding_box, max_dist, jobs, tile_size);
+  }
+  const string key = make_key(input, bounding_box, max_dist, tile_size);
+  const string name = make_filename(directory, key);
+  auto regions = load_key(name, key);
+  if (regions) {
+    return std::move(*regions);
+  }
+  regions = Voronoi::build_voronoi(input, bounding_box, max_dist, jobs, tile_size);
+  if (!save_key(name, key, *regions)) {
+    std::cerr << "Warning: Couldn't save the voronoi regions to " << name << std::endl;
+  }
+  return std::move(*regions);
+}
+
+} // namespace voronoi_cache
@@ -0,0 +1,44 @@
+#ifndef VORONOI_CACHE_HPP
+#define VORONOI_CACHE_HPP
+
+#include <string>
+
+#include <boost/optional.hpp>
+
+#include "geometry.hpp"
+
+// The voronoi regions depend only on the traces, the bounding box, the
+// tolerance and the tile size, so they can be saved in a directory and
+// used again by later runs that change only the tools or the feeds.
+// Each file is named after a hash of those inputs and also holds the
+// inputs so that a file is only used if they are exactly the same.
+namespace voronoi_cache {
+
+std::string filename(const std::string& directory,
+                     const multi_polygon_type_fp& input, const box_type_fp& bounding_box,
+                     coordinate_type_fp max_dist, coordinate_type_fp tile_size);
+
+// The regions in the file for these inputs, or none if the file is
+// missing, damaged or for different inputs.
+boost::optional<multi_polygon_type_fp> load(
+    const std::string& filename,
+    const multi_polygon_type_fp& input, const box_type_fp& bounding_box,
+    coordinate_type_fp max_dist, coordinate_type_fp tile_size);
+
+// Returns false if the file couldn't be written.
+bool save(const std::string& filename,
+          const multi_polygon_type_fp& input, const box_type_fp& bounding_box,
+          coordinate_type_fp max_dist, coordinate_type_fp tile_size,
+          const multi_polygon_type_fp& regions);
+
+// The same as Voronoi::build_voronoi but the regions are loaded from
+// directory if they were saved there before, and saved there if not.
+// An empty directory is no cache.
+multi_polygon_type_fp build_voronoi(
+    const std::string& directory,
+    const multi_polygon_type_fp& input, const box_type_fp& bounding_box,
+    coordinate_type_fp max_dist, unsigned int jobs = 1, coordinate_type_fp tile_size = 0);
+
+} // namespace voronoi_cache
+
+#endif //VORONOI_CACHE_HPP
@@ -0,0 +1,98 @@
+#define BOOST_TEST_MODULE voronoi cache tests
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "voronoi.hpp"
+#include "voronoi_cache.hpp"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(voronoi_cache_tests)
+
+multi_polygon_type_fp make_input() {
+  multi_polygon_type_fp mp;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 1,1 1,1 0,0 0)),((2 0,2 1,3 1,3 0,2 0),(2.2 0.2,2.8 0.2,2.8 0.8,2.2 0.8,2.2 0.2)))", mp);
+  return mp;
+}
+
+string to_wkt(const multi_polygon_type_fp& mp) {
+  ostringstream out;
+  out << std::setprecision(17) << bg::wkt(mp);
+  return out.str();
+}
+
+BOOST_AUTO_TEST_CASE(same_as_build_voronoi) {
+  const auto input = make_input();
+  const box_type_fp bounding_box(point_type_fp(-1, -1), point_type_fp(4, 2));
+  const string name = voronoi_cache::filename(".", input, bounding_box, 0.01, 0);
+  remove(name.c_str());
+  const auto expected = Voronoi::build_voronoi(input, bounding_box, 0.01);
+  // Made and saved.
+  BOOST_CHECK_EQUAL(to_wkt(voronoi_cache::build_voronoi(".", input, bounding_box, 0.01)), to_wkt(expected));
+  BOOST_CHECK(ifstream(name).good());
+  // Loaded.
+  BOOST_CHECK_EQUAL(to_wkt(voronoi_cache::build_voronoi(".", input, bounding_box, 0.01)), to_wkt(expected));
+  remove(name.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(uses_saved_regions) {
+  const auto input = make_input();
+  const box_type_fp bounding_box(point_type_fp(-1, -1), point_type_fp(4, 2));
+  const string name = voronoi_cache::filename(".", input, bounding_box, 0.01, 0);
+  multi_polygon_type_fp saved;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 5,5 5,0 0)),((1 1,1 2,2 2,1 1)))", saved);
+  BOOST_REQUIRE(voronoi_cache::save(name, input, bounding_box, 0.01, 0, saved));
+  BOOST_CHECK_EQUAL(to_wkt(voronoi_cache::build_voronoi(".", input, bounding_box, 0.01)), to_wkt(saved));
+  // Any difference in the inputs means that the file isn't used.
+  BOOST_CHECK(voronoi_cache::load(name, input, bounding_box, 0.01, 0));
+  BOOST_CHECK(!voronoi_cache::load(name, input, bounding_box, 0.02, 0));
+  BOOST_CHECK(!voronoi_cache::load(name, input, bounding_box, 0.01, 1));
+  BOOST_CHECK(!voronoi_cache::load(name, input, box_type_fp(point_type_fp(-1, -1), point_type_fp(4, 3)), 0.01, 0));
+  auto moved = input;
+  bg::set<0>(moved[1].inners()[0][0], 2.3);
+  BOOST_CHECK(!voronoi_cache::load(name, moved, bounding_box, 0.01, 0));
+  BOOST_CHECK_NE(voronoi_cache::filename(".", moved, bounding_box, 0.01, 0), name);
+  remove(name.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(damaged_file) {
+  const auto input = make_input();
+  const box_type_fp bounding_box(point_type_fp(-1, -1), point_type_fp(4, 2));
+  const string name = voronoi_cache::filename(".", input, bounding_box, 0.01, 0);
+  const auto expected = Voronoi::build_voronoi(input, bounding_box, 0.01);
+  BOOST_REQUIRE(voronoi_cache::save(name, input, bounding_box, 0.01, 0, expected));
+  string contents;
+  {
+    ifstream file(name, ios::binary);
+    contents.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+  }
+  // Cut short, and with extra bytes at the end.
+  for (const string& damaged : {contents.substr(0, contents.size() - 1), contents + "x"}) {
+    {
+      ofstream file(name, ios::binary | ios::trunc);
+      file << damaged;
+    }
+    BOOST_CHECK(!voronoi_cache::load(name, input, bounding_box, 0.01, 0));
+    // Made again and saved again.
+    BOOST_CHECK_EQUAL(to_wkt(voronoi_cache::build_voronoi(".", input, bounding_box, 0.01)), to_wkt(expected));
+    BOOST_CHECK(voronoi_cache::load(name, input, bounding_box, 0.01, 0));
+  }
+  remove(name.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(missing_directory) {
+  const auto input = make_input();
+  const box_type_fp bounding_box(point_type_fp(-1, -1), point_type_fp(4, 2));
+  const auto expected = Voronoi::build_voronoi(input, bounding_box, 0.01);
+  BOOST_CHECK_EQUAL(to_wkt(voronoi_cache::build_voronoi("no_such_directory", input, bounding_box, 0.01)),
+                    to_wkt(expected));
+  BOOST_CHECK_EQUAL(to_wkt(voronoi_cache::build_voronoi("", input, bounding_box, 0.01)), to_wkt(expected));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,8 @@
 
 #include <boost/format.hpp>
 #include <fstream>
+#include <chrono>
+#include <iostream>
 #include "voronoi.hpp"
 
 using namespace std;
@@ -90,4 +92,110 @@ BOOST_AUTO_TEST_CASE(almost_square_with_hole) {
   BOOST_CHECK(result[1].inners().size() == 0);
 }
 
+// A grid of squares, some of them with holes.
+multi_polygon_type make_squares(int count) {
+  multi_polygon_type mp;
+  for (int i = 0; i < count; i++) {
+    const int x = (i % 60) * 100 + (i * 7) % 30;
+    const int y = (i / 60) * 100 + (i * 13) % 30;
+    polygon_type new_poly;
+    bg::read_wkt((boost::format("POLYGON((%1% %2%, %1% %4%, %3% %4%, %3% %2%, %1% %2%))")
+                  % x % y % (x + 50) % (y + 50)).str(), new_poly);
+    if (i % 3 == 0) {
+      bg::read_wkt((boost::format("POLYGON((%1% %2%, %1% %4%, %3% %4%, %3% %2%, %1% %2%),"
+                                  "(%5% %6%, %7% %6%, %7% %8%, %5% %8%, %5% %6%))")
+                    % x % y % (x + 50) % (y + 50) % (x + 20) % (y + 20) % (x + 30) % (y + 30)).str(),
+                   new_poly);
+    }
+    mp.push_back(new_poly);
+  }
+  return mp;
+}
+
+BOOST_AUTO_TEST_CASE(same_for_any_jobs) {
+  const auto mp = make_squares(200);
+  box_type bounding_box;
+  bg::envelope(mp, bounding_box);
+  const auto expected = Voronoi::build_voronoi(mp, bounding_box, 10, 1);
+  BOOST_REQUIRE_EQUAL(expected.size(), mp.size());
+  for (unsigned int jobs : {2, 4, 0}) {
+    BOOST_TEST_CONTEXT("jobs = " << jobs) {
+      const auto result = Voronoi::build_voronoi(mp, bounding_box, 10, jobs);
+      BOOST_REQUIRE_EQUAL(result.size(), expected.size());
+      for (size_t i = 0; i < result.size(); i++) {
+        BOOST_CHECK(bg::equals(result[i], expected[i]));
+        BOOST_CHECK_EQUAL(result[i].inners().size(), expected[i].inners().size());
+      }
+    }
+  }
+}
+
+// Inside the bounding_box, the tiled regions have the same edges as the
+// untiled ones but curved edges might be sampled up to max_dist away, so
+// they can differ by at most a band of that width along their edges.
+void check_same_inside(const multi_polygon_type_fp& expected, const multi_polygon_type_fp& tiled,
+                       const box_type& bounding_box, coordinate_type max_dist) {
+  box_type_fp bounding_box_fp;
+  bg::convert(bounding_box, bounding_box_fp);
+  BOOST_REQUIRE_EQUAL(tiled.size(), expected.size());
+  for (size_t i = 0; i < tiled.size(); i++) {
+    BOOST_TEST_CONTEXT("region " << i) {
+      // The regions are sampled differently outside the bounding_box.
+      multi_polygon_type_fp expected_inside;
+      bg::intersection(expected[i], bounding_box_fp, expected_inside);
+      multi_polygon_type_fp tiled_inside;
+      bg::intersection(tiled[i], bounding_box_fp, tiled_inside);
+      multi_polygon_type_fp difference;
+      bg::sym_difference(expected_inside, tiled_inside, difference);
+      BOOST_CHECK_LE(bg::area(difference), bg::perimeter(expected_inside) * max_dist);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(same_when_tiled) {
+  const auto mp = make_squares(600);
+  box_type bounding_box;
+  bg::envelope(mp, bounding_box);
+  const auto expected = Voronoi::build_voronoi(mp, bounding_box, 10, 1);
+  const auto tiled = Voronoi::build_voronoi(mp, bounding_box, 10, 1, 300);
+  check_same_inside(expected, tiled, bounding_box, 10);
+  // The tiles are independent so the output doesn't depend on jobs.
+  const auto tiled_jobs = Voronoi::build_voronoi(mp, bounding_box, 10, 0, 300);
+  BOOST_REQUIRE_EQUAL(tiled_jobs.size(), tiled.size());
+  for (size_t i = 0; i < tiled.size(); i++) {
+    BOOST_CHECK(bg::equals(tiled_jobs[i], tiled[i]));
+  }
+}
+
+// The squares are far apart compared to the tiles so the windows grow
+// too big to make at the same time and are made one at a time.
+BOOST_AUTO_TEST_CASE(same_when_tiles_are_small) {
+  const auto mp = make_squares(200);
+  box_type bounding_box;
+  bg::envelope(mp, bounding_box);
+  const auto expected = Voronoi::build_voronoi(mp, bounding_box, 10, 1);
+  const auto tiled = Voronoi::build_voronoi(mp, bounding_box, 10, 0, 10);
+  check_same_inside(expected, tiled, bounding_box, 10);
+}
+
+// A board with 3000 nets.
+BOOST_AUTO_TEST_CASE(benchmark, *boost::unit_test::disabled()) {
+  const auto mp = make_squares(3000);
+  box_type bounding_box;
+  bg::envelope(mp, bounding_box);
+  for (coordinate_type tile_size : {0, 1000}) {
+    for (unsigned int jobs : {1, 0}) {
+      const auto start_time = std::chrono::steady_clock::now();
+      const auto result = Voronoi::build_voronoi(mp, bounding_box, 1, jobs, tile_size);
+      const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start_time;
+      size_t points = 0;
+      for (const auto& poly : result) {
+        points += bg::num_points(poly);
+      }
+      std::cout << result.size() << " regions with " << points << " points with jobs = "
+                << jobs << " and tile_size = " << tile_size << " in " << time.count() << " seconds" << std::endl;
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -90,8 +90,9 @@ class voronoi_visual_utils {
     Point<CT> last_point = (*discretization)[1];
     discretization->pop_back();
 
-    // Use stack to avoid recursion.
-    std::stack<CT> point_stack;
+    // Use stack to avoid recursion.  A vector doesn't allocate as much
+    // as a deque for the few points that most edges need.
+    std::stack<CT, std::vector<CT> > point_stack;
     point_stack.push(projection_end);
     CT cur_x = projection_start;
     CT cur_y = parabola_y(cur_x, rot_x, rot_y);